@@ -41,8 +41,34 @@ Additionally if DCCRG_USER_MPI_DATA_TYPE is defined:
 	-UserData function size() is not needed (size() == 1 is assumed).
 	-Cells can have non-contiguous data.
 
-If DCCRG_SEND_SINGLE_CELLS is defined then cell data is sent one cell at a time.
+Additionally if DCCRG_VARIABLE_CELL_DATA_SIZE is defined:
+	-UserData instances must have a function size() which returns the size of their data in bytes.
+	-UserData instances must have a function resize(const size_t bytes) which makes room for the given amount of data.
+	-Processes exchange the sizes of transferred cells before each transfer,
+	 only the sizes of cells that changed since the previous transfer between two processes are sent.
 
+Otherwise UserData is transferred with boost::mpi and must be serializable.
+
+How user data is transferred between processes is decided at runtime by a transfer policy,
+see Dccrg::transfer_policy_t and Dccrg::set_transfer_policy(). The default policy is:
+	-PACKED_TRANSFER if DCCRG_PACK_CELL_DATA is defined
+	-DATATYPE_TRANSFER otherwise
+
+DCCRG_SEND_SINGLE_CELLS is deprecated, it only makes SINGLE_CELL_TRANSFER the default policy,
+use Dccrg::set_transfer_policy(SINGLE_CELL_TRANSFER) instead.
+
+SINGLE_CELL_TRANSFER sends the cells of a process in coalesced messages instead when there
+would be too many messages or their tags would exceed MPI_TAG_UB, see
+Dccrg::set_single_cell_transfer_limits().
+
+DCCRG_TRANSFER_TUNING_UPDATES sets how many neighbor data updates AUTOMATIC_TRANSFER times
+with each policy before choosing the fastest one.
+
+DCCRG_PREFETCH_DISTANCE sets how many cells ahead for_each_cell() prefetches the data
+of cells and their neighbors, 0 disables prefetching.
+
+If DCCRG_MORTON_ORDER is defined refined cells are numbered in Morton order
+within each unrefined cell instead of row-major order, see Index.
 */
 #ifdef DCCRG_USER_MPI_DATA_TYPE
 	#ifndef DCCRG_CELL_DATA_SIZE_FROM_USER
@@ -50,10 +76,38 @@ If DCCRG_SEND_SINGLE_CELLS is defined then cell data is sent one cell at a time.
 	#endif
 #endif
 
+#ifdef DCCRG_VARIABLE_CELL_DATA_SIZE
+	#ifndef DCCRG_CELL_DATA_SIZE_FROM_USER
+		#error DCCRG_CELL_DATA_SIZE_FROM_USER must defined when using DCCRG_VARIABLE_CELL_DATA_SIZE
+	#endif
+	#ifdef DCCRG_USER_MPI_DATA_TYPE
+		#error DCCRG_USER_MPI_DATA_TYPE cannot be used with DCCRG_VARIABLE_CELL_DATA_SIZE
+	#endif
+#endif
+
+#ifdef DCCRG_SEND_SINGLE_CELLS
+	#warning DCCRG_SEND_SINGLE_CELLS is deprecated, use Dccrg::set_transfer_policy(SINGLE_CELL_TRANSFER) instead
+#endif
+
+#ifdef DCCRG_PACK_CELL_DATA
+	#ifdef DCCRG_SEND_SINGLE_CELLS
+		#error DCCRG_PACK_CELL_DATA cannot be used with DCCRG_SEND_SINGLE_CELLS
+	#endif
+#endif
+
+#ifndef DCCRG_TRANSFER_TUNING_UPDATES
+#define DCCRG_TRANSFER_TUNING_UPDATES 5
+#endif
+
+#ifndef DCCRG_PREFETCH_DISTANCE
+#define DCCRG_PREFETCH_DISTANCE 4
+#endif
+
 #include "algorithm"
 #include "boost/array.hpp"
 #include "boost/foreach.hpp"
 #include "boost/mpi.hpp"
+#include "boost/serialization/vector.hpp"
 #include "boost/unordered_map.hpp"
 #include "boost/unordered_set.hpp"
 #include "cassert"
@@ -63,19 +117,35 @@ If DCCRG_SEND_SINGLE_CELLS is defined then cell data is sent one cell at a time.
 #include "fstream"
 #include "functional"
 #include "limits"
+#include "map"
+#include "sstream"
 #include "stdint.h"
 #include "utility"
 #include "vector"
 #include "zoltan.h"
 
+#ifdef __linux__
+#include "sched.h"
+#endif
+
 #ifdef USE_SFC
 #include "sfc++.hpp"
 #endif
 
 #include "dccrg_index.hpp"
 #include "dccrg_types.hpp"
+#include "dccrg_statistics.hpp"
+#include "dccrg_trace.hpp"
 #include "dccrg_constant_geometry.hpp"
 
+// SHARED_MEMORY_TRANSFER needs MPI-3 and cells of the same size
+#if defined(DCCRG_CELL_DATA_SIZE_FROM_USER) \
+&& !defined(DCCRG_USER_MPI_DATA_TYPE) \
+&& !defined(DCCRG_VARIABLE_CELL_DATA_SIZE) \
+&& MPI_VERSION >= 3
+#define DCCRG_SHARED_MEMORY_TRANSFER_AVAILABLE
+#endif
+
 
 namespace dccrg
 {
@@ -88,6 +158,48 @@ public:
 	// helper type for iterating over this->cells using BOOST_FOREACH
 	typedef typename std::pair<const uint64_t&, const UserData&> cell_and_data_pair_t;
 
+	// a neighbor of a cell and a pointer to the neighbor's user data, see for_each_cell()
+	typedef typename std::pair<uint64_t, UserData*> neighbor_and_data_t;
+
+	// cells to iterate over in for_each_cell()
+	enum cell_range_t {
+		// all cells on this process
+		ALL_CELLS,
+		// cells on this process without neighbors on other processes
+		INNER_CELLS,
+		// cells on this process with at least one neighbor on another process
+		OUTER_CELLS
+	};
+
+	/*!
+	How user data is transferred between processes.
+
+	Policies that aren't available for UserData fall back to one that is,
+	see get_transfer_policies().
+	*/
+	enum transfer_policy_t {
+		// time every available policy during the first neighbor data updates and use the fastest one
+		AUTOMATIC_TRANSFER,
+		// one message per cell, see get_tagged_send_lists() and set_single_cell_transfer_limits()
+		SINGLE_CELL_TRANSFER,
+		// one message per process using an MPI datatype that describes the data of all cells
+		DATATYPE_TRANSFER,
+		// one message per process from a contiguous buffer into which the data of cells is copied
+		PACKED_TRANSFER,
+		// one message per process from a buffer into which cells are serialized with boost::mpi
+		SERIALIZED_TRANSFER,
+		// one MPI-3 neighborhood collective for all processes, only used for neighbor data updates
+		NEIGHBORHOOD_TRANSFER,
+		/*
+		processes of the same node copy data from each other's MPI-3 shared memory window,
+		PACKED_TRANSFER between other processes, only used for neighbor data updates.
+		Received data is still copied into the process' own remote neighbor data, in addition
+		every process allocates a window of 2 * UserData::size() bytes per cell it sends to
+		processes of its node, the window is double buffered so that one barrier per update suffices
+		*/
+		SHARED_MEMORY_TRANSFER
+	};
+
 
 	/*!
 	Creates an uninitialized instance of the grid.
@@ -98,6 +210,76 @@ public:
 	Dccrg()
 	{
 		this->initialized = false;
+		this->cell_lists_version = 0;
+
+		#ifdef DCCRG_SEND_SINGLE_CELLS
+		this->transfer_policy = SINGLE_CELL_TRANSFER;
+		#elif defined(DCCRG_PACK_CELL_DATA)
+		this->transfer_policy = PACKED_TRANSFER;
+		#else
+		this->transfer_policy = DATATYPE_TRANSFER;
+		#endif
+		this->active_transfer_policy = this->resolve_transfer_policy(this->transfer_policy, false);
+		this->tuning_updates = 0;
+		this->tuning_current_update = false;
+		this->update_transfer_time = 0;
+
+		// smallest MPI_TAG_UB allowed by the standard
+		this->max_tag = 32767;
+		this->max_single_cell_messages = 10000;
+		this->cells_per_coalesced_message = 100;
+		this->migration_buffer_size = 0;
+		this->collect_statistics = false;
+		this->trace_file = NULL;
+		this->trace_start_time = 0;
+		this->migrated_cells = 0;
+		this->migrated_bytes = 0;
+		this->migrated_weight = -1;
+		this->rebalancing_horizon = 100;
+		this->rebalancing_min_steps = 3;
+		this->rebalancing_threshold = 1;
+		this->rebalancing_partition_time = 0;
+		this->rebalancing_seconds_per_byte = 1e-9;
+		this->rebalancing_log = NULL;
+		this->rebalancing_steps = 0;
+		this->rebalancing_step_time = 0;
+		this->rebalancing_total_steps = 0;
+
+		#if defined(DCCRG_CELL_DATA_SIZE_FROM_USER) && MPI_VERSION >= 3
+		this->neighborhood_comm = MPI_COMM_NULL;
+		this->neighborhood_comm_version = 0;
+		#endif
+
+		#ifdef DCCRG_SHARED_MEMORY_TRANSFER_AVAILABLE
+		this->node_comm = MPI_COMM_NULL;
+		this->shared_window = MPI_WIN_NULL;
+		this->shared_window_version = 0;
+		this->shared_transfers = 0;
+		#endif
+	}
+
+
+	~Dccrg()
+	{
+		this->stop_tracing();
+
+		#if defined(DCCRG_CELL_DATA_SIZE_FROM_USER) && MPI_VERSION >= 3
+		int finalized = 1;
+		MPI_Finalized(&finalized);
+		if (!finalized && this->neighborhood_comm != MPI_COMM_NULL) {
+			MPI_Comm_free(&(this->neighborhood_comm));
+		}
+
+		#ifdef DCCRG_SHARED_MEMORY_TRANSFER_AVAILABLE
+		if (!finalized) {
+			this->free_shared_window();
+			if (this->node_comm != MPI_COMM_NULL) {
+				MPI_Comm_free(&(this->node_comm));
+			}
+		}
+		#endif
+
+		#endif
 	}
 
 
@@ -158,6 +340,13 @@ public:
 
 		this->comm = comm;
 
+		int* tag_ub = NULL;
+		int has_tag_ub = 0;
+		MPI_Comm_get_attr(this->comm, MPI_TAG_UB, &tag_ub, &has_tag_ub);
+		if (has_tag_ub && tag_ub != NULL) {
+			this->max_tag = *tag_ub;
+		}
+
 		/*
 		Setup Zoltan
 		*/
@@ -188,7 +377,8 @@ public:
 		// set reserved options
 		Zoltan_Set_Param(this->zoltan, "EDGE_WEIGHT_DIM", "0");	// 0 because Zoltan crashes in hierarchial with larger values
 		Zoltan_Set_Param(this->zoltan, "NUM_GID_ENTRIES", "1");
-		Zoltan_Set_Param(this->zoltan, "NUM_LID_ENTRIES", "0");
+		// local ids are indices into zoltan_cells
+		Zoltan_Set_Param(this->zoltan, "NUM_LID_ENTRIES", "1");
 		Zoltan_Set_Param(this->zoltan, "OBJ_WEIGHT_DIM", "1");
 		Zoltan_Set_Param(this->zoltan, "RETURN_LISTS", "ALL");
 
@@ -388,9 +578,12 @@ public:
 		#endif
 
 		// update neighbor lists of created cells
-		BOOST_FOREACH(const cell_and_data_pair_t& item, this->cells) {
-			this->neighbors[item.first] = this->find_neighbors_of(item.first);
-			this->neighbors_to[item.first] = this->find_neighbors_to(item.first);
+		{
+			Phase_Timer timer(this->get_active_statistics(), "neighbor_lists");
+			BOOST_FOREACH(const cell_and_data_pair_t& item, this->cells) {
+				this->find_neighbors_of(item.first, this->neighbors[item.first]);
+				this->neighbors_to[item.first] = this->find_neighbors_to(item.first);
+			}
 		}
 		#ifdef DEBUG
 		if (!this->verify_neighbors()) {
@@ -400,8 +593,11 @@ public:
 		}
 		#endif
 
-		BOOST_FOREACH(const cell_and_data_pair_t& item, this->cells) {
-			this->update_remote_neighbor_info(item.first);
+		{
+			Phase_Timer timer(this->get_active_statistics(), "remote_neighbor_info");
+			BOOST_FOREACH(const cell_and_data_pair_t& item, this->cells) {
+				this->update_remote_neighbor_info(item.first);
+			}
 		}
 		#ifdef DEBUG
 		if (!this->verify_remote_neighbor_info()) {
@@ -411,62 +607,20 @@ public:
 		#endif
 
 		this->recalculate_neighbor_update_send_receive_lists();
+		this->update_cell_lists();
 
 		this->initialized = true;
 	}
 
 
 	/*!
-	Returns all cells on this process that don't have children (e.g. leaf cells)
+	Returns all cells on this process that don't have children (e.g. leaf cells) sorted by id.
+
+	The returned list is updated only when cells are created, removed or moved between processes.
 	*/
-	std::vector<uint64_t> get_cells(void) const
+	const std::vector<uint64_t>& get_cells(void) const
 	{
-		std::vector<uint64_t> all_cells;
-		all_cells.reserve(this->cells.size());
-
-		BOOST_FOREACH(const cell_and_data_pair_t& item, this->cells) {
-
-			#ifdef DEBUG
-			if (this->cell_process.count(item.first) == 0) {
-				std::cerr << __FILE__ << ":" << __LINE__
-					<< " Cell " << item.first
-					<< " shouldn't exist"
-					<< std::endl;
-				abort();
-			}
-
-			if (this->cell_process.at(item.first) != this->comm.rank()) {
-				std::cerr << __FILE__ << ":" << __LINE__
-					<< " Process " << this->comm.rank()
-					<< ": Cell " << item.first
-					<< " should be on process " << this->cell_process.at(item.first)
-					<< std::endl;
-				abort();
-			}
-
-			const uint64_t child = this->get_child(item.first);
-			if (child == 0) {
-				std::cerr << __FILE__ << ":" << __LINE__
-					<< " Process " << this->comm.rank()
-					<< ": Child == 0 for cell " << item.first
-					<< std::endl;
-				abort();
-			}
-
-			if (child != item.first) {
-				std::cerr << __FILE__ << ":" << __LINE__
-					<< " Process " << this->comm.rank()
-					<< ": Cell " << item.first
-					<< " has a child"
-					<< std::endl;
-				abort();
-			}
-			#endif
-
-			all_cells.push_back(item.first);
-		}
-
-		return all_cells;
+		return this->local_cells;
 	}
 
 	/*!
@@ -496,111 +650,106 @@ public:
 
 
 	/*!
-	Returns all cells on this process that don't have children (e.g. leaf cells) and don't have neighbors on other processes
+	Returns all cells on this process that don't have children (e.g. leaf cells) and don't have neighbors on other processes sorted by id.
+
+	The returned list is updated only when cells are created, removed or moved between processes.
 	*/
-	std::vector<uint64_t> get_cells_with_local_neighbors(void) const
+	const std::vector<uint64_t>& get_cells_with_local_neighbors(void) const
 	{
-		std::vector<uint64_t> return_cells;
-		return_cells.reserve(this->cells.size());
-
-		BOOST_FOREACH(const cell_and_data_pair_t& item, this->cells) {
-
-			uint64_t child = this->get_child(item.first);
-			assert(child > 0);
-
-			if (child != item.first) {
-				continue;
-			}
-
-			bool has_remote_neighbor = false;
-
-			assert(this->neighbors.count(item.first) > 0);
-
-			BOOST_FOREACH(const uint64_t& neighbor, this->neighbors.at(item.first)) {
-
-				if (neighbor == 0) {
-					continue;
-				}
-
-				if (this->cell_process.at(neighbor) != this->comm.rank()) {
-					has_remote_neighbor = true;
-					break;
-				}
-			}
-
-			if (!has_remote_neighbor) {
-				return_cells.push_back(item.first);
-			}
-		}
-
-		return return_cells;
+		return this->inner_cells;
 	}
 
 
 	/*!
-	Returns all cells on this process that don't have children (e.g. leaf cells) and have at least one neighbor on another processes
+	Returns all cells on this process that don't have children (e.g. leaf cells) and have at least one neighbor on another processes sorted by id.
+
+	The returned list is updated only when cells are created, removed or moved between processes.
 	*/
-	std::vector<uint64_t> get_cells_with_remote_neighbor(void) const
+	const std::vector<uint64_t>& get_cells_with_remote_neighbor(void) const
 	{
-		std::vector<uint64_t> return_cells;
-		return_cells.reserve(this->cells.size());
-
-		BOOST_FOREACH(const cell_and_data_pair_t& item, this->cells) {
-
-			uint64_t child = this->get_child(item.first);
-			assert(child > 0);
-
-			if (child != item.first) {
-				continue;
-			}
-
-			bool has_remote_neighbor = false;
+		return this->outer_cells;
+	}
 
-			assert(this->neighbors.count(item.first) > 0);
 
-			BOOST_FOREACH(const uint64_t& neighbor, this->neighbors.at(item.first)) {
+	/*!
+	Returns all cells in the grid that don't have children (e.g. leaf cells) sorted by id.
 
-				if (neighbor == 0) {
-					continue;
-				}
+	The returned list is updated only when cells are created, removed or moved between processes.
+	*/
+	const std::vector<uint64_t>& get_all_cells(void) const
+	{
+		return this->all_cells;
+	}
 
-				if (this->cell_process.at(neighbor) != this->comm.rank()) {
-					has_remote_neighbor = true;
-					break;
-				}
-			}
 
-			if (has_remote_neighbor) {
-				return_cells.push_back(item.first);
-			}
-		}
+	/*!
+	Returns the version of the lists returned by get_cells(), get_all_cells(), etc.
 
-		return return_cells;
+	The version changes every time the lists are updated.
+	*/
+	uint64_t get_cell_lists_version(void) const
+	{
+		return this->cell_lists_version;
 	}
 
 
 	/*!
-	Returns all cells in the grid that don't have children (e.g. leaf cells)
+	Calls the given functor for every cell on this process in given range and returns the functor.
+
+	The functor is called as
+		functor(cell, data, neighbors_begin, neighbors_end)
+	with const uint64_t cell, UserData& data of the cell and const neighbor_and_data_t* neighbors_begin
+	and neighbors_end spanning the cell's neighbors in the same order as in get_neighbors(cell).
+	The data pointer of neighbors that don't exist (e.g. outside of the grid) is NULL and of
+	neighbors on other processes points to their data from the latest remote neighbor data update.
+	Cells, their data and neighbors are resolved only when cells are created, removed or moved between
+	processes and INNER_CELLS are iterated in the same order as get_cells_with_local_neighbors(),
+	OUTER_CELLS in the same order as get_cells_with_remote_neighbor() and ALL_CELLS as INNER_CELLS
+	followed by OUTER_CELLS.
 	*/
-	std::vector<uint64_t> get_all_cells(void) const
+	template<class Functor> Functor for_each_cell(const cell_range_t range, Functor functor)
 	{
-		std::vector<uint64_t> all_cells;
-		all_cells.reserve(this->cell_process.size());
-
-		for (boost::unordered_map<uint64_t, int>::const_iterator
-			item = this->cell_process.begin();
-			item != this->cell_process.end();
-			item++
-		) {
-
-			const uint64_t child = this->get_child(item->first);
-
-			if (child == item->first) {
-				all_cells.push_back(item->first);
+		size_t first = 0, last = this->iteration_data.size();
+		switch (range) {
+		case INNER_CELLS:
+			last = this->inner_cells.size();
+			break;
+		case OUTER_CELLS:
+			first = this->inner_cells.size();
+			break;
+		default:
+			break;
+		}
+
+		if (first >= last) {
+			return functor;
+		}
+
+		const neighbor_and_data_t* const neighbors_of
+			= this->iteration_neighbors.empty() ? NULL : &(this->iteration_neighbors[0]);
+
+		for (size_t i = first; i < last; i++) {
+
+			#if defined(__GNUC__) && DCCRG_PREFETCH_DISTANCE > 0
+			// data of upcoming cells and their neighbors
+			if (i + DCCRG_PREFETCH_DISTANCE < last) {
+				const size_t next = i + DCCRG_PREFETCH_DISTANCE;
+				__builtin_prefetch(this->iteration_data[next].second);
+				for (size_t j = this->iteration_neighbor_offsets[next]; j < this->iteration_neighbor_offsets[next + 1]; j++) {
+					__builtin_prefetch(neighbors_of[j].second);
+				}
 			}
+			#endif
+
+			functor(
+				this->iteration_data[i].first,
+				*(this->iteration_data[i].second),
+				neighbors_of + this->iteration_neighbor_offsets[i],
+				neighbors_of + this->iteration_neighbor_offsets[i + 1]
+			);
 		}
 
-		return all_cells;
+		return functor;
 	}
 
 
@@ -625,110 +774,278 @@ public:
 
 
 	/*!
-	Refines the grid so that at least the given cells whose parents are on this process will exist in the grid.
-
-	Must be called simultaneously on all processes.
-	Does not store the user data of any refined cell.
-	Returns true on this process if successful and false if given an invalid cell (0 or a cell with a too large refinement level).
+	Refines the grid so that the given cells will exist in the grid.
+
+	Must be called simultaneously on all processes, for example when restarting from cells saved by a previous run.
+	The given cells must be from a grid with the same refinement level difference requirements as this one,
+	all of their ancestors are refined in bulk one refinement level at a time without inducing refines.
+	Created cells are on the process of their parent.
+	Discards refines / unrefines and does not store the user data of any refined cell.
+	Returns true if successful and false on all processes if any process was given an invalid cell
+	(0 or a cell with a too large refinement level).
 	*/
 	bool load(const std::vector<uint64_t>& cells)
 	{
-		// see for example http://www.informit.com/articles/article.aspx?p=376878&rll=1 for an explanation about template<template...
-
-		// calculate which cells must be refined...
-		boost::unordered_set<uint64_t> cells_to_refine;
+		// ancestors of given cells by refinement level...
+		std::vector<boost::unordered_set<uint64_t> > ancestors(this->max_refinement_level + 1);
+		int deepest_ancestor = -1;
 
 		// ...and check for invalid cells
+		int invalid_cells = 0;
 		BOOST_FOREACH(const uint64_t& cell, cells) {
 
-			if (cell == 0) {
-				return false;
+			if (cell == error_cell) {
+				invalid_cells = 1;
+				break;
 			}
 
-			if (this->get_refinement_level(cell) < 0) {
-				return false;
+			int refinement_level = this->get_refinement_level(cell);
+			if (refinement_level < 0) {
+				invalid_cells = 1;
+				break;
 			}
 
-			// refine all parents of current cell
-			uint64_t parent = this->get_parent_for_removed(cell);
-			while (parent != this->get_parent_for_removed(parent)) {
-				cells_to_refine.insert(parent);
+			deepest_ancestor = std::max(deepest_ancestor, refinement_level - 1);
+
+			uint64_t ancestor = cell;
+			while (refinement_level > 0) {
+				ancestor = this->get_parent_for_removed(ancestor);
+				refinement_level--;
+
+				// rest of the ancestors have been inserted already
+				if (!ancestors[refinement_level].insert(ancestor).second) {
+					break;
+				}
 			}
-			cells_to_refine.insert(parent);
 		}
 
-		// keep refining until no more refines on any process, TODO
+		if (all_reduce(this->comm, invalid_cells, boost::mpi::maximum<int>()) > 0) {
+			return false;
+		}
 
-		return true;
-	}
+		deepest_ancestor = all_reduce(this->comm, deepest_ancestor, boost::mpi::maximum<int>());
 
+		this->cells_to_refine.clear();
+		this->cells_to_unrefine.clear();
+		this->cells_not_to_unrefine.clear();
 
-	/*!
-	\brief Load balances the grid's cells among processes.
+		for (int refinement_level = 0; refinement_level <= deepest_ancestor; refinement_level++) {
 
-	Must be called simultaneously on all processes.
-	Cells which haven't been pinned are moved as suggested by Zoltan, pinned cells are moved as requested by the user.
-	Does not update remote neighbor data between processes afterward.
-	Discards refines / unrefines.
+			// skip ancestors that have been refined already
+			std::vector<uint64_t> local_cells_to_refine;
+			local_cells_to_refine.reserve(ancestors[refinement_level].size());
+			BOOST_FOREACH(const uint64_t& ancestor, ancestors[refinement_level]) {
+				if (this->cell_process.count(ancestor) > 0
+				&& ancestor == this->get_child(ancestor)) {
+					local_cells_to_refine.push_back(ancestor);
+				}
+			}
+			ancestors[refinement_level].clear();
 
-	If prepare_to_balance_load was called before this then has_been_prepared must be true
-	otherwise it must be false.
-	*/
-	void balance_load(const bool has_been_prepared = false)
-	{
-		if (!has_been_prepared) {
-			this->make_new_partition(true);
+			std::vector<std::vector<uint64_t> > all_cells_to_refine;
+			all_gather(this->comm, local_cells_to_refine, all_cells_to_refine);
+
+			BOOST_FOREACH(const std::vector<uint64_t>& item, all_cells_to_refine) {
+				this->cells_to_refine.insert(item.begin(), item.end());
+			}
+
+			// identical on all processes
+			if (this->cells_to_refine.size() > 0) {
+				this->execute_refines();
+			}
 		}
-		this->move_cells();
-		this->added_cells.clear();
-		this->removed_cells.clear();
+
+		this->clear_refined_unrefined_data();
+
+		return true;
 	}
 
+
 	/*!
-	Moves pinned grid cells as requested by the user.
+	As load(cells) but afterwards also moves cells[i] to processes[i].
 
 	Must be called simultaneously on all processes.
-	Cells which haven't been pinned are not moved.
+	Cells that have been pinned or that have children after loading are not moved.
+	If several processes give a different process for the same cell one of them is used.
 	Does not update remote neighbor data between processes afterward.
-	Discards refines / unrefines.
-
-	If prepare_to_migrate_cells was called before this then
-	has_been_prepared must be true otherwise it must be false.
+	Returns true if successful and false on all processes if any process was given
+	an invalid cell or process or if cells and processes are of different size.
 	*/
-	void migrate_cells(const bool has_been_prepared = false)
+	bool load(const std::vector<uint64_t>& cells, const std::vector<int>& processes)
 	{
-		if (!has_been_prepared) {
-			this->make_new_partition(false);
+		int invalid_processes = 0;
+		if (cells.size() != processes.size()) {
+			invalid_processes = 1;
 		}
-		this->move_cells();
-		this->added_cells.clear();
-		this->removed_cells.clear();
-	}
 
+		BOOST_FOREACH(const int& process, processes) {
+			if (process < 0 || process >= this->comm.size()) {
+				invalid_processes = 1;
+				break;
+			}
+		}
 
-	/*!
-	Same as balance_load but only prepares to move cells with balance_load.
-
-	Must be used when cells contain variable mpi_datatypes so that when
-	cells are moved receiving processes can construct the receiving
-	datatypes in balance_load based on cells data transferred by this function.
-	The next dccrg function to be called after this one must be balance_load.
+		if (all_reduce(this->comm, invalid_processes, boost::mpi::maximum<int>()) > 0) {
+			return false;
+		}
 
-	When calling balance_load after this function has_been_prepared must be true.
-	*/
-	void prepare_to_balance_load(void)
-	{
-		this->make_new_partition(true);
-		this->prepare_to_move_cells();
-	}
+		if (!this->load(cells)) {
+			return false;
+		}
 
-	/*!
-	Same as migrate_cells but only prepares to move cells with migrate_cells.
+		// tell current processes of cells where to send them
+		std::vector<std::vector<uint64_t> > move_requests(this->comm.size()), all_move_requests;
+		for (unsigned int i = 0; i < cells.size(); i++) {
 
-	Must be used when cells contain variable mpi_datatypes so that when
-	cells are moved receiving processes can construct the receiving
-	datatypes in migrate_cells based on cells data transferred by this function.
-	The next dccrg function to be called after this one must be migrate_cells.
+			const uint64_t cell = cells[i];
+			if (this->cell_process.count(cell) == 0
+			|| cell != this->get_child(cell)
+			|| this->pin_requests.count(cell) > 0) {
+				continue;
+			}
+
+			const int current_process = this->cell_process.at(cell);
+			if (current_process == processes[i]) {
+				continue;
+			}
+
+			move_requests[current_process].push_back(cell);
+			move_requests[current_process].push_back(uint64_t(processes[i]));
+		}
+		all_to_all(this->comm, move_requests, all_move_requests);
+
+		this->cells_to_send.clear();
+		this->cells_to_receive.clear();
+
+		// tell new processes of cells where to receive them from
+		std::vector<std::vector<uint64_t> > moved_cells(this->comm.size()), all_moved_cells;
+		BOOST_FOREACH(const std::vector<uint64_t>& item, all_move_requests) {
+			for (unsigned int i = 0; i < item.size(); i += 2) {
+
+				const uint64_t cell = item[i];
+				const int destination_process = int(item[i + 1]);
+
+				#ifdef DEBUG
+				if (this->cells.count(cell) == 0) {
+					std::cerr << __FILE__ << ":" << __LINE__
+						<< " Cell " << cell
+						<< " isn't on process " << this->comm.rank()
+						<< std::endl;
+					abort();
+				}
+				#endif
+
+				if (this->removed_cells.count(cell) > 0) {
+					continue;
+				}
+
+				this->cells_to_send[destination_process].push_back(cell);
+				this->removed_cells.insert(cell);
+				moved_cells[destination_process].push_back(cell);
+			}
+		}
+		all_to_all(this->comm, moved_cells, all_moved_cells);
+
+		for (int sender = 0; sender < int(all_moved_cells.size()); sender++) {
+			BOOST_FOREACH(const uint64_t& cell, all_moved_cells[sender]) {
+				this->cells_to_receive[sender].push_back(cell);
+				this->added_cells.insert(cell);
+			}
+		}
+
+		// send and receive cells in known order
+		for (
+			boost::unordered_map<int, std::vector<uint64_t> >::iterator
+			receiver = this->cells_to_send.begin();
+			receiver != this->cells_to_send.end();
+			receiver++
+		) {
+			std::sort(receiver->second.begin(), receiver->second.end());
+		}
+
+		for (
+			boost::unordered_map<int, std::vector<uint64_t> >::iterator
+			sender = this->cells_to_receive.begin();
+			sender != this->cells_to_receive.end();
+			sender++
+		) {
+			std::sort(sender->second.begin(), sender->second.end());
+		}
+
+		this->move_cells();
+		this->added_cells.clear();
+		this->removed_cells.clear();
+
+		return true;
+	}
+
+
+	/*!
+	\brief Load balances the grid's cells among processes.
+
+	Must be called simultaneously on all processes.
+	Cells which haven't been pinned are moved as suggested by Zoltan, pinned cells are moved as requested by the user.
+	Does not update remote neighbor data between processes afterward.
+	Discards refines / unrefines.
+
+	If prepare_to_balance_load was called before this then has_been_prepared must be true
+	otherwise it must be false.
+	*/
+	void balance_load(const bool has_been_prepared = false)
+	{
+		if (!has_been_prepared) {
+			this->make_new_partition(true);
+		}
+		this->move_cells();
+		this->added_cells.clear();
+		this->removed_cells.clear();
+	}
+
+	/*!
+	Moves pinned grid cells as requested by the user.
+
+	Must be called simultaneously on all processes.
+	Cells which haven't been pinned are not moved.
+	Does not update remote neighbor data between processes afterward.
+	Discards refines / unrefines.
+
+	If prepare_to_migrate_cells was called before this then
+	has_been_prepared must be true otherwise it must be false.
+	*/
+	void migrate_cells(const bool has_been_prepared = false)
+	{
+		if (!has_been_prepared) {
+			this->make_new_partition(false);
+		}
+		this->move_cells();
+		this->added_cells.clear();
+		this->removed_cells.clear();
+	}
+
+
+	/*!
+	Same as balance_load but only prepares to move cells with balance_load.
+
+	Must be used when cells contain variable mpi_datatypes so that when
+	cells are moved receiving processes can construct the receiving
+	datatypes in balance_load based on cells data transferred by this function.
+	The next dccrg function to be called after this one must be balance_load.
+
+	When calling balance_load after this function has_been_prepared must be true.
+	*/
+	void prepare_to_balance_load(void)
+	{
+		this->make_new_partition(true);
+		this->prepare_to_move_cells();
+	}
+
+	/*!
+	Same as migrate_cells but only prepares to move cells with migrate_cells.
+
+	Must be used when cells contain variable mpi_datatypes so that when
+	cells are moved receiving processes can construct the receiving
+	datatypes in migrate_cells based on cells data transferred by this function.
+	The next dccrg function to be called after this one must be migrate_cells.
 
 	When calling migrate_cells after this function has_been_prepared must be true.
 	*/
@@ -756,21 +1073,45 @@ public:
 	}
 
 
+	/*!
+	Same as update_remote_neighbor_data(void) but transfers user data using given policy.
+
+	The policy must be the same on all processes.
+	*/
+	void update_remote_neighbor_data(const transfer_policy_t policy)
+	{
+		this->start_remote_neighbor_data_update(policy);
+		this->wait_neighbor_data_update();
+	}
+
+
 	/*!
 	Starts the update of neighbor data between processes and returns before (probably) it has completed
 	Must be called simultaneously on all processes
 	*/
 	void start_remote_neighbor_data_update(void)
 	{
+		this->start_remote_neighbor_data_update(this->transfer_policy);
+	}
+
+
+	/*!
+	Same as start_remote_neighbor_data_update(void) but transfers user data using given policy.
+
+	The policy must be the same on all processes.
+	*/
+	void start_remote_neighbor_data_update(const transfer_policy_t policy)
+	{
+		Phase_Timer timer(this->get_active_statistics(), "neighbor_update_start");
+		const double start_time = MPI_Wtime();
+		this->update_transfer_time = 0;
+
 		this->start_user_data_transfers(
-		#ifdef DCCRG_SEND_SINGLE_CELLS
-		this->remote_neighbors
-		#else
-		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
-		this->remote_neighbors
-		#endif
-		#endif
+			this->remote_neighbors,
+			this->get_neighbor_update_policy(policy)
 		);
+
+		this->update_transfer_time += MPI_Wtime() - start_time;
 	}
 
 
@@ -791,7 +1132,21 @@ public:
 	*/
 	void wait_neighbor_data_update_sends(void)
 	{
+		Phase_Timer timer(this->get_active_statistics(), "neighbor_update_wait_sends");
+		const double start_time = MPI_Wtime();
 		this->wait_user_data_transfer_sends();
+		this->update_transfer_time += MPI_Wtime() - start_time;
+
+		// the update has finished
+		if (this->tuning_current_update) {
+			for (size_t i = 0; i < this->tuned_policies.size(); i++) {
+				if (this->tuned_policies[i] == this->active_transfer_policy) {
+					this->tuned_times[i] += this->update_transfer_time;
+				}
+			}
+			this->tuning_updates++;
+			this->tuning_current_update = false;
+		}
 	}
 
 
@@ -801,143 +1156,398 @@ public:
 	*/
 	void wait_neighbor_data_update_receives(void)
 	{
-		this->wait_user_data_transfer_receives(
-		#ifndef DCCRG_SEND_SINGLE_CELLS
-		#ifndef DCCRG_CELL_DATA_SIZE_FROM_USER
-		this->remote_neighbors
-		#endif
-		#endif
-		);
+		Phase_Timer timer(this->get_active_statistics(), "neighbor_update_wait_receives");
+		const double start_time = MPI_Wtime();
+		this->wait_user_data_transfer_receives(this->remote_neighbors);
+		this->update_transfer_time += MPI_Wtime() - start_time;
 	}
 
 
 	/*!
-	Returns the number of cells whose data this process has to send during a neighbor data update.
-
-	The total amount of cells to be sent is returned so if a cell's data will be sent to
-	N processes it is counted N times.
+	Sets the policy used for transferring user data between processes.
+
+	Must be called simultaneously on all processes with the same policy.
+	The policy is used for neighbor data updates and, except for
+	NEIGHBORHOOD_TRANSFER and SHARED_MEMORY_TRANSFER, also when cells
+	are moved between processes or refined / unrefined.
+	With AUTOMATIC_TRANSFER each available policy is timed during DCCRG_TRANSFER_TUNING_UPDATES
+	neighbor data updates, after which the fastest one is used.
+	Calling this again with AUTOMATIC_TRANSFER restarts the timing.
 	*/
-	uint64_t get_number_of_update_send_cells(void) const
+	void set_transfer_policy(const transfer_policy_t policy)
 	{
-		uint64_t result = 0;
-		for (
-			#ifdef DCCRG_SEND_SINGLE_CELLS
-			boost::unordered_map<int, std::vector<std::pair<uint64_t, int> > >::const_iterator
-			#else
-			boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
-			#endif
-			receiver = cells_to_send.begin();
-			receiver != cells_to_send.end();
-			receiver++
-		) {
-			result += receiver->second.size();
-		}
-		return result;
+		this->transfer_policy = policy;
+		this->tuned_policies.clear();
+		this->tuned_times.clear();
+		this->tuning_updates = 0;
+		this->tuning_current_update = false;
 	}
 
+
 	/*!
-	Returns the number of cells whose data this process has to receive during a neighbor data update.
+	Returns the transfer policy set by the user or the default policy.
 	*/
-	uint64_t get_number_of_update_receive_cells(void) const
+	transfer_policy_t get_transfer_policy(void) const
 	{
-		uint64_t result = 0;
-		for (
-			#ifdef DCCRG_SEND_SINGLE_CELLS
-			boost::unordered_map<int, std::vector<std::pair<uint64_t, int> > >::const_iterator
-			#else
-			boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
-			#endif
-			sender = cells_to_receive.begin();
-			sender != cells_to_receive.end();
-			sender++
-		) {
-			result += sender->second.size();
-		}
-		return result;
+		return this->transfer_policy;
 	}
 
 
 	/*!
-	Returns a pointer to the neighbors of given cell.
+	Returns the policy that was used for the latest transfer of user data between processes.
 
-	In case the grid is not periodic in one or more directions,
-	neighbors that would be outside of the grid are 0.
-	Some neighbors might be on another process, but have a copy of their data on this process.
-	The local copy of remote neighbors' data is updated, for example, by calling
-	update_remote_neighbor_data().
-	Returns NULL if given cell doesn't exist or is on another process.
+	Unlike get_transfer_policy() never returns AUTOMATIC_TRANSFER
+	or a policy that isn't available for UserData.
 	*/
-	const std::vector<uint64_t>* get_neighbors(const uint64_t cell) const
+	transfer_policy_t get_active_transfer_policy(void) const
 	{
-		if (this->cells.count(cell) > 0) {
-			#ifdef DEBUG
-			if (this->neighbors.count(cell) == 0) {
-				std::cerr << __FILE__ << ":" << __LINE__
-					<< " Process " << this->comm.rank()
-					<< ": Neighbor list for cell " << cell
-					<< " doesn't exist"
-					<< std::endl;
-				abort();
-			}
-			#endif
-			return &(this->neighbors.at(cell));
-		} else {
-			return NULL;
-		}
+		return this->active_transfer_policy;
 	}
 
-	/*!
-	Returns a pointer to the cells that consider given cell as a neighbor.
 
-	This list doesn't include 0s even if the grid isn't periodic in some direction.
-	Returns NULL if given cell doesn't exist or is on another process
+	/*!
+	Returns the transfer policies available for UserData.
+
+	Other policies fall back to:
+		DATATYPE_TRANSFER -> SERIALIZED_TRANSFER if UserData isn't an MPI datatype in boost::mpi
+		PACKED_TRANSFER -> DATATYPE_TRANSFER with DCCRG_USER_MPI_DATA_TYPE,
+			SERIALIZED_TRANSFER without DCCRG_CELL_DATA_SIZE_FROM_USER
+		SERIALIZED_TRANSFER -> PACKED_TRANSFER or DATATYPE_TRANSFER with DCCRG_CELL_DATA_SIZE_FROM_USER
+		NEIGHBORHOOD_TRANSFER -> DATATYPE_TRANSFER without MPI-3 or DCCRG_CELL_DATA_SIZE_FROM_USER
+		SHARED_MEMORY_TRANSFER -> PACKED_TRANSFER without MPI-3 or with DCCRG_VARIABLE_CELL_DATA_SIZE,
+			as PACKED_TRANSFER otherwise
 	*/
-	const std::vector<uint64_t>* get_neighbors2(const uint64_t cell) const
+	std::vector<transfer_policy_t> get_transfer_policies(void) const
 	{
-		if (this->cells.count(cell) > 0) {
-			#ifdef DEBUG
-			if (this->neighbors_to.count(cell) == 0) {
-				std::cerr << __FILE__ << ":" << __LINE__
-					<< " Neighbors_to list for cell " << cell
-					<< " doesn't exist"
-					<< std::endl;
-				abort();
-			}
-			#endif
-			return &(this->neighbors_to.at(cell));
-		} else {
-			return NULL;
+		std::vector<transfer_policy_t> policies;
+		policies.push_back(SINGLE_CELL_TRANSFER);
+
+		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		policies.push_back(DATATYPE_TRANSFER);
+		#ifndef DCCRG_USER_MPI_DATA_TYPE
+		policies.push_back(PACKED_TRANSFER);
+		#endif
+		#if MPI_VERSION >= 3
+		policies.push_back(NEIGHBORHOOD_TRANSFER);
+		#endif
+		#ifdef DCCRG_SHARED_MEMORY_TRANSFER_AVAILABLE
+		policies.push_back(SHARED_MEMORY_TRANSFER);
+		#endif
+
+		#else	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		if (boost::mpi::is_mpi_datatype<UserData>::value) {
+			policies.push_back(DATATYPE_TRANSFER);
 		}
-	}
+		policies.push_back(SERIALIZED_TRANSFER);
 
+		#endif	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
 
-	/*!
-	Returns the size of cells' neihgbourhood in every direction.
-	*/
-	unsigned int get_neighborhood_size(void) const
-	{
-		return this->neighborhood_size;
+		return policies;
 	}
 
 
 	/*!
-	Returns all neighbors of given cell that are at given offsets from it.
+	Updates remote neighbor data and calls the given functor for every cell on this process as soon as its neighbors' data is available.
 
-	Returns nothing in the following cases:
-		-given cell doesn't exist
-		-given cell is on another process
-		-any of given offsets is larger in absolute value than the neighborhood
-			size or larger than 1 if neihgborhood size == 0
-		- i == 0 && j == 0 && k == 0
+	Must be called simultaneously on all processes.
+	The functor is called as in for_each_cell(), first for INNER_CELLS while remote neighbor data is being
+	transferred and then for each cell in OUTER_CELLS as soon as all processes with its neighbors have
+	sent their data, so cells are not called in any particular order. Data from other processes is checked
+	for between batches of inner cells. Returns after all transfers have completed.
+	As with start_remote_neighbor_data_update() the functor must not modify the data that is sent to other processes.
+	If compiled with OpenMP each batch of cells is processed in parallel so the functor must then be thread-safe.
 	*/
-	std::vector<uint64_t> get_neighbors_of(const uint64_t cell, const int i, const int j, const int k) const
+	template<class Functor> Functor update_remote_neighbor_data(Functor functor)
 	{
-		std::vector<uint64_t> return_neighbors;
-		if (this->cell_process.count(cell) == 0
-		|| this->cell_process.at(cell) != this->comm.rank()
-		|| (i == 0 && j == 0 && k == 0)) {
-			return return_neighbors;
-		}
+		this->start_remote_neighbor_data_update();
+
+		// take over receives from start_remote_neighbor_data_update
+		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+		std::vector<MPI_Request> requests;
+		#else
+		std::vector<boost::mpi::request> requests;
+		#endif
+		std::vector<int> senders;
+		boost::unordered_map<int, size_t> unfinished_receives;
+
+		for (
+			#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+			boost::unordered_map<int, std::vector<MPI_Request> >::const_iterator
+			#else
+			boost::unordered_map<int, std::vector<boost::mpi::request> >::const_iterator
+			#endif
+			sender = this->receive_requests.begin();
+			sender != this->receive_requests.end();
+			sender++
+		) {
+			requests.insert(requests.end(), sender->second.begin(), sender->second.end());
+			senders.insert(senders.end(), sender->second.size(), sender->first);
+			unfinished_receives[sender->first] = sender->second.size();
+		}
+		this->receive_requests.clear();
+
+		std::vector<bool> finished(requests.size(), false);
+		size_t number_of_unfinished = requests.size();
+
+		// outer cells are ready when data from all of their senders has arrived
+		std::vector<unsigned int> missing_senders(this->number_of_senders);
+		std::vector<size_t> ready_cells;
+
+		// data from processes of this node has already been copied
+		for (boost::unordered_map<int, std::vector<size_t> >::const_iterator
+			sender = this->outer_cells_of_sender.begin();
+			sender != this->outer_cells_of_sender.end();
+			sender++
+		) {
+			if (!this->transfers_through_shared_memory(sender->first)) {
+				continue;
+			}
+
+			BOOST_FOREACH(const size_t& cell_index, sender->second) {
+				const size_t outer_index = cell_index - this->inner_cells.size();
+				missing_senders[outer_index]--;
+				if (missing_senders[outer_index] == 0) {
+					ready_cells.push_back(cell_index);
+				}
+			}
+		}
+
+		if (ready_cells.size() > 0) {
+			this->call_for_cells(functor, 0, ready_cells.size(), &(ready_cells[0]));
+			ready_cells.clear();
+		}
+
+		// inner cells are processed in batches between checks for arrived data
+		const size_t batch_size = 64;
+
+		// time spent in MPI waiting for or testing receives and
+		// in receiving data in total, recorded once after all cells
+		double receive_wait = 0, receive_time = 0;
+
+		size_t next_inner = 0;
+		while (next_inner < this->inner_cells.size() || number_of_unfinished > 0) {
+
+			if (next_inner < this->inner_cells.size()) {
+				const size_t last = std::min(next_inner + batch_size, this->inner_cells.size());
+				this->call_for_cells(functor, next_inner, last, NULL);
+				next_inner = last;
+			}
+
+			if (number_of_unfinished == 0) {
+				continue;
+			}
+
+			const double receive_start_time = MPI_Wtime();
+
+			// wait only if there is nothing else to do
+			const std::vector<size_t> completed = this->test_receives(
+				requests,
+				finished,
+				next_inner >= this->inner_cells.size()
+			);
+			receive_wait += MPI_Wtime() - receive_start_time;
+			number_of_unfinished -= completed.size();
+
+			BOOST_FOREACH(const size_t& request, completed) {
+
+				const int sender = senders[request];
+				unfinished_receives.at(sender)--;
+				if (unfinished_receives.at(sender) > 0) {
+					continue;
+				}
+
+				this->incorporate_received_data(sender, this->remote_neighbors);
+
+				// a neighborhood collective receives from all processes at once
+				if (sender == this->comm.rank()) {
+					for (size_t i = 0; i < missing_senders.size(); i++) {
+						if (missing_senders[i] > 0) {
+							missing_senders[i] = 0;
+							ready_cells.push_back(this->inner_cells.size() + i);
+						}
+					}
+					continue;
+				}
+
+				if (this->outer_cells_of_sender.count(sender) == 0) {
+					continue;
+				}
+
+				BOOST_FOREACH(const size_t& cell_index, this->outer_cells_of_sender.at(sender)) {
+					const size_t outer_index = cell_index - this->inner_cells.size();
+					missing_senders[outer_index]--;
+					if (missing_senders[outer_index] == 0) {
+						ready_cells.push_back(cell_index);
+					}
+				}
+			}
+
+			receive_time += MPI_Wtime() - receive_start_time;
+
+			if (ready_cells.size() > 0) {
+				this->call_for_cells(functor, 0, ready_cells.size(), &(ready_cells[0]));
+				ready_cells.clear();
+			}
+		}
+
+		#ifndef DCCRG_CELL_DATA_SIZE_FROM_USER
+		this->incoming_buffers.clear();
+		this->incoming_chunks.clear();
+		#endif
+
+		// same phases as wait_neighbor_data_update_receives() but without the functor calls
+		this->update_transfer_time += receive_time;
+		if (this->get_active_statistics() != NULL) {
+			if (requests.size() > 0) {
+				this->get_active_statistics()->add_phase_call("user_data_wait", receive_wait);
+			}
+			this->get_active_statistics()->add_phase_call("neighbor_update_wait_receives", receive_time);
+		}
+
+		#ifdef DEBUG
+		for (size_t i = 0; i < missing_senders.size(); i++) {
+			if (missing_senders[i] > 0) {
+				std::cerr << __FILE__ << ":" << __LINE__
+					<< " Data from " << missing_senders[i]
+					<< " processes never arrived for cell " << this->outer_cells[i]
+					<< std::endl;
+				abort();
+			}
+		}
+		#endif
+
+		if (this->trace_file != NULL) {
+			this->trace_record.receive_wait = receive_wait;
+			this->trace_record.receives_end_time = MPI_Wtime() - this->trace_start_time;
+		}
+
+		this->wait_neighbor_data_update_sends();
+
+		return functor;
+	}
+
+
+	/*!
+	Returns the number of cells whose data this process has to send during a neighbor data update.
+
+	The total amount of cells to be sent is returned so if a cell's data will be sent to
+	N processes it is counted N times.
+	*/
+	uint64_t get_number_of_update_send_cells(void) const
+	{
+		uint64_t result = 0;
+		for (
+			boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			receiver = cells_to_send.begin();
+			receiver != cells_to_send.end();
+			receiver++
+		) {
+			result += receiver->second.size();
+		}
+		return result;
+	}
+
+	/*!
+	Returns the number of cells whose data this process has to receive during a neighbor data update.
+	*/
+	uint64_t get_number_of_update_receive_cells(void) const
+	{
+		uint64_t result = 0;
+		for (
+			boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			sender = cells_to_receive.begin();
+			sender != cells_to_receive.end();
+			sender++
+		) {
+			result += sender->second.size();
+		}
+		return result;
+	}
+
+
+	/*!
+	Returns a pointer to the neighbors of given cell.
+
+	In case the grid is not periodic in one or more directions,
+	neighbors that would be outside of the grid are 0.
+	Some neighbors might be on another process, but have a copy of their data on this process.
+	The local copy of remote neighbors' data is updated, for example, by calling
+	update_remote_neighbor_data().
+	Returns NULL if given cell doesn't exist or is on another process.
+	*/
+	const std::vector<uint64_t>* get_neighbors(const uint64_t cell) const
+	{
+		if (this->cells.count(cell) > 0) {
+			#ifdef DEBUG
+			if (this->neighbors.count(cell) == 0) {
+				std::cerr << __FILE__ << ":" << __LINE__
+					<< " Process " << this->comm.rank()
+					<< ": Neighbor list for cell " << cell
+					<< " doesn't exist"
+					<< std::endl;
+				abort();
+			}
+			#endif
+			return &(this->neighbors.at(cell));
+		} else {
+			return NULL;
+		}
+	}
+
+	/*!
+	Returns a pointer to the cells that consider given cell as a neighbor.
+
+	This list doesn't include 0s even if the grid isn't periodic in some direction.
+	Returns NULL if given cell doesn't exist or is on another process
+	*/
+	const std::vector<uint64_t>* get_neighbors2(const uint64_t cell) const
+	{
+		if (this->cells.count(cell) > 0) {
+			#ifdef DEBUG
+			if (this->neighbors_to.count(cell) == 0) {
+				std::cerr << __FILE__ << ":" << __LINE__
+					<< " Neighbors_to list for cell " << cell
+					<< " doesn't exist"
+					<< std::endl;
+				abort();
+			}
+			#endif
+			return &(this->neighbors_to.at(cell));
+		} else {
+			return NULL;
+		}
+	}
+
+
+	/*!
+	Returns the size of cells' neihgbourhood in every direction.
+	*/
+	unsigned int get_neighborhood_size(void) const
+	{
+		return this->neighborhood_size;
+	}
+
+
+	/*!
+	Returns all neighbors of given cell that are at given offsets from it.
+
+	Returns nothing in the following cases:
+		-given cell doesn't exist
+		-given cell is on another process
+		-any of given offsets is larger in absolute value than the neighborhood
+			size or larger than 1 if neihgborhood size == 0
+		- i == 0 && j == 0 && k == 0
+	*/
+	std::vector<uint64_t> get_neighbors_of(const uint64_t cell, const int i, const int j, const int k) const
+	{
+		std::vector<uint64_t> return_neighbors;
+		if (this->cell_process.count(cell) == 0
+		|| this->cell_process.at(cell) != this->comm.rank()
+		|| (i == 0 && j == 0 && k == 0)) {
+			return return_neighbors;
+		}
 
 		const int refinement_level = this->get_refinement_level(cell);
 
@@ -1065,8 +1675,7 @@ public:
 			exit(1);
 		}
 
-		std::vector<uint64_t> leaf_cells = this->get_cells();
-		std::sort(leaf_cells.begin(), leaf_cells.end());
+		const std::vector<uint64_t>& leaf_cells = this->get_cells();
 		outfile << "# vtk DataFile Version 2.0" << std::endl;
 		outfile << "Cartesian cell refinable grid" << std::endl;
 		outfile << "ASCII" << std::endl;
@@ -1170,25 +1779,27 @@ public:
 
 		this->cells_to_refine.insert(cell);
 
-		// override local unrefines
-		const std::vector<uint64_t> siblings = this->get_all_children(this->get_parent(cell));
-		BOOST_FOREACH(const uint64_t& sibling, siblings) {
-			this->cells_to_unrefine.erase(sibling);
+		// override local unrefines, unrefined cells are never of refinement level 0
+		boost::array<uint64_t, 8> siblings;
+		if (this->get_octree_siblings(cell, siblings)) {
+			BOOST_FOREACH(const uint64_t& sibling, siblings) {
+				this->cells_to_unrefine.erase(sibling);
+			}
 		}
 
 		BOOST_FOREACH(const uint64_t& neighbor, this->neighbors.at(cell)) {
-			if (this->get_refinement_level(neighbor) <= refinement_level) {
-				const std::vector<uint64_t> neighbor_siblings = this->get_all_children(this->get_parent(neighbor));
-				BOOST_FOREACH(const uint64_t& sibling, neighbor_siblings) {
+			if (this->get_refinement_level(neighbor) <= refinement_level
+			&& this->get_octree_siblings(neighbor, siblings)) {
+				BOOST_FOREACH(const uint64_t& sibling, siblings) {
 					this->cells_to_unrefine.erase(sibling);
 				}
 			}
 		}
 
 		BOOST_FOREACH(const uint64_t& neighbor, this->neighbors_to.at(cell)) {
-			if (this->get_refinement_level(neighbor) <= refinement_level) {
-				const std::vector<uint64_t> neighbor_siblings = this->get_all_children(this->get_parent(neighbor));
-				BOOST_FOREACH(const uint64_t& sibling, neighbor_siblings) {
+			if (this->get_refinement_level(neighbor) <= refinement_level
+			&& this->get_octree_siblings(neighbor, siblings)) {
+				BOOST_FOREACH(const uint64_t& sibling, siblings) {
 					this->cells_to_unrefine.erase(sibling);
 				}
 			}
@@ -1236,12 +1847,12 @@ public:
 			return;
 		}
 
-		if (this->get_refinement_level(cell) == 0) {
+		boost::array<uint64_t, 8> siblings;
+		if (!this->get_octree_siblings(cell, siblings)) {
+			// refinement level is 0
 			return;
 		}
 
-		const std::vector<uint64_t> siblings = this->get_all_children(this->get_parent(cell));
-
 		// don't unrefine if any sibling...
 		BOOST_FOREACH(const uint64_t& sibling, siblings) {
 
@@ -1352,7 +1963,11 @@ public:
 		}
 
 		// record only one sibling / process
-		const std::vector<uint64_t> siblings = this->get_all_children(this->get_parent(cell));
+		boost::array<uint64_t, 8> siblings;
+		if (!this->get_octree_siblings(cell, siblings)) {
+			return;
+		}
+
 		BOOST_FOREACH(const uint64_t& sibling, siblings) {
 			if (this->cells_not_to_unrefine.count(sibling) > 0) {
 				return;
@@ -1406,6 +2021,108 @@ public:
 	}
 
 
+	/*!
+	As stop_refining() but also maps user data between refined / unrefined cells and their children.
+
+	Must be called simultaneously on all processes.
+	prolongation is called once for every cell refined on this process as
+		prolongation(parent, parent_data, children, children_data)
+	with const uint64_t parent, const UserData& parent_data, const boost::array<uint64_t, 8>& children
+	and const boost::array<UserData*, 8>& children_data in the same order as get_all_children().
+	restriction is called once for every cell whose children were unrefined and which is on this process as
+		restriction(parent, parent_data, children, children_data)
+	with const uint64_t parent, UserData& parent_data, const boost::array<uint64_t, 8>& children
+	and const boost::array<const UserData*, 8>& children_data.
+
+	Cells are first collected into contiguous batches after which all prolongations are called followed
+	by all restrictions, without any further lookups into the grid. If compiled with OpenMP the batches
+	are processed in parallel so the functors must then be thread-safe.
+	Data of refined and unrefined cells is freed afterwards, e.g. get_removed_cells() returns nothing.
+	Returns cells that were created by refinement on this process.
+	*/
+	template<class Prolongation, class Restriction> std::vector<uint64_t> stop_refining(Prolongation prolongation, Restriction restriction)
+	{
+		const std::vector<uint64_t> new_cells = this->stop_refining();
+
+		// parents of refined cells
+		std::vector<uint64_t> refined_parents;
+		std::vector<const UserData*> refined_parent_data;
+		std::vector<boost::array<uint64_t, 8> > refined_children;
+		std::vector<boost::array<UserData*, 8> > refined_children_data;
+
+		refined_parents.reserve(this->refined_cell_data.size());
+		refined_parent_data.reserve(this->refined_cell_data.size());
+		refined_children.reserve(this->refined_cell_data.size());
+		refined_children_data.reserve(this->refined_cell_data.size());
+
+		BOOST_FOREACH(const cell_and_data_pair_t& item, this->refined_cell_data) {
+
+			refined_parents.push_back(item.first);
+			refined_parent_data.push_back(&(item.second));
+			refined_children.push_back(boost::array<uint64_t, 8>());
+			refined_children_data.push_back(boost::array<UserData*, 8>());
+
+			if (!this->get_octree_children(item.first, refined_children.back())) {
+				std::cerr << __FILE__ << ":" << __LINE__
+					<< " Refined cell " << item.first
+					<< " cannot have children"
+					<< std::endl;
+				abort();
+			}
+
+			for (unsigned int i = 0; i < 8; i++) {
+				refined_children_data.back()[i] = &(this->cells.at(refined_children.back()[i]));
+			}
+		}
+
+		// parents of unrefined cells, children are in unrefined_cell_data
+		std::vector<uint64_t> unrefined_parents;
+		std::vector<UserData*> unrefined_parent_data;
+		std::vector<boost::array<uint64_t, 8> > unrefined_children;
+		std::vector<boost::array<const UserData*, 8> > unrefined_children_data;
+
+		BOOST_FOREACH(const cell_and_data_pair_t& item, this->unrefined_cell_data) {
+
+			// process each parent only once, from its first child
+			boost::array<uint64_t, 8> children;
+			if (!this->get_octree_siblings(item.first, children)
+			|| children[0] != item.first) {
+				continue;
+			}
+			const uint64_t parent = this->get_octree_parent(item.first);
+
+			unrefined_parents.push_back(parent);
+			unrefined_parent_data.push_back(&(this->cells.at(parent)));
+			unrefined_children.push_back(children);
+			unrefined_children_data.push_back(boost::array<const UserData*, 8>());
+
+			for (unsigned int i = 0; i < 8; i++) {
+				unrefined_children_data.back()[i] = &(this->unrefined_cell_data.at(children[i]));
+			}
+		}
+
+		const int number_of_refined = int(refined_parents.size());
+		#ifdef _OPENMP
+		#pragma omp parallel for
+		#endif
+		for (int i = 0; i < number_of_refined; i++) {
+			prolongation(refined_parents[i], *(refined_parent_data[i]), refined_children[i], refined_children_data[i]);
+		}
+
+		const int number_of_unrefined = int(unrefined_parents.size());
+		#ifdef _OPENMP
+		#pragma omp parallel for
+		#endif
+		for (int i = 0; i < number_of_unrefined; i++) {
+			restriction(unrefined_parents[i], *(unrefined_parent_data[i]), unrefined_children[i], unrefined_children_data[i]);
+		}
+
+		this->clear_refined_unrefined_data();
+
+		return new_cells;
+	}
+
+
 	/*!
 	Returns cells that were removed by unrefinement whose parent is on this process
 	Removed cells data is also on this process, but only until balance_load() is called
@@ -1433,16 +2150,13 @@ public:
 			return 0;
 		}
 
+		const uint64_t parent = this->get_octree_parent(cell);
+
 		// given cell cannot have a parent
-		if (this->get_refinement_level(cell) == 0) {
+		if (parent == cell) {
 			return cell;
 		}
 
-		const uint64_t parent = this->get_cell_from_indices(
-			this->get_indices(cell),
-			this->get_refinement_level(cell) - 1
-		);
-
 		if (this->cell_process.count(parent) > 0) {
 			return parent;
 		} else {
@@ -1465,96 +2179,94 @@ public:
 		std::vector<Types<3>::indices_t> return_indices;
 		return_indices.reserve(neighborhood->size());
 
-		// grid length in indices
-		const uint64_t grid_length[3] = {
-			this->get_x_length() * (uint64_t(1) << this->max_refinement_level),
-			this->get_y_length() * (uint64_t(1) << this->max_refinement_level),
-			this->get_z_length() * (uint64_t(1) << this->max_refinement_level)
+		BOOST_FOREACH(const Types<3>::neighborhood_item_t& offsets, *neighborhood) {
+			return_indices.push_back(
+				this->indices_from_neighborhood_item(indices, size_in_indices, offsets)
+			);
+		}
+
+		return return_indices;
+	}
+
+
+	/*!
+	Returns the indices at given offsets (in units of given size in indices) from given indices.
+
+	Returns error_indices if the offsets would fall outside of a non-periodic grid.
+	Wraps around periodic grids in constant time, also when the offsets span the grid several times.
+	*/
+	Types<3>::indices_t indices_from_neighborhood_item(
+		const Types<3>::indices_t& indices,
+		const uint64_t size_in_indices,
+		const Types<3>::neighborhood_item_t& offsets
+	) const
+	{
+		const Types<3>::indices_t error_indices = {{error_index, error_index, error_index}};
+		Types<3>::indices_t return_indices = indices;
+
+		// grid length in indices
+		const uint64_t grid_length[3] = {
+			this->get_x_length() << this->max_refinement_level,
+			this->get_y_length() << this->max_refinement_level,
+			this->get_z_length() << this->max_refinement_level
 		};
 
-		#ifdef DEBUG
 		for (unsigned int dimension = 0; dimension < 3; dimension++) {
+
+			if (offsets[dimension] == 0) {
+				continue;
+			}
+
+			#ifdef DEBUG
 			if (indices[dimension] >= grid_length[dimension]) {
 				std::cerr << __FILE__ << ":" << __LINE__
 					<< " Given indices outside of the grid in dimension " << dimension
 					<< std::endl;
 				abort();
 			}
-		}
-		#endif
-
-		BOOST_FOREACH(const Types<3>::neighborhood_item_t& offsets, *neighborhood) {
-
-			Types<3>::indices_t temp_indices = {{indices[0], indices[1], indices[2]}};
-
-			for (unsigned int dimension = 0; dimension < 3; dimension++) {
-				if (offsets[dimension] < 0) {
 
-					if (this->periodic[dimension]) {
+			if (indices[dimension] % size_in_indices > 0) {
+				std::cerr << __FILE__ << ":" << __LINE__
+					<< " Given indices aren't a multiple of given size in dimension " << dimension
+					<< std::endl;
+				abort();
+			}
+			#endif
 
-						// neighborhood might wrap around the grid several times
-						for (int i = 0; i > offsets[dimension]; i--) {
+			const uint64_t distance = uint64_t(abs(offsets[dimension])) * size_in_indices;
 
-							#ifdef DEBUG
-							if (temp_indices[dimension] < size_in_indices - 1
-							&& temp_indices[dimension] > 0) {
-								std::cerr << __FILE__ << ":" << __LINE__
-									<< " Cells aren't supposed to wrap around the grid."
-									<< std::endl;
-								abort();
-							}
-							#endif
+			if (this->periodic[dimension]) {
+				// neighborhood might wrap around the grid several times
+				const uint64_t wrapped_distance = distance % grid_length[dimension];
 
-							if (temp_indices[dimension] >= size_in_indices) {
-								temp_indices[dimension] -= size_in_indices;
-							} else {
-								temp_indices[dimension] = grid_length[dimension] - size_in_indices;
-							}
-						}
-					// use error_indices to signal that this neighborhood item is outside of the grid
+				if (offsets[dimension] < 0) {
+					if (return_indices[dimension] >= wrapped_distance) {
+						return_indices[dimension] -= wrapped_distance;
 					} else {
-						if (indices[dimension] < abs(offsets[dimension]) * size_in_indices) {
-							temp_indices[0] = error_index;
-							temp_indices[1] = error_index;
-							temp_indices[2] = error_index;
-							break;
-						}
-
-						temp_indices[dimension] += offsets[dimension] * size_in_indices;
+						return_indices[dimension] += grid_length[dimension] - wrapped_distance;
 					}
-
 				} else {
-
-					if (this->periodic[dimension]) {
-						for (int i = 0; i < offsets[dimension]; i++) {
-
-							#ifdef DEBUG
-							if (temp_indices[dimension] > grid_length[dimension] - size_in_indices) {
-								std::cerr << __FILE__ << ":" << __LINE__ << " Cells aren't supposed to wrap around the grid." << std::endl;
-								abort();
-							}
-							#endif
-
-							if (temp_indices[dimension] < grid_length[dimension] - size_in_indices) {
-								temp_indices[dimension] += size_in_indices;
-							} else {
-								temp_indices[dimension] = 0;
-							}
-						}
+					if (return_indices[dimension] < grid_length[dimension] - wrapped_distance) {
+						return_indices[dimension] += wrapped_distance;
 					} else {
-						if (indices[dimension] + offsets[dimension] * size_in_indices >= grid_length[dimension]) {
-							temp_indices[0] = error_index;
-							temp_indices[1] = error_index;
-							temp_indices[2] = error_index;
-							break;
-						}
+						return_indices[dimension] -= grid_length[dimension] - wrapped_distance;
+					}
+				}
 
-						temp_indices[dimension] += offsets[dimension] * size_in_indices;
+			// use error_indices to signal that this neighborhood item is outside of the grid
+			} else {
+				if (offsets[dimension] < 0) {
+					if (indices[dimension] < distance) {
+						return error_indices;
+					}
+					return_indices[dimension] -= distance;
+				} else {
+					if (indices[dimension] + distance >= grid_length[dimension]) {
+						return error_indices;
 					}
+					return_indices[dimension] += distance;
 				}
 			}
-
-			return_indices.push_back(temp_indices);
 		}
 
 		return return_indices;
@@ -1578,6 +2290,26 @@ public:
 		const bool has_children = false
 	) const {
 		std::vector<uint64_t> return_neighbors;
+		this->find_neighbors_of(cell, return_neighbors, max_diff, has_children);
+		return return_neighbors;
+	}
+
+
+	/*!
+	As find_neighbors_of(cell, max_diff, has_children) but replaces the contents of given vector with the neighbors.
+
+	Doesn't allocate memory if given vector already has enough capacity,
+	for example when updating an existing neighbor list of a cell.
+	*/
+	void find_neighbors_of(
+		const uint64_t cell,
+		std::vector<uint64_t>& return_neighbors,
+		const int max_diff = 1,
+		const bool has_children = false
+	) const {
+		return_neighbors.clear();
+		// usually enough unless neighbors are smaller than given cell
+		return_neighbors.reserve(this->neighborhood_of.size());
 
 		const int refinement_level = this->get_refinement_level(cell);
 
@@ -1604,22 +2336,20 @@ public:
 		#endif
 
 		if (this->cell_process.count(cell) == 0) {
-			return return_neighbors;
+			return;
 		}
 
 		if (!has_children && cell != this->get_child(cell)) {
-			return return_neighbors;
+			return;
 		}
 
 		const uint64_t cell_size = this->get_cell_size_in_indices(cell);
+		const Types<3>::indices_t indices = this->get_indices(cell);
 
-		const std::vector<Types<3>::indices_t> indices_of = this->indices_from_neighborhood(
-			this->get_indices(cell),
-			cell_size,
-			&(this->neighborhood_of)
-		);
+		BOOST_FOREACH(const Types<3>::neighborhood_item_t& offsets, this->neighborhood_of) {
 
-		BOOST_FOREACH(const Types<3>::indices_t& index_of, indices_of) {
+			const Types<3>::indices_t index_of
+				= this->indices_from_neighborhood_item(indices, cell_size, offsets);
 
 			if (index_of[0] == error_index) {
 				return_neighbors.push_back(0);
@@ -1636,7 +2366,6 @@ public:
 
 			#ifdef DEBUG
 			if (neighbor == 0) {
-				const Types<3>::indices_t indices = this->get_indices(cell);
 				const uint64_t smallest = this->get_existing_cell(index_of, 0, this->max_refinement_level);
 				std::cerr << __FILE__ << ":" << __LINE__
 					<< " Neighbor not found for cell " << cell
@@ -1688,14 +2417,24 @@ public:
 					index_of[2] + cell_size - 1
 				}};
 
-				const std::vector<uint64_t> current_neighbors = this->find_cells(
+				#ifdef DEBUG
+				const size_t old_size = return_neighbors.size();
+				#endif
+
+				this->find_cells(
 					index_of,
 					index_max,
 					std::max(0, refinement_level - max_diff),
-					std::min(this->max_refinement_level, refinement_level + max_diff)
+					std::min(this->max_refinement_level, refinement_level + max_diff),
+					return_neighbors
 				);
 
 				#ifdef DEBUG
+				const std::vector<uint64_t> current_neighbors(
+					return_neighbors.begin() + old_size,
+					return_neighbors.end()
+				);
+
 				if (current_neighbors.size() == 0) {
 					std::cerr << __FILE__ << ":" << __LINE__
 						<< " No neighbors for cell " << cell
@@ -1746,16 +2485,8 @@ public:
 					}
 				}
 				#endif
-
-				return_neighbors.insert(
-					return_neighbors.end(),
-					current_neighbors.begin(),
-					current_neighbors.end()
-				);
 			}
 		}
-
-		return return_neighbors;
 	}
 
 
@@ -1795,21 +2526,16 @@ public:
 		}
 		#endif
 
-		boost::unordered_set<uint64_t> unique_neighbors;
-
 		// neighbors_to larger than given cell
 		if (refinement_level > 0) {
 			const uint64_t parent = this->get_parent(cell);
 			const Types<3>::indices_t indices = this->get_indices(parent);
 			const uint64_t size_in_indices = this->get_cell_size_in_indices(parent);
 
-			std::vector<Types<3>::indices_t> search_indices = this->indices_from_neighborhood(
-				indices,
-				size_in_indices,
-				&(this->neighborhood_to)
-			);
+			BOOST_FOREACH(const Types<3>::neighborhood_item_t& offsets, this->neighborhood_to) {
 
-			BOOST_FOREACH(const Types<3>::indices_t& search_index, search_indices) {
+				const Types<3>::indices_t search_index
+					= this->indices_from_neighborhood_item(indices, size_in_indices, offsets);
 
 				if (search_index[0] == error_index) {
 					continue;
@@ -1818,7 +2544,7 @@ public:
 				const uint64_t found = this->get_cell_from_indices(search_index, refinement_level - 1);
 				// only add if found cell doesn't have children
 				if (found == this->get_child(found)) {
-					unique_neighbors.insert(found);
+					return_neighbors.push_back(found);
 				}
 			}
 		}
@@ -1826,13 +2552,11 @@ public:
 		// neighbors_to smaller than given cell
 		if (refinement_level < this->max_refinement_level) {
 
-			const std::vector<uint64_t> children = this->get_all_children(cell);
-			#ifdef DEBUG
-			if (children.size() == 0) {
+			boost::array<uint64_t, 8> children;
+			if (!this->get_octree_children(cell, children)) {
 				std::cerr << __FILE__ << ":" << __LINE__ << " Got no children for cell " << cell << std::endl;
 				abort();
 			}
-			#endif
 
 			const uint64_t size_in_indices = this->get_cell_size_in_indices(children[0]);
 
@@ -1840,13 +2564,10 @@ public:
 
 				const Types<3>::indices_t indices = this->get_indices(child);
 
-				std::vector<Types<3>::indices_t> search_indices = this->indices_from_neighborhood(
-					indices,
-					size_in_indices,
-					&(this->neighborhood_to)
-				);
+				BOOST_FOREACH(const Types<3>::neighborhood_item_t& offsets, this->neighborhood_to) {
 
-				BOOST_FOREACH(const Types<3>::indices_t& search_index, search_indices) {
+					const Types<3>::indices_t search_index
+						= this->indices_from_neighborhood_item(indices, size_in_indices, offsets);
 
 					if (search_index[0] == error_index) {
 						continue;
@@ -1855,7 +2576,7 @@ public:
 					const uint64_t found = this->get_cell_from_indices(search_index, refinement_level + 1);
 
 					if (found == this->get_child(found)) {
-						unique_neighbors.insert(found);
+						return_neighbors.push_back(found);
 					}
 				}
 			}
@@ -1865,13 +2586,10 @@ public:
 		const Types<3>::indices_t indices = this->get_indices(cell);
 		const uint64_t size_in_indices = this->get_cell_size_in_indices(cell);
 
-		std::vector<Types<3>::indices_t> search_indices = this->indices_from_neighborhood(
-			indices,
-			size_in_indices,
-			&(this->neighborhood_to)
-		);
+		BOOST_FOREACH(const Types<3>::neighborhood_item_t& offsets, this->neighborhood_to) {
 
-		BOOST_FOREACH(const Types<3>::indices_t& search_index, search_indices) {
+			const Types<3>::indices_t search_index
+				= this->indices_from_neighborhood_item(indices, size_in_indices, offsets);
 
 			if (search_index[0] == error_index) {
 				continue;
@@ -1879,15 +2597,15 @@ public:
 
 			const uint64_t found = this->get_cell_from_indices(search_index, refinement_level);
 			if (found == this->get_child(found)) {
-				unique_neighbors.insert(found);
+				return_neighbors.push_back(found);
 			}
 		}
 
-		return_neighbors.reserve(unique_neighbors.size());
-
-		BOOST_FOREACH(const uint64_t& neighbor, unique_neighbors) {
-			return_neighbors.push_back(neighbor);
-		}
+		std::sort(return_neighbors.begin(), return_neighbors.end());
+		return_neighbors.erase(
+			std::unique(return_neighbors.begin(), return_neighbors.end()),
+			return_neighbors.end()
+		);
 
 		return return_neighbors;
 	}
@@ -1912,8 +2630,6 @@ public:
 		}
 
 		// get neighbors_to of given cell, first from its neighbors_of
-		boost::unordered_set<uint64_t> unique_neighbors_to;
-
 		BOOST_FOREACH(const uint64_t& neighbor_of, found_neighbors_of) {
 			// neighbors_to doesn't store cells that would be outside of the grid
 			if (neighbor_of == 0) {
@@ -1921,7 +2637,7 @@ public:
 			}
 
 			if (this->is_neighbor(neighbor_of, cell)) {
-				unique_neighbors_to.insert(neighbor_of);
+				return_neighbors.push_back(neighbor_of);
 			}
 		}
 
@@ -1958,13 +2674,11 @@ public:
 
 			const Types<3>::indices_t indices = this->get_indices(parent);
 			const uint64_t size_in_indices = this->get_cell_size_in_indices(parent);
-			const std::vector<Types<3>::indices_t> search_indices = this->indices_from_neighborhood(
-				indices,
-				size_in_indices,
-				&(this->neighborhood_to)
-			);
 
-			BOOST_FOREACH(const Types<3>::indices_t& search_index, search_indices) {
+			BOOST_FOREACH(const Types<3>::neighborhood_item_t& offsets, this->neighborhood_to) {
+
+				const Types<3>::indices_t search_index
+					= this->indices_from_neighborhood_item(indices, size_in_indices, offsets);
 
 				if (search_index[0] == error_index) {
 					continue;
@@ -1973,16 +2687,15 @@ public:
 				const uint64_t found = this->get_cell_from_indices(search_index, refinement_level - 1);
 				// only add if found cell doesn't have children
 				if (found == this->get_child(found)) {
-					unique_neighbors_to.insert(found);
+					return_neighbors.push_back(found);
 				}
 			}
 		}
 
-		return_neighbors.reserve(unique_neighbors_to.size());
-		return_neighbors.insert(
-			return_neighbors.begin(),
-			unique_neighbors_to.begin(),
-			unique_neighbors_to.end()
+		std::sort(return_neighbors.begin(), return_neighbors.end());
+		return_neighbors.erase(
+			std::unique(return_neighbors.begin(), return_neighbors.end()),
+			return_neighbors.end()
 		);
 
 		return return_neighbors;
@@ -2003,6 +2716,30 @@ public:
 		const Types<3>::indices_t indices_max,
 		const int minimum_refinement_level,
 		const int maximum_refinement_level
+	) const {
+		std::vector<uint64_t> result;
+		this->find_cells(
+			indices_min,
+			indices_max,
+			minimum_refinement_level,
+			maximum_refinement_level,
+			result
+		);
+		return result;
+	}
+
+
+	/*!
+	As find_cells(indices_min, indices_max, minimum_refinement_level, maximum_refinement_level)
+	but appends the cells to given vector.
+	*/
+	void find_cells
+	(
+		const Types<3>::indices_t& indices_min,
+		const Types<3>::indices_t& indices_max,
+		const int minimum_refinement_level,
+		const int maximum_refinement_level,
+		std::vector<uint64_t>& result
 	) const {
 		// size of cells in indices of given maximum_refinement_level
 		const uint64_t index_increase = uint64_t(1) << (this->max_refinement_level - maximum_refinement_level);
@@ -2035,9 +2772,6 @@ public:
 		}
 		#endif
 
-		std::vector<uint64_t> result;
-		boost::unordered_set<uint64_t> uniques;
-
 		Types<3>::indices_t indices = {{0, 0, 0}};
 		for (indices[2] = indices_min[2]; indices[2] <= indices_max[2]; indices[2] += index_increase)
 		for (indices[1] = indices_min[1]; indices[1] <= indices_max[1]; indices[1] += index_increase)
@@ -2085,14 +2819,29 @@ public:
 				continue;
 			}
 
-			// don't add the same cell twice
-			if (uniques.count(cell) == 0) {
-				uniques.insert(cell);
-				result.push_back(cell);
+			/*
+			Don't add the same cell twice, a cell spanning several search
+			indices is added only at the first of them in every dimension
+			*/
+			if (this->get_refinement_level(cell) < maximum_refinement_level) {
+				const Types<3>::indices_t cell_indices = this->get_indices(cell);
+
+				bool first = true;
+				for (unsigned int dimension = 0; dimension < 3; dimension++) {
+					if (indices[dimension] != indices_min[dimension]
+					&& indices[dimension] - cell_indices[dimension] >= index_increase) {
+						first = false;
+						break;
+					}
+				}
+
+				if (!first) {
+					continue;
+				}
 			}
-		}
 
-		return result;
+			result.push_back(cell);
+		}
 	}
 
 
@@ -2141,6 +2890,7 @@ public:
 		}
 
 		this->processes_per_part.push_back(processes);
+		this->level_parts.push_back(-1);
 
 		// create default partitioning options for the level
 		boost::unordered_map<std::string, std::string> default_load_balance_options;
@@ -2164,10 +2914,129 @@ public:
 		}
 
 		this->processes_per_part.erase(this->processes_per_part.begin() + hierarchial_partitioning_level);
+		this->level_parts.erase(this->level_parts.begin() + hierarchial_partitioning_level);
 		this->partitioning_options.erase(this->partitioning_options.begin() + hierarchial_partitioning_level);
 	}
 
 
+	/*!
+	Returns the number of levels for hierarchial partitioning.
+	*/
+	int get_number_of_partitioning_levels(void) const
+	{
+		return int(this->processes_per_part.size());
+	}
+
+
+	/*!
+	Replaces all hierarchial partitioning levels with levels derived from the hardware topology.
+
+	Processes that share memory are found with MPI_Comm_split_type(MPI_COMM_TYPE_SHARED) with MPI-3
+	and by processor name otherwise. Processes of a node are grouped by the processor socket
+	they are pinned to given by /sys on Linux, unless that isn't known for every process of
+	the node. Levels are added for:
+		-nodes if there are more than one, with LB_METHOD = GRAPH and GRAPH_PACKAGE = PHG
+		-sockets of a node if any node has more than one, with LB_METHOD = RCB
+		-processes of a socket, with LB_METHOD = RCB
+	Options of levels can be changed with add_partitioning_option().
+	Load balancing method given to initialize() must be HIER.
+	Must be called simultaneously on all processes.
+	*/
+	void add_topology_partitioning_levels(void)
+	{
+		this->processes_per_part.clear();
+		this->level_parts.clear();
+		this->partitioning_options.clear();
+
+		// processes in the same node have the same leader
+		std::vector<int> leaders;
+		all_gather(this->comm, this->get_node_leader(), leaders);
+
+		std::vector<int> sockets;
+		all_gather(this->comm, this->get_socket_id(), sockets);
+
+		// processes of a node are grouped by socket only if all of them know theirs
+		boost::unordered_set<int> nodes_with_unknown_sockets;
+		for (int process = 0; process < this->comm.size(); process++) {
+			if (sockets[process] < 0) {
+				nodes_with_unknown_sockets.insert(leaders[process]);
+			}
+		}
+		for (int process = 0; process < this->comm.size(); process++) {
+			if (nodes_with_unknown_sockets.count(leaders[process]) > 0) {
+				sockets[process] = -1;
+			}
+		}
+
+		const int
+			rank = this->comm.rank(),
+			leader = leaders[rank];
+
+		std::vector<int> sorted_leaders(leaders);
+		std::sort(sorted_leaders.begin(), sorted_leaders.end());
+		sorted_leaders.erase(std::unique(sorted_leaders.begin(), sorted_leaders.end()), sorted_leaders.end());
+
+		const int node_part = int(
+			std::lower_bound(sorted_leaders.begin(), sorted_leaders.end(), leader) - sorted_leaders.begin()
+		);
+
+		// part of this process in its node and socket in rank order
+		std::vector<int> node_sockets;
+		int socket_part = -1, process_part = 0;
+		unsigned int max_processes_per_node = 0, max_sockets_per_node = 0, max_processes_per_socket = 0;
+
+		boost::unordered_map<int, unsigned int> processes_per_node;
+		boost::unordered_map<int, boost::unordered_map<int, unsigned int> > processes_per_socket;
+
+		for (int process = 0; process < this->comm.size(); process++) {
+			processes_per_node[leaders[process]]++;
+			const unsigned int socket_processes = ++processes_per_socket[leaders[process]][sockets[process]];
+
+			max_processes_per_node = std::max(max_processes_per_node, processes_per_node.at(leaders[process]));
+			max_processes_per_socket = std::max(max_processes_per_socket, socket_processes);
+			max_sockets_per_node = std::max(
+				max_sockets_per_node,
+				(unsigned int) processes_per_socket.at(leaders[process]).size()
+			);
+
+			if (leaders[process] != leader) {
+				continue;
+			}
+
+			if (std::find(node_sockets.begin(), node_sockets.end(), sockets[process]) == node_sockets.end()) {
+				node_sockets.push_back(sockets[process]);
+			}
+
+			if (process == rank) {
+				socket_part = int(node_sockets.size()) - 1;
+				process_part = int(socket_processes) - 1;
+			}
+		}
+
+		if (sorted_leaders.size() > 1) {
+			this->processes_per_part.push_back(max_processes_per_node);
+			this->level_parts.push_back(node_part);
+			this->partitioning_options.push_back(boost::unordered_map<std::string, std::string>());
+			this->partitioning_options.back()["LB_METHOD"] = "GRAPH";
+			this->partitioning_options.back()["GRAPH_PACKAGE"] = "PHG";
+		}
+
+		if (max_sockets_per_node > 1) {
+			this->processes_per_part.push_back(max_processes_per_socket);
+			this->level_parts.push_back(socket_part);
+			this->partitioning_options.push_back(boost::unordered_map<std::string, std::string>());
+			this->partitioning_options.back()["LB_METHOD"] = "RCB";
+		}
+
+		if (max_processes_per_socket > 1 || this->processes_per_part.size() == 0) {
+			this->processes_per_part.push_back(1);
+			this->level_parts.push_back(process_part);
+			this->partitioning_options.push_back(boost::unordered_map<std::string, std::string>());
+			this->partitioning_options.back()["LB_METHOD"] = "RCB";
+		}
+	}
+
+
 	/*!
 	Adds (or overwrites) the given option and its value for hierarchial partitioning of given level.
 
@@ -2251,8 +3120,8 @@ public:
 			return value;
 		}
 
-		if (this->partitioning_options.count(name) > 0) {
-			value = this->partitioning_options.at(name);
+		if (this->partitioning_options.at(hierarchial_partitioning_level).count(name) > 0) {
+			value = this->partitioning_options.at(hierarchial_partitioning_level).at(name);
 		}
 
 		return value;
@@ -2402,11 +3271,7 @@ public:
 	These lists record which cells' user data this process will send during neighbor data updates.
 	The key is the target process.
 	*/
-	#ifdef DCCRG_SEND_SINGLE_CELLS
-	const boost::unordered_map<int, std::vector<std::pair<uint64_t, int> > >*
-	#else
 	const boost::unordered_map<int, std::vector<uint64_t> >*
-	#endif
 	get_send_lists(void)
 	{
 		return &(this->cells_to_send);
@@ -2418,11 +3283,7 @@ public:
 	These lists record which cells' user data this process will receive during neighbor data updates.
 	The key is the source process.
 	*/
-	#ifdef DCCRG_SEND_SINGLE_CELLS
-	const boost::unordered_map<int, std::vector<std::pair<uint64_t, int> > >*
-	#else
 	const boost::unordered_map<int, std::vector<uint64_t> >*
-	#endif
 	get_receive_lists(void)
 	{
 		return &(this->cells_to_receive);
@@ -2430,99 +3291,567 @@ public:
 
 
 	/*!
-	Returns a pointer to the set of local cells which have at least one neighbor
-	on another process.
+	Returns the send lists of this process with the message tag of each cell.
+
+	Tags are those that SINGLE_CELL_TRANSFER uses so users can also send the data
+	themselves. When the cells sent to a process are coalesced several cells have
+	the same tag and their data is sent in one message in the listed order, see
+	set_single_cell_transfer_limits().
 	*/
-	const boost::unordered_set<uint64_t>* get_cells_with_remote_neighbors(void) const
+	boost::unordered_map<int, std::vector<std::pair<uint64_t, int> > > get_tagged_send_lists(void)
 	{
-		return &(this->cells_with_remote_neighbors);
+		return this->get_tagged_lists(this->cells_to_send);
 	}
 
 	/*!
-	Returns a vector of local cells which have at least one neighbor on another process.
+	Returns the receive lists of this process with the message tag of each cell.
+
+	See get_tagged_send_lists().
 	*/
-	std::vector<uint64_t> get_list_of_cells_with_remote_neighbors(void) const
+	boost::unordered_map<int, std::vector<std::pair<uint64_t, int> > > get_tagged_receive_lists(void)
 	{
-		std::vector<uint64_t> result(
-			this->cells_with_remote_neighbors.begin(),
-			this->cells_with_remote_neighbors.end()
-		);
-		return result;
+		return this->get_tagged_lists(this->cells_to_receive);
 	}
 
+
 	/*!
-	Returns a pointer to the set of remote cells which have at least one local neighbor.
+	Sets when SINGLE_CELL_TRANSFER coalesces cells into larger messages.
+
+	If more than max_messages cells would be sent from one process to another, the cells
+	are sent max_cells_per_message at a time instead, or more if the tags of messages
+	would otherwise exceed MPI_TAG_UB.
+	Must be called simultaneously on all processes with the same values.
 	*/
-	const boost::unordered_set<uint64_t>* get_remote_cells_with_local_neighbors(void) const
+	void set_single_cell_transfer_limits(const uint64_t max_messages, const uint64_t max_cells_per_message)
 	{
-		return &(this->remote_cells_with_local_neighbors);
+		if (max_messages == 0 || max_cells_per_message == 0) {
+			std::cerr << __FILE__ << ":" << __LINE__
+				<< " Limits of single cell transfers must be > 0"
+				<< std::endl;
+			abort();
+		}
+
+		this->max_single_cell_messages = max_messages;
+		this->cells_per_coalesced_message = max_cells_per_message;
 	}
 
+
 	/*!
-	Returns a vector of remote cells which have at least one local neighbor.
+	Sets approximately how many bytes of user data a process sends or receives at a time when cells are moved between processes.
+
+	If cells would transfer more data than this, they are moved in rounds and the data of cells
+	sent during a round is freed at the end of the round. Neighbor lists of cells received
+	during a round are created while the next round's data is transferred.
+	The size of cell data is given by UserData::size() with DCCRG_CELL_DATA_SIZE_FROM_USER, the size of
+	UserData::mpi_datatype() with DCCRG_USER_MPI_DATA_TYPE and sizeof(UserData) otherwise.
+	0 moves all cells at once (the default).
+	Must be called simultaneously on all processes with the same value.
 	*/
-	std::vector<uint64_t> get_list_of_remote_cells_with_local_neighbors(void) const
+	void set_migration_buffer_size(const uint64_t bytes)
 	{
-		std::vector<uint64_t> result(
-			this->remote_cells_with_local_neighbors.begin(),
-			this->remote_cells_with_local_neighbors.end()
-		);
-		return result;
+		this->migration_buffer_size = bytes;
 	}
 
-
 	/*!
-	Sets the weight of given local existing cell without children.
+	Returns the value given to set_migration_buffer_size().
+	*/
+	uint64_t get_migration_buffer_size(void) const
+	{
+		return this->migration_buffer_size;
+	}
 
-	Does nothing if above conditions are not met.
-	Cell weights are given to Zoltan when balancing the load.
-	Unset cell weights are assumed to be 1.
 
-	User set cell weights are removed when balance_load is called.
-	Children of refined cells inherit their parent's weight.
-	Parents of unrefined cells do not inherit the moved cells' weights.
+	/*!
+	Starts or stops collecting statistics of this process, see get_statistics().
+
+	Statistics aren't collected by default, in which case timing phases costs one branch.
+	Collected phases, which can be nested, are:
+	neighbor_lists, remote_neighbor_info, send_receive_lists, partition (including Zoltan),
+	migration (moving cells between processes), induce_refines, override_unrefines,
+	execute_refines, neighbor_update_start, neighbor_update_wait_receives,
+	neighbor_update_wait_sends and user_data_wait (time blocked waiting for user data to arrive,
+	one call per transfer).
+	Messages and bytes of user data are counted for every process this one exchanges cells with.
+	Can be called on processes independently.
 	*/
-	void set_cell_weight(const uint64_t cell, const double weight)
+	void set_statistics_collection(const bool collect)
 	{
-		if (this->cell_process.count(cell) == 0) {
-			return;
-		}
-
-		if (this->cell_process.at(cell) != this->comm.rank()) {
-			return;
-		}
+		this->collect_statistics = collect;
+	}
 
-		if (cell != this->get_child(cell)) {
-			return;
-		}
+	/*!
+	Returns the statistics collected on this process since the last call to clear_statistics().
+	*/
+	const Statistics& get_statistics(void) const
+	{
+		return this->statistics;
+	}
 
-		this->cell_weights[cell] = weight;
+	/*!
+	Removes statistics collected so far on this process.
+	*/
+	void clear_statistics(void)
+	{
+		this->statistics.clear();
 	}
 
 	/*!
-	Returns the weight of given local existing cell without children.
+	Writes statistics of this process into file named given prefix, _, rank of this process and .csv or .json.
 
-	Returns a quiet nan if above conditions are not met.
-	Unset cell weights are assumed to be 1.
+	Writes JSON if json is true and CSV otherwise, see Statistics::write_csv().
+	Returns false if the file couldn't be written.
 	*/
-	double get_cell_weight(const uint64_t cell) const
+	bool write_statistics(const std::string& prefix, const bool json = false) const
 	{
-		if (this->cell_process.count(cell) == 0) {
-			return std::numeric_limits<double>::quiet_NaN();
-		}
-
-		if (this->cell_process.at(cell) != this->comm.rank()) {
-			return std::numeric_limits<double>::quiet_NaN();
-		}
+		std::ostringstream file_name;
+		file_name << prefix << "_" << this->comm.rank() << (json ? ".json" : ".csv");
 
-		if (cell != this->get_child(cell)) {
-			return std::numeric_limits<double>::quiet_NaN();
+		std::ofstream outfile(file_name.str().c_str());
+		if (!outfile.is_open()) {
+			std::cerr << "Couldn't open file " << file_name.str() << std::endl;
+			return false;
 		}
 
-		if (this->cell_weights.count(cell) == 0) {
-			return 1;
+		if (json) {
+			this->statistics.write_json(outfile, this->comm.rank());
 		} else {
-			return this->cell_weights.at(cell);
+			this->statistics.write_csv(outfile, this->comm.rank());
+		}
+
+		return outfile.good();
+	}
+
+
+	/*!
+	Starts recording user data transfers of this process into file named given prefix, _, rank of this process and .trace.
+
+	Every neighbor data update, round of moving cells between processes and transfer of
+	unrefined cells' data is appended to the file as one Trace_Record which contains the
+	processes this one exchanged data with, the number of messages and bytes exchanged,
+	when the transfer started and completed and how long this process waited for it.
+	Replaces a trace already being recorded. Returns false if the file couldn't be opened.
+	Can be called on processes independently, traces can be replayed with tests/trace/replay.cpp.
+	*/
+	bool start_tracing(const std::string& prefix)
+	{
+		this->stop_tracing();
+
+		std::ostringstream file_name;
+		file_name << prefix << "_" << this->comm.rank() << ".trace";
+
+		this->trace_file = new std::ofstream(file_name.str().c_str(), std::ios::binary);
+		if (!this->trace_file->is_open()
+		|| !write_trace_header(*(this->trace_file), this->comm.rank(), this->comm.size())) {
+			std::cerr << "Couldn't open file " << file_name.str() << std::endl;
+			this->stop_tracing();
+			return false;
+		}
+
+		this->trace_start_time = MPI_Wtime();
+		return true;
+	}
+
+	/*!
+	Stops recording user data transfers and closes the trace file, see start_tracing().
+	*/
+	void stop_tracing(void)
+	{
+		if (this->trace_file != NULL) {
+			delete this->trace_file;
+			this->trace_file = NULL;
+		}
+	}
+
+
+	/*!
+	Returns the quality of the current partitioning of the grid between processes.
+
+	Weights of cells are the ones given to set_cell_weight() or 1.
+	After cells have been moved between processes the weights they had
+	before the move are used until cells are refined or weights are set again.
+	Bytes of user data are counted as in set_migration_buffer_size().
+	Must be called simultaneously on all processes.
+	*/
+	Partition_Quality get_partition_quality(void)
+	{
+		Partition_Quality quality;
+
+		double local_weight = 0;
+		uint64_t local_edge_cut = 0;
+		if (this->migrated_weight >= 0) {
+			local_weight = this->migrated_weight;
+		} else {
+			BOOST_FOREACH(const cell_and_data_pair_t& item, this->cells) {
+				const boost::unordered_map<uint64_t, double>::const_iterator weight = this->cell_weights.find(item.first);
+				local_weight += (weight != this->cell_weights.end()) ? weight->second : 1;
+			}
+		}
+
+		BOOST_FOREACH(const uint64_t& cell, this->cells_with_remote_neighbors) {
+			BOOST_FOREACH(const uint64_t& neighbor, this->neighbors.at(cell)) {
+				if (neighbor != error_cell && this->cell_process.at(neighbor) != this->comm.rank()) {
+					local_edge_cut++;
+				}
+			}
+		}
+
+		// peers of this process
+		boost::unordered_set<int> peers;
+		uint64_t local_ghost_cells = 0, local_update_bytes = 0;
+		for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			receiver = this->cells_to_send.begin();
+			receiver != this->cells_to_send.end();
+			receiver++
+		) {
+			if (receiver->second.size() == 0) {
+				continue;
+			}
+			peers.insert(receiver->first);
+			BOOST_FOREACH(const uint64_t& cell, receiver->second) {
+				local_update_bytes += this->get_cell_data_bytes(cell);
+			}
+		}
+		for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			sender = this->cells_to_receive.begin();
+			sender != this->cells_to_receive.end();
+			sender++
+		) {
+			if (sender->second.size() == 0) {
+				continue;
+			}
+			peers.insert(sender->first);
+			local_ghost_cells += sender->second.size();
+		}
+
+		const uint64_t local_cells = this->cells.size();
+		const int local_peers = int(peers.size());
+
+		quality.total_weight = all_reduce(this->comm, local_weight, std::plus<double>());
+		quality.max_weight = all_reduce(this->comm, local_weight, boost::mpi::maximum<double>());
+		if (quality.total_weight > 0) {
+			quality.imbalance = quality.max_weight * this->comm.size() / quality.total_weight;
+		}
+
+		quality.total_cells = all_reduce(this->comm, local_cells, std::plus<uint64_t>());
+		quality.max_cells = all_reduce(this->comm, local_cells, boost::mpi::maximum<uint64_t>());
+
+		quality.min_peers = all_reduce(this->comm, local_peers, boost::mpi::minimum<int>());
+		quality.max_peers = all_reduce(this->comm, local_peers, boost::mpi::maximum<int>());
+		quality.average_peers = double(all_reduce(this->comm, local_peers, std::plus<int>())) / this->comm.size();
+
+		quality.total_ghost_cells = all_reduce(this->comm, local_ghost_cells, std::plus<uint64_t>());
+		quality.max_ghost_cells = all_reduce(this->comm, local_ghost_cells, boost::mpi::maximum<uint64_t>());
+
+		quality.total_update_bytes = all_reduce(this->comm, local_update_bytes, std::plus<uint64_t>());
+		quality.max_update_bytes = all_reduce(this->comm, local_update_bytes, boost::mpi::maximum<uint64_t>());
+
+		quality.edge_cut = all_reduce(this->comm, local_edge_cut, std::plus<uint64_t>());
+
+		const uint64_t boundary_cells = all_reduce(
+			this->comm,
+			uint64_t(this->cells_with_remote_neighbors.size()),
+			std::plus<uint64_t>()
+		);
+		if (quality.total_cells > 0) {
+			quality.boundary_fraction = double(boundary_cells) / quality.total_cells;
+		}
+
+		quality.migrated_cells = all_reduce(this->comm, this->migrated_cells, std::plus<uint64_t>());
+		quality.migrated_bytes = all_reduce(this->comm, this->migrated_bytes, std::plus<uint64_t>());
+
+		return quality;
+	}
+
+
+	/*!
+	Load balances the grid if that is estimated to pay off and returns true if it did.
+
+	step_time is the time this process spent in its latest step, e.g. solving its cells.
+	Step times are averaged over steps since the previous load balancing. Perfect
+	balance would save the difference between the slowest process' and the average
+	step time on every step of the horizon, see set_rebalancing_horizon(). This is
+	compared to the estimated time of load balancing: the time of the previous
+	partitioning plus the bytes of user data that the slowest process would have
+	to move times the time per byte of the previous migration. Until load has been
+	balanced by this function the estimate given to set_rebalancing_cost_estimate() is used.
+	Load is balanced if the savings exceed the cost times set_rebalancing_threshold()
+	and at least set_rebalancing_min_steps() steps have been averaged.
+	If no process has user-given cell weights the cells of each process are weighted
+	by the process' average step time divided by the number of its cells.
+	Every decision is written into the stream given to set_rebalancing_log().
+	Must be called simultaneously on all processes.
+	*/
+	bool balance_load_if_worthwhile(const double step_time)
+	{
+		this->rebalancing_steps++;
+		this->rebalancing_total_steps++;
+		this->rebalancing_step_time += step_time;
+
+		const double local_step_time = this->rebalancing_step_time / this->rebalancing_steps;
+
+		Rebalancing_Decision decision;
+		decision.step = this->rebalancing_total_steps;
+		decision.max_step_time = all_reduce(this->comm, local_step_time, boost::mpi::maximum<double>());
+		decision.average_step_time
+			= all_reduce(this->comm, local_step_time, std::plus<double>()) / this->comm.size();
+		decision.projected_savings
+			= this->rebalancing_horizon * (decision.max_step_time - decision.average_step_time);
+
+		// overloaded processes have to move the excess fraction of their cells
+		uint64_t local_bytes = 0;
+		if (local_step_time > decision.average_step_time) {
+			BOOST_FOREACH(const cell_and_data_pair_t& item, this->cells) {
+				local_bytes += this->get_cell_data_bytes(item.first);
+			}
+			local_bytes = uint64_t(
+				local_bytes * (local_step_time - decision.average_step_time) / local_step_time
+			);
+		}
+		const uint64_t max_bytes = all_reduce(this->comm, local_bytes, boost::mpi::maximum<uint64_t>());
+
+		decision.estimated_cost
+			= this->rebalancing_partition_time
+			+ max_bytes * this->rebalancing_seconds_per_byte;
+		decision.rebalanced
+			= this->rebalancing_steps >= this->rebalancing_min_steps
+			&& decision.projected_savings > 0
+			&& decision.projected_savings > this->rebalancing_threshold * decision.estimated_cost;
+
+		if (decision.rebalanced) {
+			if (all_reduce(this->comm, uint64_t(this->cell_weights.size()), std::plus<uint64_t>()) == 0
+			&& this->cells.size() > 0) {
+				const double weight = local_step_time / this->cells.size();
+				BOOST_FOREACH(const cell_and_data_pair_t& item, this->cells) {
+					this->cell_weights[item.first] = weight;
+				}
+			}
+
+			const double start_time = MPI_Wtime();
+			this->make_new_partition(true);
+			const double partition_end_time = MPI_Wtime();
+			this->move_cells();
+			this->added_cells.clear();
+			this->removed_cells.clear();
+			const double end_time = MPI_Wtime();
+
+			this->rebalancing_partition_time = all_reduce(
+				this->comm,
+				partition_end_time - start_time,
+				boost::mpi::maximum<double>()
+			);
+			const double migration_time = all_reduce(
+				this->comm,
+				end_time - partition_end_time,
+				boost::mpi::maximum<double>()
+			);
+			const uint64_t migrated_bytes = all_reduce(
+				this->comm,
+				this->migrated_bytes,
+				boost::mpi::maximum<uint64_t>()
+			);
+			if (migrated_bytes > 0) {
+				this->rebalancing_seconds_per_byte = migration_time / migrated_bytes;
+			}
+			decision.cost = all_reduce(this->comm, end_time - start_time, boost::mpi::maximum<double>());
+
+			this->rebalancing_steps = 0;
+			this->rebalancing_step_time = 0;
+		}
+
+		if (this->rebalancing_log != NULL) {
+			decision.write_csv(*(this->rebalancing_log));
+		}
+
+		this->last_rebalancing_decision = decision;
+		return decision.rebalanced;
+	}
+
+	/*!
+	Sets the number of steps over which balance_load_if_worthwhile() projects the savings of load balancing.
+
+	Must be called simultaneously on all processes with the same value.
+	*/
+	void set_rebalancing_horizon(const uint64_t steps)
+	{
+		this->rebalancing_horizon = steps;
+	}
+
+	/*!
+	Returns the value given to set_rebalancing_horizon(), 100 by default.
+	*/
+	uint64_t get_rebalancing_horizon(void) const
+	{
+		return this->rebalancing_horizon;
+	}
+
+	/*!
+	Sets the number of steps since the previous load balancing by balance_load_if_worthwhile()
+	before it can balance load again, so that one noisy step time doesn't trigger it.
+
+	Must be called simultaneously on all processes with the same value.
+	*/
+	void set_rebalancing_min_steps(const uint64_t steps)
+	{
+		this->rebalancing_min_steps = steps;
+	}
+
+	/*!
+	Returns the value given to set_rebalancing_min_steps(), 3 by default.
+	*/
+	uint64_t get_rebalancing_min_steps(void) const
+	{
+		return this->rebalancing_min_steps;
+	}
+
+	/*!
+	Sets how many times larger than the estimated cost projected savings must be, see balance_load_if_worthwhile().
+
+	Must be called simultaneously on all processes with the same value.
+	*/
+	void set_rebalancing_threshold(const double threshold)
+	{
+		this->rebalancing_threshold = threshold;
+	}
+
+	/*!
+	Returns the value given to set_rebalancing_threshold(), 1 by default.
+	*/
+	double get_rebalancing_threshold(void) const
+	{
+		return this->rebalancing_threshold;
+	}
+
+	/*!
+	Sets the estimated time of partitioning and of moving one byte of user data used by balance_load_if_worthwhile().
+
+	Defaults are 0 seconds and 1e-9 seconds per byte. The estimates are
+	replaced by measured ones every time balance_load_if_worthwhile() balances load.
+	Must be called simultaneously on all processes with the same values.
+	*/
+	void set_rebalancing_cost_estimate(const double partition_time, const double seconds_per_byte)
+	{
+		this->rebalancing_partition_time = partition_time;
+		this->rebalancing_seconds_per_byte = seconds_per_byte;
+	}
+
+	/*!
+	Writes decisions made by balance_load_if_worthwhile() into given stream in CSV format.
+
+	The header line is written immediately, NULL stops writing decisions.
+	Decisions are the same on all processes so usually one process writes them.
+	*/
+	void set_rebalancing_log(std::ostream* log)
+	{
+		this->rebalancing_log = log;
+		if (this->rebalancing_log != NULL) {
+			Rebalancing_Decision::write_csv_header(*(this->rebalancing_log));
+		}
+	}
+
+	/*!
+	Returns the latest decision made by balance_load_if_worthwhile().
+	*/
+	const Rebalancing_Decision& get_last_rebalancing_decision(void) const
+	{
+		return this->last_rebalancing_decision;
+	}
+
+
+	/*!
+	Returns a pointer to the set of local cells which have at least one neighbor
+	on another process.
+	*/
+	const boost::unordered_set<uint64_t>* get_cells_with_remote_neighbors(void) const
+	{
+		return &(this->cells_with_remote_neighbors);
+	}
+
+	/*!
+	Returns a vector of local cells which have at least one neighbor on another process.
+	*/
+	std::vector<uint64_t> get_list_of_cells_with_remote_neighbors(void) const
+	{
+		std::vector<uint64_t> result(
+			this->cells_with_remote_neighbors.begin(),
+			this->cells_with_remote_neighbors.end()
+		);
+		return result;
+	}
+
+	/*!
+	Returns a pointer to the set of remote cells which have at least one local neighbor.
+	*/
+	const boost::unordered_set<uint64_t>* get_remote_cells_with_local_neighbors(void) const
+	{
+		return &(this->remote_cells_with_local_neighbors);
+	}
+
+	/*!
+	Returns a vector of remote cells which have at least one local neighbor.
+	*/
+	std::vector<uint64_t> get_list_of_remote_cells_with_local_neighbors(void) const
+	{
+		std::vector<uint64_t> result(
+			this->remote_cells_with_local_neighbors.begin(),
+			this->remote_cells_with_local_neighbors.end()
+		);
+		return result;
+	}
+
+
+	/*!
+	Sets the weight of given local existing cell without children.
+
+	Does nothing if above conditions are not met.
+	Cell weights are given to Zoltan when balancing the load.
+	Unset cell weights are assumed to be 1.
+
+	User set cell weights are removed when balance_load is called.
+	Children of refined cells inherit their parent's weight.
+	Parents of unrefined cells do not inherit the moved cells' weights.
+	*/
+	void set_cell_weight(const uint64_t cell, const double weight)
+	{
+		if (this->cell_process.count(cell) == 0) {
+			return;
+		}
+
+		if (this->cell_process.at(cell) != this->comm.rank()) {
+			return;
+		}
+
+		if (cell != this->get_child(cell)) {
+			return;
+		}
+
+		this->cell_weights[cell] = weight;
+		this->migrated_weight = -1;
+	}
+
+	/*!
+	Returns the weight of given local existing cell without children.
+
+	Returns a quiet nan if above conditions are not met.
+	Unset cell weights are assumed to be 1.
+	*/
+	double get_cell_weight(const uint64_t cell) const
+	{
+		if (this->cell_process.count(cell) == 0) {
+			return std::numeric_limits<double>::quiet_NaN();
+		}
+
+		if (this->cell_process.at(cell) != this->comm.rank()) {
+			return std::numeric_limits<double>::quiet_NaN();
+		}
+
+		if (cell != this->get_child(cell)) {
+			return std::numeric_limits<double>::quiet_NaN();
+		}
+
+		if (this->cell_weights.count(cell) == 0) {
+			return 1;
+		} else {
+			return this->cell_weights.at(cell);
 		}
 	}
 
@@ -2594,7 +3923,12 @@ public:
 			return siblings;
 		}
 
-		return this->get_all_children(this->get_parent(cell));
+		boost::array<uint64_t, 8> all_siblings;
+		if (this->get_octree_siblings(cell, all_siblings)) {
+			siblings.assign(all_siblings.begin(), all_siblings.end());
+		}
+
+		return siblings;
 	}
 
 
@@ -2617,29 +3951,9 @@ public:
 		}
 
 		// given cell cannot have children
-		int refinement_level = this->get_refinement_level(cell);
-		if (refinement_level >= this->max_refinement_level) {
-			return children;
-		}
-
-		children.reserve(8);
-
-		Types<3>::indices_t indices = this->get_indices(cell);
-
-		// get indices of next refinement level within this cell
-		refinement_level++;
-		const uint64_t index_offset = (uint64_t(1) << (this->max_refinement_level - refinement_level));
-		for (uint64_t z_index_offset = 0; z_index_offset < 2 * index_offset; z_index_offset += index_offset)
-		for (uint64_t y_index_offset = 0; y_index_offset < 2 * index_offset; y_index_offset += index_offset)
-		for (uint64_t x_index_offset = 0; x_index_offset < 2 * index_offset; x_index_offset += index_offset) {
-			children.push_back(
-				this->get_cell_from_indices(
-					indices[0] + x_index_offset,
-					indices[1] + y_index_offset,
-					indices[2] + z_index_offset,
-					refinement_level
-				)
-			);
+		boost::array<uint64_t, 8> all_children;
+		if (this->get_octree_children(cell, all_children)) {
+			children.assign(all_children.begin(), all_children.end());
 		}
 
 		return children;
@@ -2668,12 +3982,35 @@ private:
 	// cells and their data on this process
 	boost::unordered_map<uint64_t, UserData> cells;
 
-	// cell on this process and its neighbors
-	boost::unordered_map<uint64_t, std::vector<uint64_t> > neighbors;
+	// cells without children on this process and in the whole grid, sorted
+	std::vector<uint64_t> local_cells, all_cells;
+
+	// local cells without and with neighbors on other processes, sorted
+	std::vector<uint64_t> inner_cells, outer_cells;
+
+	// incremented every time above lists are updated
+	uint64_t cell_lists_version;
 
 	/*
-	Offsets of cells that are considered as neighbors of a cell and
-	offsets of cells that consider a cell as a neighbor
+	Local cells and their data in the order of inner_cells followed by outer_cells,
+	neighbors of cell i and their data are in iteration_neighbors starting from
+	iteration_neighbor_offsets[i] up to iteration_neighbor_offsets[i + 1]
+	*/
+	std::vector<neighbor_and_data_t> iteration_data;
+	std::vector<size_t> iteration_neighbor_offsets;
+	std::vector<neighbor_and_data_t> iteration_neighbors;
+
+	// indices of outer cells in iteration_data with neighbors on each process
+	boost::unordered_map<int, std::vector<size_t> > outer_cells_of_sender;
+	// number of processes with neighbors of outer_cells[i]
+	std::vector<unsigned int> number_of_senders;
+
+	// cell on this process and its neighbors
+	boost::unordered_map<uint64_t, std::vector<uint64_t> > neighbors;
+
+	/*
+	Offsets of cells that are considered as neighbors of a cell and
+	offsets of cells that consider a cell as a neighbor
 	*/
 	std::vector<Types<3>::neighborhood_item_t> neighborhood_of, neighborhood_to;
 
@@ -2711,21 +4048,107 @@ private:
 	#endif
 
 	// cells whose data has to be received / sent by this process from the process as the key
-	#ifdef DCCRG_SEND_SINGLE_CELLS
-	// store cell, tag pairs so users can also send the data themselves easily
-	boost::unordered_map<int, std::vector<std::pair<uint64_t, int> > > cells_to_send, cells_to_receive;
-	#else
 	boost::unordered_map<int, std::vector<uint64_t> > cells_to_send, cells_to_receive;
-	#endif
 
 	// cells added to / removed from this process by load balancing
 	boost::unordered_set<uint64_t> added_cells, removed_cells;
 
-	#ifndef DCCRG_SEND_SINGLE_CELLS
+	#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+	// packed user data of cells that awaits transfer to or from this process, kept between transfers
+	boost::unordered_map<int, std::vector<uint8_t> > incoming_buffers, outgoing_buffers;
+	#else
+	// serialized user data of cells that awaits transfer to or from this process
+	boost::unordered_map<int, boost::mpi::packed_iarchive::buffer_type> incoming_buffers, outgoing_buffers;
+	#endif
+
+	// transfer policy of neighbor data updates given by the user
+	transfer_policy_t transfer_policy;
+
+	// policy of the user data transfers in progress, never AUTOMATIC_TRANSFER
+	transfer_policy_t active_transfer_policy;
+
+	// policies timed by AUTOMATIC_TRANSFER, their total transfer times and the fastest one once tuning is done
+	std::vector<transfer_policy_t> tuned_policies;
+	std::vector<double> tuned_times;
+	transfer_policy_t tuned_policy;
+	// number of neighbor data updates timed so far
+	unsigned int tuning_updates;
+	// whether the neighbor data update in progress is being timed
+	bool tuning_current_update;
+	// time spent in transfer functions during the neighbor data update in progress
+	double update_transfer_time;
+
+	// largest allowed message tag
+	int max_tag;
+	// see set_single_cell_transfer_limits()
+	uint64_t max_single_cell_messages, cells_per_coalesced_message;
+	// see set_migration_buffer_size()
+	uint64_t migration_buffer_size;
+
+	// see set_statistics_collection()
+	bool collect_statistics;
+	Statistics statistics;
+
+	// see start_tracing(), the record of the transfer in progress is written once its sends complete
+	std::ofstream* trace_file;
+	Trace_Record trace_record;
+	double trace_start_time;
+
+	// cells and bytes sent to other processes the last time cells were moved, see get_partition_quality()
+	uint64_t migrated_cells, migrated_bytes;
+	// weight of local cells right after they were moved, negative if cells or weights have changed since
+	double migrated_weight;
+
+	// see balance_load_if_worthwhile()
+	uint64_t rebalancing_horizon, rebalancing_min_steps;
+	double rebalancing_threshold, rebalancing_partition_time, rebalancing_seconds_per_byte;
+	std::ostream* rebalancing_log;
+	Rebalancing_Decision last_rebalancing_decision;
+	// steps and their total time on this process since the previous load balancing
+	uint64_t rebalancing_steps, rebalancing_total_steps;
+	double rebalancing_step_time;
+
+	#ifdef DCCRG_VARIABLE_CELL_DATA_SIZE
+	// sizes of user data in bytes last sent to / received from the process as the key, see exchange_cell_data_sizes()
+	boost::unordered_map<int, std::vector<uint64_t> > sent_data_sizes, received_data_sizes;
+	#endif
+
 	#ifndef DCCRG_CELL_DATA_SIZE_FROM_USER
-	// storage for cells' user data that awaits transfer to or from this process
-	boost::unordered_map<int, std::vector<UserData> > incoming_data, outgoing_data;
+	// user data of coalesced single cell messages that awaits transfer to or from this process
+	boost::unordered_map<int, std::vector<std::vector<UserData> > > incoming_chunks, outgoing_chunks;
+	#endif
+
+	#if defined(DCCRG_CELL_DATA_SIZE_FROM_USER) && MPI_VERSION >= 3
+	// graph communicator of processes exchanging neighbor data, see start_neighborhood_transfers()
+	MPI_Comm neighborhood_comm;
+	// value of cell_lists_version when neighborhood_comm was created
+	uint64_t neighborhood_comm_version;
+	// processes from which / to which neighbor data is transferred in neighborhood_comm
+	std::vector<int> neighborhood_sources, neighborhood_destinations;
+	// arguments of the neighborhood collective in progress
+	std::vector<int> neighborhood_receive_counts, neighborhood_send_counts;
+	std::vector<MPI_Aint> neighborhood_receive_displacements, neighborhood_send_displacements;
+	std::vector<MPI_Datatype> neighborhood_receive_datatypes, neighborhood_send_datatypes;
 	#endif
+
+	#ifdef DCCRG_SHARED_MEMORY_TRANSFER_AVAILABLE
+	// processes that share memory with this process, see start_shared_memory_transfers()
+	MPI_Comm node_comm;
+	// rank in node_comm of every process or -1 for processes that don't share memory with this process
+	std::vector<int> node_ranks;
+	// data of cells sent to processes in node_comm, in two halves used by every other transfer
+	MPI_Win shared_window;
+	// value of cell_lists_version when shared_window was created
+	uint64_t shared_window_version;
+	// number of transfers through shared_window so far
+	uint64_t shared_transfers;
+	// sorted cells of this process in shared_window
+	std::vector<uint64_t> shared_cells;
+	// start of shared_window and the size of its halves in bytes on every process in node_comm
+	std::vector<uint8_t*> shared_bases;
+	std::vector<MPI_Aint> shared_half_sizes;
+	// indices in shared_cells of the process as the key of cells received from it in cells_to_receive order
+	boost::unordered_map<int, std::vector<uint64_t> > shared_receive_indices;
 	#endif
 
 	// cells to be refined / unrefined after a call to stop_refining()
@@ -2748,6 +4171,8 @@ private:
 	Zoltan_Struct* zoltan;
 	// number of processes per part in a hierarchy level (numbering starts from 0)
 	std::vector<unsigned int> processes_per_part;
+	// part of this process on each level of hierarchial load balancing or -1 if given by processes_per_part
+	std::vector<int> level_parts;
 	// options for each level of hierarchial load balancing (numbering start from 0)
 	std::vector<boost::unordered_map<std::string, std::string> > partitioning_options;
 	// record whether Zoltan_LB_Partition is expected to fail (when the user selects NONE as the load balancing algorithm)
@@ -2758,6 +4183,16 @@ private:
 	// optional user-given weights of cells on this process
 	boost::unordered_map<uint64_t, double> cell_weights;
 
+	/*
+	Local cells, their weights and neighbors given to Zoltan by callbacks during partitioning,
+	neighbors of zoltan_cells[i] are at indices zoltan_neighbor_offsets[i]...[i + 1] - 1
+	*/
+	std::vector<uint64_t> zoltan_cells;
+	std::vector<float> zoltan_cell_weights;
+	std::vector<int> zoltan_neighbor_offsets;
+	std::vector<uint64_t> zoltan_neighbors;
+	std::vector<int> zoltan_neighbor_processes;
+
 
 
 	/*!
@@ -2765,10 +4200,38 @@ private:
 
 	Recalculates neighbor lists, etc.
 	Must be called simultaneously on all processes.
-	Clears user-given weights of all cells.
+	Clears user-given weights of all cells after recording
+	the total weight of each process for get_partition_quality().
 	*/
 	void move_cells(void) {
 		// TODO: get rid of added_cells and removed_cells and use cells_to_send and receive instead?
+		Phase_Timer timer(this->get_active_statistics(), "migration");
+
+		// weights of cells that stay plus weights of cells sent here by other processes
+		this->migrated_weight = 0;
+		std::vector<double> sent_weights(this->comm.size(), 0), received_weights;
+		BOOST_FOREACH(const cell_and_data_pair_t& item, this->cells) {
+			// added cells already exist if moving was prepared
+			if (this->removed_cells.count(item.first) > 0 || this->added_cells.count(item.first) > 0) {
+				continue;
+			}
+			const boost::unordered_map<uint64_t, double>::const_iterator weight = this->cell_weights.find(item.first);
+			this->migrated_weight += (weight != this->cell_weights.end()) ? weight->second : 1;
+		}
+		for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			receiver = this->cells_to_send.begin();
+			receiver != this->cells_to_send.end();
+			receiver++
+		) {
+			BOOST_FOREACH(const uint64_t& cell, receiver->second) {
+				const boost::unordered_map<uint64_t, double>::const_iterator weight = this->cell_weights.find(cell);
+				sent_weights[receiver->first] += (weight != this->cell_weights.end()) ? weight->second : 1;
+			}
+		}
+		all_to_all(this->comm, sent_weights, received_weights);
+		BOOST_FOREACH(const double& weight, received_weights) {
+			this->migrated_weight += weight;
+		}
 
 		this->cell_weights.clear();
 		this->cells_with_remote_neighbors.clear();
@@ -2785,15 +4248,11 @@ private:
 		Any cell can end up on any process and any neighbor of any cell can end up on yet another process
 		*/
 
-		// removed cells on all processes
-		std::vector<uint64_t> temp_removed_cells(
-			this->removed_cells.begin(),
-			this->removed_cells.end()
-		);
-		std::sort(temp_removed_cells.begin(), temp_removed_cells.end());
-
-		std::vector<std::vector<uint64_t> > all_removed_cells;
-		all_gather(this->comm, temp_removed_cells, all_removed_cells);
+		/*
+		Every process has the process of every cell so new owners of moved cells are
+		sent to all processes. Cells are gathered into one flat array without serialization
+		and removed cells are gathered only for checking since they are the same as added cells.
+		*/
 
 		// created cells on all processes
 		std::vector<uint64_t> temp_added_cells(
@@ -2802,20 +4261,21 @@ private:
 		);
 		std::sort(temp_added_cells.begin(), temp_added_cells.end());
 
-		std::vector<std::vector<uint64_t> > all_added_cells;
-		all_gather(this->comm, temp_added_cells, all_added_cells);
+		std::vector<int> added_counts, added_displacements;
+		std::vector<uint64_t> all_added_cells;
+		this->all_gather_cells(temp_added_cells, all_added_cells, added_counts, added_displacements);
 
-		this->start_user_data_transfers(
-		#ifdef DCCRG_SEND_SINGLE_CELLS
-		this->cells
-		#else
-		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
-		this->cells
-		#endif
-		#endif
+		#ifdef DEBUG
+		// removed cells on all processes
+		std::vector<uint64_t> temp_removed_cells(
+			this->removed_cells.begin(),
+			this->removed_cells.end()
 		);
+		std::sort(temp_removed_cells.begin(), temp_removed_cells.end());
+
+		std::vector<std::vector<uint64_t> > all_removed_cells;
+		all_gather(this->comm, temp_removed_cells, all_removed_cells);
 
-		#ifdef DEBUG
 		// check that there are no duplicate adds / removes
 		boost::unordered_set<uint64_t> all_adds, all_removes;
 
@@ -2833,18 +4293,23 @@ private:
 			}
 		}
 
-		BOOST_FOREACH(const std::vector<uint64_t>& item, all_added_cells) {
-			BOOST_FOREACH(const uint64_t& added_cell, item) {
+		BOOST_FOREACH(const uint64_t& added_cell, all_added_cells) {
 
-				if (all_adds.count(added_cell) > 0) {
-					std::cerr << __FILE__ << ":" << __LINE__
-						<< " Cell " << added_cell
-						<< " was already removed"
-						<< std::endl;
-					abort();
-				}
-				all_adds.insert(added_cell);
+			if (all_adds.count(added_cell) > 0) {
+				std::cerr << __FILE__ << ":" << __LINE__
+					<< " Cell " << added_cell
+					<< " was already added"
+					<< std::endl;
+				abort();
 			}
+			all_adds.insert(added_cell);
+		}
+
+		if (all_adds != all_removes) {
+			std::cerr << __FILE__ << ":" << __LINE__
+				<< " Added cells differ from removed cells"
+				<< std::endl;
+			abort();
 		}
 
 		// check that cells were removed by their process
@@ -2864,10 +4329,9 @@ private:
 		#endif
 
 		// update cell to process mappings
-		for (int cell_creator = 0; cell_creator < int(all_added_cells.size()); cell_creator++) {
-
-			BOOST_FOREACH(const uint64_t& created_cell, all_added_cells.at(cell_creator)) {
-				this->cell_process.at(created_cell) = cell_creator;
+		for (int cell_creator = 0; cell_creator < int(added_counts.size()); cell_creator++) {
+			for (int i = 0; i < added_counts[cell_creator]; i++) {
+				this->cell_process.at(all_added_cells[added_displacements[cell_creator] + i]) = cell_creator;
 			}
 		}
 
@@ -2883,38 +4347,91 @@ private:
 		}
 		#endif
 
-		// create neighbor lists for cells without children that came to this process
-		BOOST_FOREACH(const uint64_t& added_cell, this->added_cells) {
+		// transfer user data in rounds, see set_migration_buffer_size()
+		boost::unordered_map<int, std::vector<uint64_t> > all_cells_to_send, all_cells_to_receive;
+		all_cells_to_send.swap(this->cells_to_send);
+		all_cells_to_receive.swap(this->cells_to_receive);
 
-			if (added_cell != this->get_child(added_cell)) {
-				continue;
+		// both ends of a transfer must split their lists into rounds identically
+		for (boost::unordered_map<int, std::vector<uint64_t> >::iterator
+			receiver = all_cells_to_send.begin();
+			receiver != all_cells_to_send.end();
+			receiver++
+		) {
+			std::sort(receiver->second.begin(), receiver->second.end());
+		}
+
+		for (boost::unordered_map<int, std::vector<uint64_t> >::iterator
+			sender = all_cells_to_receive.begin();
+			sender != all_cells_to_receive.end();
+			sender++
+		) {
+			std::sort(sender->second.begin(), sender->second.end());
+		}
+
+		this->migrated_cells = 0;
+		this->migrated_bytes = 0;
+		for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			receiver = all_cells_to_send.begin();
+			receiver != all_cells_to_send.end();
+			receiver++
+		) {
+			this->migrated_cells += receiver->second.size();
+			BOOST_FOREACH(const uint64_t& cell, receiver->second) {
+				this->migrated_bytes += this->get_cell_data_bytes(cell);
 			}
+		}
 
-			this->neighbors[added_cell] = this->find_neighbors_of(added_cell);
-			this->neighbors_to[added_cell] = this->find_neighbors_to(added_cell);
+		const uint64_t rounds = this->get_migration_rounds(all_cells_to_send, all_cells_to_receive);
+		const transfer_policy_t migration_policy = this->get_migration_policy();
+
+		// cells received during previous round
+		std::vector<uint64_t> received_cells;
+
+		for (uint64_t round = 0; round < rounds; round++) {
+			this->cells_to_send = this->get_migration_round(all_cells_to_send, round, rounds);
+			this->cells_to_receive = this->get_migration_round(all_cells_to_receive, round, rounds);
+
+			this->start_user_data_transfers(this->cells, migration_policy);
+
+			// overlap with the transfers of this round
+			this->create_neighbor_lists_of_added_cells(received_cells);
+
+			this->wait_user_data_transfer_receives(this->cells);
+			this->wait_user_data_transfer_sends();
+
+			// free user data and neighbor lists of cells sent during this round
+			received_cells.clear();
+			for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+				receiver = this->cells_to_send.begin();
+				receiver != this->cells_to_send.end();
+				receiver++
+			) {
+				BOOST_FOREACH(const uint64_t& sent_cell, receiver->second) {
+					this->cells.erase(sent_cell);
+					this->neighbors.erase(sent_cell);
+					this->neighbors_to.erase(sent_cell);
+				}
+			}
+
+			for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+				sender = this->cells_to_receive.begin();
+				sender != this->cells_to_receive.end();
+				sender++
+			) {
+				received_cells.insert(received_cells.end(), sender->second.begin(), sender->second.end());
+			}
 		}
 
-		this->wait_user_data_transfer_receives(
-		#ifndef DCCRG_SEND_SINGLE_CELLS
-		#ifndef DCCRG_CELL_DATA_SIZE_FROM_USER
-		this->cells
-		#endif
-		#endif
-		);
-		this->wait_user_data_transfer_sends();
+		this->create_neighbor_lists_of_added_cells(received_cells);
+
 		this->cells_to_send.clear();
 		this->cells_to_receive.clear();
 
-		// free user data and neighbor lists of cells removed from this process
-		BOOST_FOREACH(const uint64_t& removed_cell, this->removed_cells) {
-			this->cells.erase(removed_cell);
-			this->neighbors.erase(removed_cell);
-			this->neighbors_to.erase(removed_cell);
-		}
-
 		this->update_remote_neighbor_info();
 
 		this->recalculate_neighbor_update_send_receive_lists();
+		this->update_cell_lists();
 
 		#ifdef DEBUG
 		if (!this->is_consistent()) {
@@ -2939,151 +4456,380 @@ private:
 		#endif
 	}
 
-	/*!
-	Prepares to move cells between processes with move_cells.
 
-	Sends user data of cells between processes once before move_cells so that
-	the correct mpi datatype can be constructed when actually moving cells.
+	/*!
+	Gathers given cells from all processes into one array.
 
+	Cells from process n start at displacements[n] in gathered_cells and there are counts[n] of them.
 	Must be called simultaneously on all processes.
-	move_cells must be the next dccrg function to be called after this one.
 	*/
-	void prepare_to_move_cells(void) {
+	void all_gather_cells(
+		const std::vector<uint64_t>& local_cells,
+		std::vector<uint64_t>& gathered_cells,
+		std::vector<int>& counts,
+		std::vector<int>& displacements
+	) {
+		int local_count = int(local_cells.size());
+		counts.resize(this->comm.size());
+		MPI_Allgather(&local_count, 1, MPI_INT, &(counts[0]), 1, MPI_INT, this->comm);
 
-		#ifdef DEBUG
-		if (!this->verify_remote_neighbor_info()) {
-			std::cerr << __FILE__ << ":" << __LINE__ << " Remote neighbor info is not consistent" << std::endl;
-			exit(EXIT_FAILURE);
+		displacements.resize(this->comm.size());
+		uint64_t total_count = 0;
+		for (int process = 0; process < this->comm.size(); process++) {
+			displacements[process] = int(total_count);
+			total_count += counts[process];
 		}
 
-		if (!this->verify_user_data()) {
-			std::cerr << __FILE__ << ":" << __LINE__ << " virhe" << std::endl;
-			exit(EXIT_FAILURE);
+		gathered_cells.resize(total_count);
+		if (total_count == 0) {
+			return;
 		}
-		#endif
 
-		this->cells_with_remote_neighbors.clear();
-		this->remote_cells_with_local_neighbors.clear();
-		this->remote_neighbors.clear();
-		this->cells_to_refine.clear();
-		this->refined_cell_data.clear();
-		this->cells_to_unrefine.clear();
-		this->unrefined_cell_data.clear();
+		MPI_Allgatherv(
+			local_count > 0 ? const_cast<uint64_t*>(&(local_cells[0])) : NULL,
+			local_count,
+			MPI_UINT64_T,
+			&(gathered_cells[0]),
+			&(counts[0]),
+			&(displacements[0]),
+			MPI_UINT64_T,
+			this->comm
+		);
+	}
+
+
+	/*!
+	Returns the smallest rank of processes that share memory with this process.
+
+	Must be called simultaneously on all processes.
+	*/
+	int get_node_leader(void) const
+	{
+		int leader = this->comm.rank();
+
+		#if MPI_VERSION >= 3
+
+		MPI_Comm node_comm;
+		MPI_Comm_split_type(this->comm, MPI_COMM_TYPE_SHARED, this->comm.rank(), MPI_INFO_NULL, &node_comm);
+		MPI_Allreduce(MPI_IN_PLACE, &leader, 1, MPI_INT, MPI_MIN, node_comm);
+		MPI_Comm_free(&node_comm);
 
-		this->start_user_data_transfers(
-		#ifdef DCCRG_SEND_SINGLE_CELLS
-		this->cells
 		#else
-		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
-		this->cells
-		#endif
-		#endif
-		);
 
-		#ifdef DEBUG
-		// check that there are no duplicate adds / removes
-		// removed cells on all processes
-		std::vector<uint64_t> temp_removed_cells(
-			this->removed_cells.begin(),
-			this->removed_cells.end()
-		);
-		std::sort(temp_removed_cells.begin(), temp_removed_cells.end());
+		char name[MPI_MAX_PROCESSOR_NAME];
+		int name_length = 0;
+		MPI_Get_processor_name(name, &name_length);
 
-		std::vector<std::vector<uint64_t> > all_removed_cells;
-		all_gather(this->comm, temp_removed_cells, all_removed_cells);
+		std::vector<std::string> names;
+		all_gather(this->comm, std::string(name, name_length), names);
+		leader = int(std::find(names.begin(), names.end(), names[this->comm.rank()]) - names.begin());
 
-		// created cells on all processes
-		std::vector<uint64_t> temp_added_cells(
-			this->added_cells.begin(),
-			this->added_cells.end()
-		);
-		std::sort(temp_added_cells.begin(), temp_added_cells.end());
+		#endif
 
-		std::vector<std::vector<uint64_t> > all_added_cells;
-		all_gather(this->comm, temp_added_cells, all_added_cells);
+		return leader;
+	}
 
-		boost::unordered_set<uint64_t> all_adds, all_removes;
 
-		BOOST_FOREACH(const std::vector<uint64_t>& item, all_removed_cells) {
-			BOOST_FOREACH(const uint64_t& removed_cell, item) {
+	/*!
+	Returns the id of the processor socket this process is pinned to or -1 if it isn't known.
 
-				if (all_removes.count(removed_cell) > 0) {
-					std::cerr << __FILE__ << ":" << __LINE__
-						<< " Cell " << removed_cell
-						<< " was already removed"
-						<< std::endl;
-					abort();
-				}
-				all_removes.insert(removed_cell);
-			}
-		}
+	The socket is known only if every cpu this process is allowed to run on
+	has the same physical package id in /sys on Linux.
+	*/
+	int get_socket_id(void) const
+	{
+		int socket = -1;
 
-		BOOST_FOREACH(const std::vector<uint64_t>& item, all_added_cells) {
-			BOOST_FOREACH(const uint64_t& added_cell, item) {
+		#ifdef __linux__
+		cpu_set_t allowed_cpus;
+		CPU_ZERO(&allowed_cpus);
+		if (sched_getaffinity(0, sizeof(allowed_cpus), &allowed_cpus) != 0) {
+			return -1;
+		}
 
-				if (all_adds.count(added_cell) > 0) {
-					std::cerr << __FILE__ << ":" << __LINE__
-						<< " Cell " << added_cell
-						<< " was already removed"
-						<< std::endl;
-					abort();
-				}
-				all_adds.insert(added_cell);
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (!CPU_ISSET(cpu, &allowed_cpus)) {
+				continue;
 			}
-		}
 
-		// check that cells were removed by their process
-		for (int cell_remover = 0; cell_remover < int(all_removed_cells.size()); cell_remover++) {
+			std::ostringstream file_name;
+			file_name << "/sys/devices/system/cpu/cpu" << cpu << "/topology/physical_package_id";
 
-			BOOST_FOREACH(const uint64_t& removed_cell, all_removed_cells.at(cell_remover)) {
+			std::ifstream file(file_name.str().c_str());
+			int cpu_socket = -1;
+			if (!(file >> cpu_socket) || cpu_socket < 0) {
+				return -1;
+			}
 
-				if (this->cell_process.at(removed_cell) != cell_remover) {
-					std::cerr << __FILE__ << ":" << __LINE__
-						<< " Cell " << removed_cell
-						<< " doesn't belong to process " << cell_remover
-						<< std::endl;
-					abort();
-				}
+			if (socket >= 0 && cpu_socket != socket) {
+				return -1;
 			}
+			socket = cpu_socket;
 		}
 		#endif
 
-		this->wait_user_data_transfer_receives(
-		#ifndef DCCRG_SEND_SINGLE_CELLS
-		#ifndef DCCRG_CELL_DATA_SIZE_FROM_USER
-		this->cells
-		#endif
-		#endif
-		);
-		this->wait_user_data_transfer_sends();
+		return socket;
 	}
 
 
 	/*!
-	Updates user pin requests globally based on new_pin_requests.
-
-	Must be called simultaneously on all processes.
+	Creates neighbor lists for given cells without children that came to this process.
 	*/
-	void update_pin_requests(void)
+	void create_neighbor_lists_of_added_cells(const std::vector<uint64_t>& given_cells)
 	{
-		std::vector<uint64_t> new_pinned_cells, new_pinned_processes;
+		Phase_Timer timer(this->get_active_statistics(), "neighbor_lists");
+		BOOST_FOREACH(const uint64_t& added_cell, given_cells) {
 
-		new_pinned_cells.reserve(this->new_pin_requests.size());
-		new_pinned_processes.reserve(this->new_pin_requests.size());
-		for (boost::unordered_map<uint64_t, int>::const_iterator
-			item = this->new_pin_requests.begin();
-			item != this->new_pin_requests.end();
-			item++
-		) {
-			new_pinned_cells.push_back(item->first);
-			new_pinned_processes.push_back(item->second);
+			if (added_cell != this->get_child(added_cell)) {
+				continue;
+			}
+
+			this->find_neighbors_of(added_cell, this->neighbors[added_cell]);
+			this->neighbors_to[added_cell] = this->find_neighbors_to(added_cell);
 		}
+	}
 
-		std::vector<std::vector<uint64_t> > all_new_pinned_cells, all_new_pinned_processes;
-		all_gather(this->comm, new_pinned_cells, all_new_pinned_cells);
-		all_gather(this->comm, new_pinned_processes, all_new_pinned_processes);
 
-		for (int process = 0; process < int(all_new_pinned_cells.size()); process++) {
+	/*!
+	Returns the number of rounds in which move_cells() transfers given cells.
+
+	Rounds are chosen so that no process transfers more than about migration_buffer_size
+	bytes per round assuming that every cell has as much data as the largest one.
+	Must be called simultaneously on all processes.
+	*/
+	uint64_t get_migration_rounds(
+		const boost::unordered_map<int, std::vector<uint64_t> >& send_lists,
+		const boost::unordered_map<int, std::vector<uint64_t> >& receive_lists
+	) {
+		if (this->migration_buffer_size == 0) {
+			return 1;
+		}
+
+		uint64_t sent_cells = 0, received_cells = 0, max_cell_bytes = 0;
+
+		for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			receiver = send_lists.begin();
+			receiver != send_lists.end();
+			receiver++
+		) {
+			sent_cells += receiver->second.size();
+			BOOST_FOREACH(const uint64_t& cell, receiver->second) {
+				max_cell_bytes = std::max(max_cell_bytes, this->get_cell_data_bytes(cell));
+			}
+		}
+
+		for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			sender = receive_lists.begin();
+			sender != receive_lists.end();
+			sender++
+		) {
+			received_cells += sender->second.size();
+		}
+
+		const uint64_t
+			max_cells = all_reduce(this->comm, std::max(sent_cells, received_cells), boost::mpi::maximum<uint64_t>()),
+			max_bytes = all_reduce(this->comm, max_cell_bytes, boost::mpi::maximum<uint64_t>());
+
+		return std::max(
+			uint64_t(1),
+			(max_cells * max_bytes + this->migration_buffer_size - 1) / this->migration_buffer_size
+		);
+	}
+
+
+	/*!
+	Returns the number of bytes in the user data of given cell on this process, see set_migration_buffer_size().
+	*/
+	uint64_t get_cell_data_bytes(const uint64_t cell)
+	{
+		return this->get_data_bytes(this->cells.at(cell));
+	}
+
+	/*!
+	Returns the number of bytes in given user data, see set_migration_buffer_size().
+	*/
+	uint64_t get_data_bytes(UserData& data) const
+	{
+		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		#ifdef DCCRG_USER_MPI_DATA_TYPE
+		MPI_Datatype user_datatype = data.mpi_datatype();
+		int bytes = 0;
+		MPI_Type_size(user_datatype, &bytes);
+		MPI_Type_free(&user_datatype);
+		return uint64_t(bytes);
+		#else
+		return data.size();
+		#endif
+
+		#else
+		(void) data;
+		return sizeof(UserData);
+		#endif
+	}
+
+
+	/*!
+	Returns the cells of given round out of given rounds from given sorted send or receive lists.
+	*/
+	boost::unordered_map<int, std::vector<uint64_t> > get_migration_round(
+		const boost::unordered_map<int, std::vector<uint64_t> >& lists,
+		const uint64_t round,
+		const uint64_t rounds
+	) const {
+		boost::unordered_map<int, std::vector<uint64_t> > result;
+
+		for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			process = lists.begin();
+			process != lists.end();
+			process++
+		) {
+			const uint64_t
+				first = process->second.size() * round / rounds,
+				last = process->second.size() * (round + 1) / rounds;
+
+			if (first == last) {
+				continue;
+			}
+
+			result[process->first].assign(process->second.begin() + first, process->second.begin() + last);
+		}
+
+		return result;
+	}
+
+
+	/*!
+	Prepares to move cells between processes with move_cells.
+
+	Sends user data of cells between processes once before move_cells so that
+	the correct mpi datatype can be constructed when actually moving cells.
+
+	Must be called simultaneously on all processes.
+	move_cells must be the next dccrg function to be called after this one.
+	*/
+	void prepare_to_move_cells(void) {
+
+		#ifdef DEBUG
+		if (!this->verify_remote_neighbor_info()) {
+			std::cerr << __FILE__ << ":" << __LINE__ << " Remote neighbor info is not consistent" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		if (!this->verify_user_data()) {
+			std::cerr << __FILE__ << ":" << __LINE__ << " virhe" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		#endif
+
+		this->cells_with_remote_neighbors.clear();
+		this->remote_cells_with_local_neighbors.clear();
+		this->remote_neighbors.clear();
+		this->cells_to_refine.clear();
+		this->refined_cell_data.clear();
+		this->cells_to_unrefine.clear();
+		this->unrefined_cell_data.clear();
+
+		this->start_user_data_transfers(this->cells, this->get_migration_policy());
+
+		#ifdef DEBUG
+		// check that there are no duplicate adds / removes
+		// removed cells on all processes
+		std::vector<uint64_t> temp_removed_cells(
+			this->removed_cells.begin(),
+			this->removed_cells.end()
+		);
+		std::sort(temp_removed_cells.begin(), temp_removed_cells.end());
+
+		std::vector<std::vector<uint64_t> > all_removed_cells;
+		all_gather(this->comm, temp_removed_cells, all_removed_cells);
+
+		// created cells on all processes
+		std::vector<uint64_t> temp_added_cells(
+			this->added_cells.begin(),
+			this->added_cells.end()
+		);
+		std::sort(temp_added_cells.begin(), temp_added_cells.end());
+
+		std::vector<std::vector<uint64_t> > all_added_cells;
+		all_gather(this->comm, temp_added_cells, all_added_cells);
+
+		boost::unordered_set<uint64_t> all_adds, all_removes;
+
+		BOOST_FOREACH(const std::vector<uint64_t>& item, all_removed_cells) {
+			BOOST_FOREACH(const uint64_t& removed_cell, item) {
+
+				if (all_removes.count(removed_cell) > 0) {
+					std::cerr << __FILE__ << ":" << __LINE__
+						<< " Cell " << removed_cell
+						<< " was already removed"
+						<< std::endl;
+					abort();
+				}
+				all_removes.insert(removed_cell);
+			}
+		}
+
+		BOOST_FOREACH(const std::vector<uint64_t>& item, all_added_cells) {
+			BOOST_FOREACH(const uint64_t& added_cell, item) {
+
+				if (all_adds.count(added_cell) > 0) {
+					std::cerr << __FILE__ << ":" << __LINE__
+						<< " Cell " << added_cell
+						<< " was already removed"
+						<< std::endl;
+					abort();
+				}
+				all_adds.insert(added_cell);
+			}
+		}
+
+		// check that cells were removed by their process
+		for (int cell_remover = 0; cell_remover < int(all_removed_cells.size()); cell_remover++) {
+
+			BOOST_FOREACH(const uint64_t& removed_cell, all_removed_cells.at(cell_remover)) {
+
+				if (this->cell_process.at(removed_cell) != cell_remover) {
+					std::cerr << __FILE__ << ":" << __LINE__
+						<< " Cell " << removed_cell
+						<< " doesn't belong to process " << cell_remover
+						<< std::endl;
+					abort();
+				}
+			}
+		}
+		#endif
+
+		this->wait_user_data_transfer_receives(this->cells);
+		this->wait_user_data_transfer_sends();
+	}
+
+
+	/*!
+	Updates user pin requests globally based on new_pin_requests.
+
+	Must be called simultaneously on all processes.
+	*/
+	void update_pin_requests(void)
+	{
+		std::vector<uint64_t> new_pinned_cells, new_pinned_processes;
+
+		new_pinned_cells.reserve(this->new_pin_requests.size());
+		new_pinned_processes.reserve(this->new_pin_requests.size());
+		for (boost::unordered_map<uint64_t, int>::const_iterator
+			item = this->new_pin_requests.begin();
+			item != this->new_pin_requests.end();
+			item++
+		) {
+			new_pinned_cells.push_back(item->first);
+			new_pinned_processes.push_back(item->second);
+		}
+
+		std::vector<std::vector<uint64_t> > all_new_pinned_cells, all_new_pinned_processes;
+		all_gather(this->comm, new_pinned_cells, all_new_pinned_cells);
+		all_gather(this->comm, new_pinned_processes, all_new_pinned_processes);
+
+		for (int process = 0; process < int(all_new_pinned_cells.size()); process++) {
 			for (unsigned int i = 0; i < all_new_pinned_cells.at(process).size(); i++) {
 
 				const int requested_process = all_new_pinned_processes[process][i];
@@ -3107,6 +4853,71 @@ private:
 	}
 
 
+	/*!
+	Creates the lists of local cells and their neighbors that Zoltan callbacks give to Zoltan.
+
+	Neighbors that are 0 or the cell itself are left out.
+	*/
+	void build_zoltan_graph(void)
+	{
+		this->zoltan_cells.clear();
+		this->zoltan_cell_weights.clear();
+		this->zoltan_neighbor_offsets.clear();
+		this->zoltan_neighbors.clear();
+		this->zoltan_neighbor_processes.clear();
+
+		this->zoltan_cells.reserve(this->cells.size());
+		this->zoltan_cell_weights.reserve(this->cells.size());
+		this->zoltan_neighbor_offsets.reserve(this->cells.size() + 1);
+
+		this->zoltan_neighbor_offsets.push_back(0);
+		BOOST_FOREACH(const cell_and_data_pair_t& item, this->cells) {
+
+			#ifdef DEBUG
+			if (item.first == 0) {
+				std::cerr << "User data exist for an illegal cell" << std::endl;
+				abort();
+			}
+			#endif
+
+			this->zoltan_cells.push_back(item.first);
+
+			const boost::unordered_map<uint64_t, double>::const_iterator weight = this->cell_weights.find(item.first);
+			if (weight != this->cell_weights.end()) {
+				this->zoltan_cell_weights.push_back(weight->second);
+			} else {
+				this->zoltan_cell_weights.push_back(1);
+			}
+
+			BOOST_FOREACH(const uint64_t& neighbor, this->neighbors.at(item.first)) {
+				if (neighbor == 0
+				/* Zoltan 3.501 crashes in hierarchial
+				if a cell is a neighbor to itself */
+				|| neighbor == item.first) {
+					continue;
+				}
+
+				this->zoltan_neighbors.push_back(neighbor);
+				this->zoltan_neighbor_processes.push_back(this->cell_process.at(neighbor));
+			}
+
+			this->zoltan_neighbor_offsets.push_back(this->zoltan_neighbors.size());
+		}
+	}
+
+	/*!
+	Frees the memory used by build_zoltan_graph().
+	*/
+	void clear_zoltan_graph(void)
+	{
+		std::vector<uint64_t>().swap(this->zoltan_cells);
+		std::vector<float>().swap(this->zoltan_cell_weights);
+		std::vector<int>().swap(this->zoltan_neighbor_offsets);
+		std::vector<uint64_t>().swap(this->zoltan_neighbors);
+		std::vector<int>().swap(this->zoltan_neighbor_processes);
+	}
+
+
 	/*!
 	Repartitions cells across processes based on user requests and
 	Zoltan if use_zoltan is true.
@@ -3115,12 +4926,17 @@ private:
 	*/
 	void make_new_partition(const bool use_zoltan)
 	{
+		Phase_Timer timer(this->get_active_statistics(), "partition");
 		this->update_pin_requests();
 
 		int partition_changed, global_id_size, local_id_size, number_to_receive, number_to_send;
 		ZOLTAN_ID_PTR global_ids_to_receive, local_ids_to_receive, global_ids_to_send, local_ids_to_send;
 		int *sender_processes, *receiver_processes;
 
+		if (use_zoltan) {
+			this->build_zoltan_graph();
+		}
+
 		if (use_zoltan && Zoltan_LB_Balance(
 			this->zoltan,
 			&partition_changed,
@@ -3164,6 +4980,8 @@ private:
 			#endif
 		}
 
+		this->clear_zoltan_graph();
+
 		this->cells_to_receive.clear();
 		this->cells_to_send.clear();
 
@@ -3181,13 +4999,7 @@ private:
 
 			if (pin_request->second == this->comm.rank()
 			&& current_process_of_cell != this->comm.rank()) {
-				this->cells_to_receive[current_process_of_cell].push_back(
-					#ifdef DCCRG_SEND_SINGLE_CELLS
-					std::make_pair(pin_request->first, -1)
-					#else
-					pin_request->first
-					#endif
-				);
+				this->cells_to_receive[current_process_of_cell].push_back(pin_request->first);
 				this->added_cells.insert(pin_request->first);
 			}
 		}
@@ -3206,13 +5018,7 @@ private:
 					continue;
 				}
 
-				this->cells_to_receive[sender_processes[i]].push_back(
-					#ifdef DCCRG_SEND_SINGLE_CELLS
-					std::make_pair(global_ids_to_receive[i], -1)
-					#else
-					global_ids_to_receive[i]
-					#endif
-				);
+				this->cells_to_receive[sender_processes[i]].push_back(global_ids_to_receive[i]);
 
 				#ifdef DEBUG
 				if (added_cells.count(global_ids_to_receive[i]) > 0) {
@@ -3228,24 +5034,14 @@ private:
 			}
 		}
 
-		// receive cells in known order and add message tags
+		// receive cells in known order
 		for (
-			#ifdef DCCRG_SEND_SINGLE_CELLS
-			boost::unordered_map<int, std::vector<std::pair<uint64_t, int> > >::iterator
-			#else
 			boost::unordered_map<int, std::vector<uint64_t> >::iterator
-			#endif
 			sender = this->cells_to_receive.begin();
 			sender != this->cells_to_receive.end();
 			sender++
 		) {
 			std::sort(sender->second.begin(), sender->second.end());
-			#ifdef DCCRG_SEND_SINGLE_CELLS
-			// TODO: check that message tags don't overflow
-			for (unsigned int i = 0; i < sender->second.size(); i++) {
-				sender->second[i].second = i + 1;
-			}
-			#endif
 		}
 
 
@@ -3264,13 +5060,7 @@ private:
 
 			if (destination_process != this->comm.rank()
 			&& current_process_of_cell == this->comm.rank()) {
-				this->cells_to_send[destination_process].push_back(
-					#ifdef DCCRG_SEND_SINGLE_CELLS
-					std::make_pair(pin_request->first, -1)
-					#else
-					pin_request->first
-					#endif
-				);
+				this->cells_to_send[destination_process].push_back(pin_request->first);
 				this->removed_cells.insert(pin_request->first);
 			}
 		}
@@ -3289,13 +5079,7 @@ private:
 					continue;
 				}
 
-				this->cells_to_send[receiver_processes[i]].push_back(
-					#ifdef DCCRG_SEND_SINGLE_CELLS
-					std::make_pair(global_ids_to_send[i], -1)
-					#else
-					global_ids_to_send[i]
-					#endif
-				);
+				this->cells_to_send[receiver_processes[i]].push_back(global_ids_to_send[i]);
 
 				#ifdef DEBUG
 				if (removed_cells.count(global_ids_to_send[i]) > 0) {
@@ -3320,40 +5104,322 @@ private:
 			);
 		}
 
-		// send cells in known order and add message tags
+		// send cells in known order
 		for (
-			#ifdef DCCRG_SEND_SINGLE_CELLS
-			boost::unordered_map<int, std::vector<std::pair<uint64_t, int> > >::iterator
-			#else
 			boost::unordered_map<int, std::vector<uint64_t> >::iterator
-			#endif
 			receiver = this->cells_to_send.begin();
 			receiver != this->cells_to_send.end();
 			receiver++
 		) {
 			std::sort(receiver->second.begin(), receiver->second.end());
-			#ifdef DCCRG_SEND_SINGLE_CELLS
-			// TODO: check that message tags don't overflow
-			for (unsigned int i = 0; i < receiver->second.size(); i++) {
-				receiver->second[i].second = i + 1;
-			}
-			#endif
 		}
 	}
 
 
 	/*!
-	Calculates what to send and where during a remote neighbor data update.
+	Updates the lists of cells returned by get_cells(), get_all_cells(), etc.
 
-	Assumes up-to-date neighbor lists, clears previous send / receive lists.
+	Assumes up-to-date neighbor lists, must be called every time cells have been
+	created, removed or moved between processes.
 	*/
-	void recalculate_neighbor_update_send_receive_lists(void)
+	void update_cell_lists(void)
 	{
-		// clear previous lists
-		this->cells_to_send.clear();
-		this->cells_to_receive.clear();
+		this->local_cells.clear();
+		this->local_cells.reserve(this->cells.size());
 
-		// only send a cell to a process once
+		BOOST_FOREACH(const cell_and_data_pair_t& item, this->cells) {
+
+			#ifdef DEBUG
+			if (this->cell_process.count(item.first) == 0) {
+				std::cerr << __FILE__ << ":" << __LINE__
+					<< " Cell " << item.first
+					<< " shouldn't exist"
+					<< std::endl;
+				abort();
+			}
+
+			if (this->cell_process.at(item.first) != this->comm.rank()) {
+				std::cerr << __FILE__ << ":" << __LINE__
+					<< " Process " << this->comm.rank()
+					<< ": Cell " << item.first
+					<< " should be on process " << this->cell_process.at(item.first)
+					<< std::endl;
+				abort();
+			}
+
+			const uint64_t child = this->get_child(item.first);
+			if (child == 0) {
+				std::cerr << __FILE__ << ":" << __LINE__
+					<< " Process " << this->comm.rank()
+					<< ": Child == 0 for cell " << item.first
+					<< std::endl;
+				abort();
+			}
+
+			if (child != item.first) {
+				std::cerr << __FILE__ << ":" << __LINE__
+					<< " Process " << this->comm.rank()
+					<< ": Cell " << item.first
+					<< " has a child"
+					<< std::endl;
+				abort();
+			}
+			#endif
+
+			this->local_cells.push_back(item.first);
+		}
+		std::sort(this->local_cells.begin(), this->local_cells.end());
+
+		this->inner_cells.clear();
+		this->outer_cells.clear();
+
+		BOOST_FOREACH(const uint64_t& cell, this->local_cells) {
+
+			bool has_remote_neighbor = false;
+
+			assert(this->neighbors.count(cell) > 0);
+
+			BOOST_FOREACH(const uint64_t& neighbor, this->neighbors.at(cell)) {
+
+				if (neighbor == 0) {
+					continue;
+				}
+
+				if (this->cell_process.at(neighbor) != this->comm.rank()) {
+					has_remote_neighbor = true;
+					break;
+				}
+			}
+
+			if (has_remote_neighbor) {
+				this->outer_cells.push_back(cell);
+			} else {
+				this->inner_cells.push_back(cell);
+			}
+		}
+
+		this->all_cells.clear();
+		this->all_cells.reserve(this->cell_process.size());
+
+		for (boost::unordered_map<uint64_t, int>::const_iterator
+			item = this->cell_process.begin();
+			item != this->cell_process.end();
+			item++
+		) {
+			if (item->first == this->get_child(item->first)) {
+				this->all_cells.push_back(item->first);
+			}
+		}
+		std::sort(this->all_cells.begin(), this->all_cells.end());
+
+		this->update_cell_iteration_data();
+
+		this->cell_lists_version++;
+	}
+
+
+	/*!
+	Updates the cells, data and neighbors used by for_each_cell().
+
+	Creates the data of all remote neighbors of local cells so that
+	the data doesn't move in memory until the next call to this function.
+	*/
+	void update_cell_iteration_data(void)
+	{
+		this->iteration_data.clear();
+		this->iteration_neighbor_offsets.clear();
+		this->iteration_neighbors.clear();
+
+		this->iteration_data.reserve(this->local_cells.size());
+		this->iteration_neighbor_offsets.reserve(this->local_cells.size() + 1);
+
+		size_t number_of_neighbors = 0;
+		BOOST_FOREACH(const uint64_t& cell, this->local_cells) {
+			number_of_neighbors += this->neighbors.at(cell).size();
+		}
+		this->iteration_neighbors.reserve(number_of_neighbors);
+
+		this->iteration_neighbor_offsets.push_back(0);
+
+		for (int list = 0; list < 2; list++) {
+
+			const std::vector<uint64_t>& iterated_cells = (list == 0) ? this->inner_cells : this->outer_cells;
+
+			BOOST_FOREACH(const uint64_t& cell, iterated_cells) {
+
+				this->iteration_data.push_back(std::make_pair(cell, &(this->cells.at(cell))));
+
+				BOOST_FOREACH(const uint64_t& neighbor, this->neighbors.at(cell)) {
+
+					UserData* neighbor_data = NULL;
+
+					if (neighbor == 0) {
+						// neighbor doesn't exist
+					} else if (this->cell_process.at(neighbor) == this->comm.rank()) {
+						neighbor_data = &(this->cells.at(neighbor));
+					} else {
+						neighbor_data = &(this->remote_neighbors[neighbor]);
+					}
+
+					this->iteration_neighbors.push_back(std::make_pair(neighbor, neighbor_data));
+				}
+
+				this->iteration_neighbor_offsets.push_back(this->iteration_neighbors.size());
+			}
+		}
+
+		this->outer_cells_of_sender.clear();
+		this->number_of_senders.clear();
+		this->number_of_senders.reserve(this->outer_cells.size());
+
+		std::vector<int> senders;
+		for (size_t i = this->inner_cells.size(); i < this->iteration_data.size(); i++) {
+
+			senders.clear();
+			for (size_t j = this->iteration_neighbor_offsets[i]; j < this->iteration_neighbor_offsets[i + 1]; j++) {
+
+				const uint64_t neighbor = this->iteration_neighbors[j].first;
+				if (neighbor == 0) {
+					continue;
+				}
+
+				const int process = this->cell_process.at(neighbor);
+				if (process != this->comm.rank()
+				&& std::find(senders.begin(), senders.end(), process) == senders.end()) {
+					senders.push_back(process);
+					this->outer_cells_of_sender[process].push_back(i);
+				}
+			}
+
+			this->number_of_senders.push_back(senders.size());
+		}
+	}
+
+
+	/*!
+	Calls given functor as in for_each_cell() for cells from first to last in iteration_data.
+
+	If indices is not NULL uses cells at indices[first] ... indices[last - 1] in iteration_data instead.
+	If compiled with OpenMP cells are processed in parallel.
+	*/
+	template<class Functor> void call_for_cells(
+		Functor& functor,
+		const size_t first,
+		const size_t last,
+		const size_t* indices
+	) {
+		const neighbor_and_data_t* const neighbors_of
+			= this->iteration_neighbors.empty() ? NULL : &(this->iteration_neighbors[0]);
+
+		const int number_of_cells = int(last - first);
+		#ifdef _OPENMP
+		#pragma omp parallel for
+		#endif
+		for (int i = 0; i < number_of_cells; i++) {
+			const size_t cell_index = (indices == NULL) ? first + i : indices[first + i];
+
+			functor(
+				this->iteration_data[cell_index].first,
+				*(this->iteration_data[cell_index].second),
+				neighbors_of + this->iteration_neighbor_offsets[cell_index],
+				neighbors_of + this->iteration_neighbor_offsets[cell_index + 1]
+			);
+		}
+	}
+
+
+	/*!
+	Returns indices of given receive requests that have completed since the previous call.
+
+	Requests that have already completed must be marked in finished.
+	If wait is true waits until at least one request completes if any are unfinished.
+	*/
+	std::vector<size_t> test_receives(
+		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+		std::vector<MPI_Request>& requests,
+		#else
+		std::vector<boost::mpi::request>& requests,
+		#endif
+		std::vector<bool>& finished,
+		const bool wait
+	) {
+		std::vector<size_t> completed;
+
+		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		// finished requests are MPI_REQUEST_NULL
+		std::vector<int> indices(requests.size());
+		std::vector<MPI_Status> statuses(requests.size());
+		int number_of_completed = 0;
+
+		const int result
+			= wait
+			? MPI_Waitsome(requests.size(), &(requests[0]), &number_of_completed, &(indices[0]), &(statuses[0]))
+			: MPI_Testsome(requests.size(), &(requests[0]), &number_of_completed, &(indices[0]), &(statuses[0]));
+
+		if (result != MPI_SUCCESS) {
+			for (int i = 0; i < number_of_completed; i++) {
+				if (statuses[i].MPI_ERROR != MPI_SUCCESS) {
+					std::cerr << "MPI receive failed from process " << statuses[i].MPI_SOURCE
+						<< " with tag " << statuses[i].MPI_TAG
+						<< std::endl;
+				}
+			}
+		}
+
+		if (number_of_completed == MPI_UNDEFINED) {
+			number_of_completed = 0;
+		}
+
+		for (int i = 0; i < number_of_completed; i++) {
+			finished[indices[i]] = true;
+			completed.push_back(indices[i]);
+		}
+
+		#else	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		bool unfinished_requests = true;
+		while (completed.size() == 0 && unfinished_requests) {
+
+			unfinished_requests = false;
+			for (size_t i = 0; i < requests.size(); i++) {
+
+				if (finished[i]) {
+					continue;
+				}
+
+				if (requests[i].test()) {
+					finished[i] = true;
+					completed.push_back(i);
+				} else {
+					unfinished_requests = true;
+				}
+			}
+
+			if (!wait) {
+				break;
+			}
+		}
+
+		#endif	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		return completed;
+	}
+
+
+	/*!
+	Calculates what to send and where during a remote neighbor data update.
+
+	Assumes up-to-date neighbor lists, clears previous send / receive lists.
+	*/
+	void recalculate_neighbor_update_send_receive_lists(void)
+	{
+		Phase_Timer timer(this->get_active_statistics(), "send_receive_lists");
+		// clear previous lists
+		this->cells_to_send.clear();
+		this->cells_to_receive.clear();
+
+		// only send a cell to a process once
 		boost::unordered_map<int, boost::unordered_set<uint64_t> > unique_cells_to_send, unique_cells_to_receive;
 
 		// calculate new lists for neighbor data updates
@@ -3404,26 +5470,13 @@ private:
 			this->cells_to_send[receiver->first].reserve(receiver->second.size());
 
 			BOOST_FOREACH(const uint64_t& cell, receiver->second) {
-				this->cells_to_send[receiver->first].push_back(
-					#ifdef DCCRG_SEND_SINGLE_CELLS
-					std::make_pair(cell, -1)
-					#else
-					cell
-					#endif
-				);
+				this->cells_to_send[receiver->first].push_back(cell);
 			}
 
 			sort(
 				this->cells_to_send[receiver->first].begin(),
 				this->cells_to_send[receiver->first].end()
 			);
-
-			#ifdef DCCRG_SEND_SINGLE_CELLS
-			// sequential tags for messages: 1, 2, ...
-			for (unsigned int i = 0; i < this->cells_to_send[receiver->first].size(); i++) {
-				this->cells_to_send[receiver->first][i].second = i + 1;
-			}
-			#endif
 		}
 
 		// populate final receive list data structures and sort them
@@ -3436,26 +5489,13 @@ private:
 
 			BOOST_FOREACH(const uint64_t& cell, sender->second) {
 
-				this->cells_to_receive[sender->first].push_back(
-					#ifdef DCCRG_SEND_SINGLE_CELLS
-					std::make_pair(cell, -1)
-					#else
-					cell
-					#endif
-				);
+				this->cells_to_receive[sender->first].push_back(cell);
 			}
 
 			sort(
 				this->cells_to_receive[sender->first].begin(),
 				this->cells_to_receive[sender->first].end()
 			);
-
-			#ifdef DCCRG_SEND_SINGLE_CELLS
-			// sequential tags for messages: 1, 2, ...
-			for (unsigned int i = 0; i < this->cells_to_receive[sender->first].size(); i++) {
-				this->cells_to_receive[sender->first][i].second = i + 1;
-			}
-			#endif
 		}
 	}
 
@@ -3483,7 +5523,7 @@ private:
 		}
 
 		// get the neighbors_of of given cell
-		this->neighbors.at(cell) = this->find_neighbors_of(cell);
+		this->find_neighbors_of(cell, this->neighbors.at(cell));
 		this->neighbors_to.at(cell) = this->find_neighbors_to(cell, this->neighbors.at(cell));
 
 		#ifdef DEBUG
@@ -3566,6 +5606,7 @@ private:
 	*/
 	void update_remote_neighbor_info(void)
 	{
+		Phase_Timer timer(this->get_active_statistics(), "remote_neighbor_info");
 		// TODO this probably can't be optimized without storing neighbor lists also for remote neighbors
 		this->cells_with_remote_neighbors.clear();
 		this->remote_cells_with_local_neighbors.clear();
@@ -3700,18 +5741,13 @@ private:
 			return error_cell;
 		}
 
-		const int refinement_level = this->get_refinement_level(cell);
+		const uint64_t child = this->get_octree_first_child(cell);
 
 		// given cell cannot have children
-		if (refinement_level == this->max_refinement_level) {
+		if (child == error_cell) {
 			return cell;
 		}
 
-		const uint64_t child = this->get_cell_from_indices(
-			this->get_indices(cell),
-			refinement_level + 1
-		);
-
 		if (this->cell_process.count(child) > 0) {
 			return child;
 		} else {
@@ -3727,6 +5763,7 @@ private:
 	*/
 	void induce_refines(void)
 	{
+		Phase_Timer timer(this->get_active_statistics(), "induce_refines");
 		std::vector<uint64_t> new_refines(this->cells_to_refine.begin(), this->cells_to_refine.end());
 		while (all_reduce(this->comm, new_refines.size(), std::plus<uint64_t>()) > 0) {
 
@@ -3920,6 +5957,7 @@ private:
 	*/
 	void override_unrefines(void)
 	{
+		Phase_Timer timer(this->get_active_statistics(), "override_unrefines");
 		/*
 		TODO: make this a function of maximum allowed difference in refinement levels
 			between neighbors. Set a grid initialization time?
@@ -3929,6 +5967,9 @@ private:
 		// unrefines that were not overridden
 		boost::unordered_set<uint64_t> final_unrefines;
 
+		// reused between unrefines
+		std::vector<uint64_t> neighbors;
+
 		// don't unrefine if...
 		BOOST_FOREACH(const uint64_t& unrefined, this->cells_to_unrefine) {
 
@@ -3936,7 +5977,11 @@ private:
 
 			// ...any sibling cannot be
 			const uint64_t parent = this->get_parent(unrefined);
-			const std::vector<uint64_t> siblings = this->get_all_children(parent);
+			boost::array<uint64_t, 8> siblings;
+			if (!this->get_octree_siblings(unrefined, siblings)) {
+				std::cerr << __FILE__ << ":" << __LINE__ << " Got no siblings for cell " << unrefined << std::endl;
+				abort();
+			}
 
 			BOOST_FOREACH(const uint64_t& sibling, siblings) {
 				if (this->cells_to_refine.count(sibling) > 0
@@ -3965,7 +6010,7 @@ private:
 			}
 			#endif
 
-			const std::vector<uint64_t> neighbors = this->find_neighbors_of(parent, 2, true);
+			this->find_neighbors_of(parent, neighbors, 2, true);
 
 			BOOST_FOREACH(const uint64_t& neighbor, neighbors) {
 
@@ -4075,6 +6120,7 @@ private:
 	*/
 	std::vector<uint64_t> execute_refines(void)
 	{
+		Phase_Timer timer(this->get_active_statistics(), "execute_refines");
 		#ifdef DEBUG
 		if (!this->verify_remote_neighbor_info()) {
 			std::cerr << __FILE__ << ":" << __LINE__ << " Remote neighbor info is not consistent" << std::endl;
@@ -4089,16 +6135,20 @@ private:
 
 		std::vector<uint64_t> new_cells;
 
+		if (this->cells_to_refine.size() > 0 || this->cells_to_unrefine.size() > 0) {
+			this->migrated_weight = -1;
+		}
+
 		this->remote_neighbors.clear();
 		this->cells_to_send.clear();
 		this->cells_to_receive.clear();
 		this->refined_cell_data.clear();
 		this->unrefined_cell_data.clear();
-		#ifndef DCCRG_SEND_SINGLE_CELLS
 		#ifndef DCCRG_CELL_DATA_SIZE_FROM_USER
-		this->incoming_data.clear();
-		this->outgoing_data.clear();
-		#endif
+		this->incoming_buffers.clear();
+		this->incoming_chunks.clear();
+		this->outgoing_buffers.clear();
+		this->outgoing_chunks.clear();
 		#endif
 
 		#ifdef DEBUG
@@ -4137,6 +6187,9 @@ private:
 		// a separate neighborhood update function has to be used for cells whose children were removed by unrefining
 		boost::unordered_set<uint64_t> update_neighbors_unrefined;
 
+		// reused between refined and unrefined cells
+		std::vector<uint64_t> found_neighbors;
+
 		// refines
 		BOOST_FOREACH(const uint64_t& refined, this->cells_to_refine) {
 
@@ -4188,7 +6241,11 @@ private:
 			}
 
 			// add children of refined cells into the grid
-			const std::vector<uint64_t> children = this->get_all_children(refined);
+			boost::array<uint64_t, 8> children;
+			if (!this->get_octree_children(refined, children)) {
+				std::cerr << __FILE__ << ":" << __LINE__ << " Got no children for cell " << refined << std::endl;
+				abort();
+			}
 			BOOST_FOREACH(const uint64_t& child, children) {
 				this->cell_process[child] = process_of_refined;
 
@@ -4255,9 +6312,9 @@ private:
 				No need to update local neighbors_to of refined cell, if they are larger
 				they will also be refined and updated.
 				*/
-				const std::vector<uint64_t> neighbors = this->find_neighbors_of(refined, 2, true);
+				this->find_neighbors_of(refined, found_neighbors, 2, true);
 
-				BOOST_FOREACH(const uint64_t& neighbor, neighbors) {
+				BOOST_FOREACH(const uint64_t& neighbor, found_neighbors) {
 					if (neighbor == 0) {
 						continue;
 					}
@@ -4302,7 +6359,11 @@ private:
 
 			parents_of_unrefined.insert(parent_of_unrefined);
 
-			const std::vector<uint64_t> siblings = this->get_all_children(parent_of_unrefined);
+			boost::array<uint64_t, 8> siblings;
+			if (!this->get_octree_children(parent_of_unrefined, siblings)) {
+				std::cerr << __FILE__ << ":" << __LINE__ << " Got no children for cell " << parent_of_unrefined << std::endl;
+				abort();
+			}
 
 			#ifdef DEBUG
 			bool unrefined_in_siblings = false;
@@ -4399,15 +6460,7 @@ private:
 			}
 		}
 
-		this->start_user_data_transfers(
-		#ifdef DCCRG_SEND_SINGLE_CELLS
-		this->unrefined_cell_data
-		#else
-		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
-		this->unrefined_cell_data
-		#endif
-		#endif
-		);
+		this->start_user_data_transfers(this->unrefined_cell_data, this->get_migration_policy());
 
 		// update data for parents (and their neighborhood) of unrefined cells
 		BOOST_FOREACH(const uint64_t& parent, parents_of_unrefined) {
@@ -4434,8 +6487,8 @@ private:
 			}
 			#endif
 
-			const std::vector<uint64_t> new_neighbors_of = this->find_neighbors_of(parent);
-			BOOST_FOREACH(const uint64_t& neighbor, new_neighbors_of) {
+			this->find_neighbors_of(parent, found_neighbors);
+			BOOST_FOREACH(const uint64_t& neighbor, found_neighbors) {
 
 				if (neighbor == 0) {
 					continue;
@@ -4456,7 +6509,7 @@ private:
 			// add user data and neighbor lists of local parents of unrefined cells
 			if (this->cell_process.at(parent) == this->comm.rank()) {
 				this->cells[parent];
-				this->neighbors[parent] = new_neighbors_of;
+				this->neighbors[parent] = found_neighbors;
 				this->neighbors_to[parent] = new_neighbors_to;
 			}
 		}
@@ -4509,13 +6562,7 @@ private:
 		}
 		#endif
 
-		this->wait_user_data_transfer_receives(
-		#ifndef DCCRG_SEND_SINGLE_CELLS
-		#ifndef DCCRG_CELL_DATA_SIZE_FROM_USER
-		this->unrefined_cell_data
-		#endif
-		#endif
-		);
+		this->wait_user_data_transfer_receives(this->unrefined_cell_data);
 		this->wait_user_data_transfer_sends();
 		this->cells_to_send.clear();
 		this->cells_to_receive.clear();
@@ -4536,69 +6583,359 @@ private:
 		this->cells_to_unrefine.clear();
 
 		this->recalculate_neighbor_update_send_receive_lists();
+		this->update_cell_lists();
 
 		return new_cells;
 	}
 
 
 	/*!
-	Starts user data transfers between processes based on cells_to_send and cells_to_receive.
+	Returns the policy to use for a neighbor data update with given requested policy.
 
-	User data arriving to this process is saved in given destination.
+	Handles the timing of policies for AUTOMATIC_TRANSFER.
 	*/
-	void start_user_data_transfers(
-	#ifdef DCCRG_SEND_SINGLE_CELLS
-	boost::unordered_map<uint64_t, UserData>& destination
-	#else
-	#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
-	boost::unordered_map<uint64_t, UserData>& destination
-	#endif
-	#endif
-	)
+	transfer_policy_t get_neighbor_update_policy(const transfer_policy_t policy)
 	{
-		#ifdef DCCRG_SEND_SINGLE_CELLS
+		this->tuning_current_update = false;
 
-		// post all receives, messages are unique between different senders so just iterate over processes in random order
-		for (boost::unordered_map<int, std::vector<std::pair<uint64_t, int> > >::const_iterator
-			sender = this->cells_to_receive.begin();
-			sender != this->cells_to_receive.end();
-			sender++
-		) {
-			#ifdef DEBUG
-			if (sender->first == this->comm.rank()
-			&& sender->second.size() > 0) {
-				std::cerr << __FILE__ << ":" << __LINE__
-					<< " Process " << this->comm.rank()
-					<< " trying to transfer to self"
-					<< std::endl;
-				abort();
-			}
-			#endif
+		if (policy != AUTOMATIC_TRANSFER) {
+			return this->resolve_transfer_policy(policy, true);
+		}
 
-			for (std::vector<std::pair<uint64_t, int> >::const_iterator
-				item = sender->second.begin();
-				item != sender->second.end();
-				item++
-			) {
-				#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
-				this->receive_requests[sender->first].push_back(MPI_Request());
+		if (this->tuned_policies.size() == 0) {
+			this->tuned_policies = this->get_transfer_policies();
+			this->tuned_times.clear();
+			this->tuned_times.resize(this->tuned_policies.size(), 0);
+			this->tuning_updates = 0;
+		}
 
-				#ifdef DCCRG_USER_MPI_DATA_TYPE
-				MPI_Datatype user_datatype = destination[item->first].mpi_datatype();
-				MPI_Type_commit(&user_datatype);
-				#endif
+		const unsigned int total_tuning_updates = this->tuned_policies.size() * DCCRG_TRANSFER_TUNING_UPDATES;
 
-				MPI_Irecv(
-					destination[item->first].at(),
-					#ifdef DCCRG_USER_MPI_DATA_TYPE
-					1,
-					user_datatype,
-					#else
-					UserData::size(),
-					MPI_BYTE,
-					#endif
-					sender->first,
-					item->second,
+		// alternate between policies so that all are timed under similar conditions
+		if (this->tuning_updates < total_tuning_updates) {
+			this->tuning_current_update = true;
+			return this->tuned_policies[this->tuning_updates % this->tuned_policies.size()];
+		}
+
+		if (this->tuning_updates == total_tuning_updates) {
+			// the slowest process decides how fast a policy is
+			std::vector<double> max_times(this->tuned_times.size(), 0);
+			MPI_Allreduce(
+				&(this->tuned_times[0]),
+				&(max_times[0]),
+				max_times.size(),
+				MPI_DOUBLE,
+				MPI_MAX,
+				this->comm
+			);
+
+			size_t fastest = 0;
+			for (size_t i = 1; i < max_times.size(); i++) {
+				if (max_times[i] < max_times[fastest]) {
+					fastest = i;
+				}
+			}
+			this->tuned_policy = this->tuned_policies[fastest];
+			this->tuning_updates++;
+		}
+
+		return this->tuned_policy;
+	}
+
+
+	/*!
+	Returns the policy to use when moving user data of cells between processes outside of neighbor data updates.
+	*/
+	transfer_policy_t get_migration_policy(void) const
+	{
+		if (this->transfer_policy != AUTOMATIC_TRANSFER) {
+			return this->resolve_transfer_policy(this->transfer_policy, false);
+		}
+
+		if (this->tuned_policies.size() > 0
+		&& this->tuning_updates > this->tuned_policies.size() * DCCRG_TRANSFER_TUNING_UPDATES) {
+			return this->resolve_transfer_policy(this->tuned_policy, false);
+		}
+
+		return this->resolve_transfer_policy(DATATYPE_TRANSFER, false);
+	}
+
+
+	/*!
+	Returns the policy that is used for transfers with given policy, see get_transfer_policies().
+
+	neighbor_update tells whether the transfer is a neighbor data update.
+	Given policy must not be AUTOMATIC_TRANSFER.
+	*/
+	transfer_policy_t resolve_transfer_policy(const transfer_policy_t policy, const bool neighbor_update) const
+	{
+		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		switch (policy) {
+		case SHARED_MEMORY_TRANSFER:
+			#ifdef DCCRG_SHARED_MEMORY_TRANSFER_AVAILABLE
+			if (neighbor_update) {
+				return SHARED_MEMORY_TRANSFER;
+			}
+			#endif
+			// fall through
+		case SERIALIZED_TRANSFER:
+		case PACKED_TRANSFER:
+			#ifdef DCCRG_USER_MPI_DATA_TYPE
+			return DATATYPE_TRANSFER;
+			#else
+			return PACKED_TRANSFER;
+			#endif
+		case NEIGHBORHOOD_TRANSFER:
+			#if MPI_VERSION >= 3
+			if (neighbor_update) {
+				return NEIGHBORHOOD_TRANSFER;
+			}
+			#endif
+			return DATATYPE_TRANSFER;
+		case SINGLE_CELL_TRANSFER:
+			return SINGLE_CELL_TRANSFER;
+		default:
+			return DATATYPE_TRANSFER;
+		}
+
+		#else	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		// neighborhood collectives require an MPI datatype in this mode
+		(void) neighbor_update;
+
+		switch (policy) {
+		case SINGLE_CELL_TRANSFER:
+			return SINGLE_CELL_TRANSFER;
+		case DATATYPE_TRANSFER:
+		case NEIGHBORHOOD_TRANSFER:
+			if (boost::mpi::is_mpi_datatype<UserData>::value) {
+				return DATATYPE_TRANSFER;
+			}
+			return SERIALIZED_TRANSFER;
+		default:
+			return SERIALIZED_TRANSFER;
+		}
+
+		#endif	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+	}
+
+
+	/*!
+	Starts user data transfers between processes based on cells_to_send and cells_to_receive.
+
+	User data arriving to this process is saved in given destination.
+	Given policy must have been resolved with resolve_transfer_policy().
+	*/
+	void start_user_data_transfers(
+		boost::unordered_map<uint64_t, UserData>& destination,
+		const transfer_policy_t policy
+	) {
+		#ifdef DEBUG
+		if (policy != this->resolve_transfer_policy(policy, true)) {
+			std::cerr << __FILE__ << ":" << __LINE__
+				<< " Transfer policy " << policy
+				<< " isn't available"
+				<< std::endl;
+			abort();
+		}
+		#endif
+
+		this->active_transfer_policy = policy;
+
+		const double start_time = (this->trace_file != NULL) ? MPI_Wtime() : 0;
+
+		#ifdef DCCRG_VARIABLE_CELL_DATA_SIZE
+		this->exchange_cell_data_sizes(destination);
+		#endif
+
+		switch (policy) {
+		case SINGLE_CELL_TRANSFER:
+			this->start_single_cell_transfers(destination);
+			break;
+
+		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		#ifndef DCCRG_USER_MPI_DATA_TYPE
+		case PACKED_TRANSFER:
+			this->start_packed_transfers(destination);
+			break;
+		#endif
+
+		#if MPI_VERSION >= 3
+		case NEIGHBORHOOD_TRANSFER:
+			this->start_neighborhood_transfers(destination);
+			break;
+		#endif
+
+		#ifdef DCCRG_SHARED_MEMORY_TRANSFER_AVAILABLE
+		case SHARED_MEMORY_TRANSFER:
+			this->start_shared_memory_transfers(destination);
+			break;
+		#endif
+
+		default:
+			this->start_datatype_transfers(destination);
+			break;
+
+		#else	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		case SERIALIZED_TRANSFER:
+			this->start_serialized_transfers(destination, boost::mpl::false_());
+			break;
+
+		default:
+			this->start_serialized_transfers(destination, boost::mpi::is_mpi_datatype<UserData>());
+			break;
+
+		#endif	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+		}
+
+		if (this->collect_statistics) {
+			this->count_transferred_data(destination, policy, this->statistics.peers);
+		}
+
+		if (this->trace_file != NULL) {
+			this->trace_record = Trace_Record();
+			if (&destination == &(this->remote_neighbors)) {
+				this->trace_record.kind = Trace_Record::NEIGHBOR_UPDATE;
+			} else if (&destination == &(this->cells)) {
+				this->trace_record.kind = Trace_Record::MIGRATION;
+			} else {
+				this->trace_record.kind = Trace_Record::REFINEMENT;
+			}
+			this->trace_record.policy = policy;
+			this->trace_record.start_time = start_time - this->trace_start_time;
+			this->count_transferred_data(destination, policy, this->trace_record.peers);
+		}
+	}
+
+
+	/*!
+	Returns statistics to which phases are added or NULL if statistics aren't collected.
+	*/
+	Statistics* get_active_statistics(void)
+	{
+		return this->collect_statistics ? &(this->statistics) : NULL;
+	}
+
+
+	/*!
+	Adds the messages and bytes of user data transfers started with given policy to given peers.
+
+	Bytes are the sizes of cells' user data given by get_data_bytes() so with
+	boost serialization they don't include the overhead of serialization.
+	A neighborhood collective counts as one message per process.
+	*/
+	void count_transferred_data(
+		boost::unordered_map<uint64_t, UserData>& destination,
+		const transfer_policy_t policy,
+		std::map<int, Peer_Statistics>& peers
+	) {
+		for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			receiver = this->cells_to_send.begin();
+			receiver != this->cells_to_send.end();
+			receiver++
+		) {
+			if (receiver->second.size() == 0) {
+				continue;
+			}
+
+			Peer_Statistics& peer = peers[receiver->first];
+
+			if (this->send_requests.count(receiver->first) > 0) {
+				peer.sent_messages += this->send_requests.at(receiver->first).size();
+			} else if (policy == NEIGHBORHOOD_TRANSFER) {
+				peer.sent_messages++;
+			}
+
+			BOOST_FOREACH(const uint64_t& cell, receiver->second) {
+				peer.sent_bytes += this->get_data_bytes(this->cells.at(cell));
+			}
+		}
+
+		for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			sender = this->cells_to_receive.begin();
+			sender != this->cells_to_receive.end();
+			sender++
+		) {
+			if (sender->second.size() == 0) {
+				continue;
+			}
+
+			Peer_Statistics& peer = peers[sender->first];
+
+			if (sender->first != this->comm.rank()
+			&& this->receive_requests.count(sender->first) > 0) {
+				peer.received_messages += this->receive_requests.at(sender->first).size();
+			} else if (policy == NEIGHBORHOOD_TRANSFER) {
+				peer.received_messages++;
+			}
+
+			BOOST_FOREACH(const uint64_t& cell, sender->second) {
+				peer.received_bytes += this->get_data_bytes(destination[cell]);
+			}
+		}
+	}
+
+
+	/*!
+	Starts user data transfers using one message per cell.
+
+	The tag of each message is the position of the cell in the sorted send / receive list + 1.
+	Cells transferred between two processes are coalesced if there are too many of them,
+	see get_cells_per_message().
+	*/
+	void start_single_cell_transfers(boost::unordered_map<uint64_t, UserData>& destination)
+	{
+		// post all receives, messages are unique between different senders so just iterate over processes in random order
+		for (boost::unordered_map<int, std::vector<uint64_t> >::iterator
+			sender = this->cells_to_receive.begin();
+			sender != this->cells_to_receive.end();
+			sender++
+		) {
+			#ifdef DEBUG
+			if (sender->first == this->comm.rank()
+			&& sender->second.size() > 0) {
+				std::cerr << __FILE__ << ":" << __LINE__
+					<< " Process " << this->comm.rank()
+					<< " trying to transfer to self"
+					<< std::endl;
+				abort();
+			}
+			#endif
+
+			std::sort(sender->second.begin(), sender->second.end());
+
+			const uint64_t cells_per_message = this->get_cells_per_message(sender->second.size());
+			if (cells_per_message > 1) {
+				this->start_coalesced_receives(sender->first, cells_per_message, destination);
+				continue;
+			}
+
+			for (size_t i = 0; i < sender->second.size(); i++) {
+				const uint64_t cell = sender->second[i];
+				const int tag = int(i + 1);
+
+				#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+				this->receive_requests[sender->first].push_back(MPI_Request());
+
+				#ifdef DCCRG_USER_MPI_DATA_TYPE
+				MPI_Datatype user_datatype = destination[cell].mpi_datatype();
+				MPI_Type_commit(&user_datatype);
+				#endif
+
+				MPI_Irecv(
+					destination[cell].at(),
+					#ifdef DCCRG_USER_MPI_DATA_TYPE
+					1,
+					user_datatype,
+					#else
+					destination[cell].size(),
+					MPI_BYTE,
+					#endif
+					sender->first,
+					tag,
 					this->comm,
 					&(this->receive_requests[sender->first].back())
 				);
@@ -4612,8 +6949,8 @@ private:
 				this->receive_requests[sender->first].push_back(
 					this->comm.irecv(
 						sender->first,
-						item->second,
-						destination[item->first]
+						tag,
+						destination[cell]
 					)
 				);
 				#endif
@@ -4621,7 +6958,7 @@ private:
 		}
 
 		// post all sends
-		for (boost::unordered_map<int, std::vector<std::pair<uint64_t, int> > >::const_iterator
+		for (boost::unordered_map<int, std::vector<uint64_t> >::iterator
 			receiver = this->cells_to_send.begin();
 			receiver != this->cells_to_send.end();
 			receiver++
@@ -4634,31 +6971,38 @@ private:
 			}
 			#endif
 
-			for (std::vector<std::pair<uint64_t, int> >::const_iterator
-				item = receiver->second.begin();
-				item != receiver->second.end();
-				item++
-			) {
+			std::sort(receiver->second.begin(), receiver->second.end());
+
+			const uint64_t cells_per_message = this->get_cells_per_message(receiver->second.size());
+			if (cells_per_message > 1) {
+				this->start_coalesced_sends(receiver->first, cells_per_message);
+				continue;
+			}
+
+			for (size_t i = 0; i < receiver->second.size(); i++) {
+				const uint64_t cell = receiver->second[i];
+				const int tag = int(i + 1);
+
 				#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
 				this->send_requests[receiver->first].push_back(MPI_Request());
 
 				#ifdef DCCRG_USER_MPI_DATA_TYPE
-				MPI_Datatype user_datatype = this->cells.at(item->first).mpi_datatype();
+				MPI_Datatype user_datatype = this->cells.at(cell).mpi_datatype();
 				MPI_Type_commit(&user_datatype);
 				#endif
 
 				// FIXME: check the return value
 				MPI_Isend(
-					this->cells.at(item->first).at(),
+					this->cells.at(cell).at(),
 					#ifdef DCCRG_USER_MPI_DATA_TYPE
 					1,
 					user_datatype,
 					#else
-					UserData::size(),
+					this->cells.at(cell).size(),
 					MPI_BYTE,
 					#endif
 					receiver->first,
-					item->second,
+					tag,
 					this->comm,
 					&(this->send_requests[receiver->first].back())
 				);
@@ -4669,154 +7013,1137 @@ private:
 
 				#else
 
-				this->send_requests[receiver->first].push_back(
-					this->comm.isend(
-						receiver->first,
-						item->second,
-						this->cells.at(item->first)
-					)
-				);
-				#endif
-			}
+				this->send_requests[receiver->first].push_back(
+					this->comm.isend(
+						receiver->first,
+						tag,
+						this->cells.at(cell)
+					)
+				);
+				#endif
+			}
+		}
+	}
+
+
+	/*!
+	Starts receiving the data of cells from given process in messages of given number of cells.
+
+	Message tags are 1, 2, ...
+	*/
+	void start_coalesced_receives(
+		const int sender,
+		const uint64_t cells_per_message,
+		boost::unordered_map<uint64_t, UserData>& destination
+	) {
+		const std::vector<uint64_t>& receive_cells = this->cells_to_receive.at(sender);
+
+		// reserve space for incoming user data at our end
+		BOOST_FOREACH(const uint64_t& cell, receive_cells) {
+			destination[cell];
+		}
+
+		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		int tag = 1;
+		for (uint64_t first = 0; first < receive_cells.size(); first += cells_per_message, tag++) {
+			const uint64_t last = std::min(first + cells_per_message, uint64_t(receive_cells.size()));
+			const std::vector<uint64_t> message_cells(receive_cells.begin() + first, receive_cells.begin() + last);
+
+			MPI_Datatype receive_datatype = this->get_datatype(destination, message_cells);
+
+			this->receive_requests[sender].push_back(MPI_Request());
+
+			MPI_Irecv(
+				MPI_BOTTOM,
+				1,
+				receive_datatype,
+				sender,
+				tag,
+				this->comm,
+				&(this->receive_requests[sender].back())
+			);
+
+			MPI_Type_free(&receive_datatype);
+		}
+
+		#else	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		// copied into destination by incorporate_received_data()
+		std::vector<std::vector<UserData> >& chunks = this->incoming_chunks[sender];
+		chunks.clear();
+		chunks.resize((receive_cells.size() + cells_per_message - 1) / cells_per_message);
+
+		for (size_t i = 0; i < chunks.size(); i++) {
+			this->receive_requests[sender].push_back(
+				this->comm.irecv(sender, int(i + 1), chunks[i])
+			);
+		}
+
+		#endif	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+	}
+
+
+	/*!
+	Starts sending the data of cells to given process in messages of given number of cells.
+
+	Message tags are 1, 2, ...
+	*/
+	void start_coalesced_sends(const int receiver, const uint64_t cells_per_message)
+	{
+		const std::vector<uint64_t>& send_cells = this->cells_to_send.at(receiver);
+
+		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		int tag = 1;
+		for (uint64_t first = 0; first < send_cells.size(); first += cells_per_message, tag++) {
+			const uint64_t last = std::min(first + cells_per_message, uint64_t(send_cells.size()));
+			const std::vector<uint64_t> message_cells(send_cells.begin() + first, send_cells.begin() + last);
+
+			MPI_Datatype send_datatype = this->get_datatype(this->cells, message_cells);
+
+			this->send_requests[receiver].push_back(MPI_Request());
+
+			MPI_Isend(
+				MPI_BOTTOM,
+				1,
+				send_datatype,
+				receiver,
+				tag,
+				this->comm,
+				&(this->send_requests[receiver].back())
+			);
+
+			MPI_Type_free(&send_datatype);
+		}
+
+		#else	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+		// boost::mpi doesn't necessarily copy the data before it has been sent
+		std::vector<std::vector<UserData> >& chunks = this->outgoing_chunks[receiver];
+		chunks.clear();
+		chunks.resize((send_cells.size() + cells_per_message - 1) / cells_per_message);
+
+		for (size_t i = 0; i < chunks.size(); i++) {
+			const uint64_t
+				first = i * cells_per_message,
+				last = std::min(first + cells_per_message, uint64_t(send_cells.size()));
+
+			chunks[i].reserve(last - first);
+			for (uint64_t j = first; j < last; j++) {
+				chunks[i].push_back(this->cells.at(send_cells[j]));
+			}
+
+			this->send_requests[receiver].push_back(
+				this->comm.isend(receiver, int(i + 1), chunks[i])
+			);
+		}
+
+		#endif	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+	}
+
+
+	/*!
+	Returns the number of cells that SINGLE_CELL_TRANSFER sends in one message
+	between two processes that transfer given number of cells.
+	*/
+	uint64_t get_cells_per_message(const uint64_t number_of_cells) const
+	{
+		const uint64_t max_messages = std::min(this->max_single_cell_messages, uint64_t(this->max_tag));
+
+		if (number_of_cells <= max_messages) {
+			return 1;
+		}
+
+		// the number of messages must not exceed the largest tag
+		return std::max(
+			this->cells_per_coalesced_message,
+			(number_of_cells + this->max_tag - 1) / this->max_tag
+		);
+	}
+
+
+	/*!
+	Returns given send or receive lists with the tag used by SINGLE_CELL_TRANSFER for each cell.
+	*/
+	boost::unordered_map<int, std::vector<std::pair<uint64_t, int> > > get_tagged_lists(
+		boost::unordered_map<int, std::vector<uint64_t> >& lists
+	) const {
+		boost::unordered_map<int, std::vector<std::pair<uint64_t, int> > > tagged_lists;
+
+		for (boost::unordered_map<int, std::vector<uint64_t> >::iterator
+			process = lists.begin();
+			process != lists.end();
+			process++
+		) {
+			std::sort(process->second.begin(), process->second.end());
+
+			const uint64_t cells_per_message = this->get_cells_per_message(process->second.size());
+
+			std::vector<std::pair<uint64_t, int> >& tagged_list = tagged_lists[process->first];
+			tagged_list.reserve(process->second.size());
+			for (uint64_t i = 0; i < process->second.size(); i++) {
+				tagged_list.push_back(std::make_pair(process->second[i], int(i / cells_per_message + 1)));
+			}
+		}
+
+		return tagged_lists;
+	}
+
+
+	/*!
+	Returns the tag of messages sent by one process to another when they transfer at most one message.
+
+	MPI matches messages by their sender so tags don't have to be unique between processes.
+	*/
+	int get_process_pair_tag(const int sender, const int receiver) const
+	{
+		return int((uint64_t(sender) * this->comm.size() + receiver) % (uint64_t(this->max_tag) + 1));
+	}
+
+
+	/*!
+	Returns true if user data of the transfer in progress goes to / comes from given process through shared memory.
+	*/
+	bool transfers_through_shared_memory(const int process) const
+	{
+		#ifdef DCCRG_SHARED_MEMORY_TRANSFER_AVAILABLE
+		return this->active_transfer_policy == SHARED_MEMORY_TRANSFER
+			&& process != this->comm.rank()
+			&& this->node_ranks.size() > 0
+			&& this->node_ranks[process] >= 0;
+		#else
+		(void) process;
+		return false;
+		#endif
+	}
+
+
+	#ifdef DCCRG_VARIABLE_CELL_DATA_SIZE
+	/*!
+	Resizes the data of cells received into given destination to the size of their data on the sending process.
+
+	Sizes are sent only if they changed since the previous transfer between two processes,
+	otherwise an empty message tells the receiver to use the sizes it received last time.
+	Must be called before posting user data transfers.
+	*/
+	void exchange_cell_data_sizes(boost::unordered_map<uint64_t, UserData>& destination)
+	{
+		std::vector<MPI_Request> requests;
+		std::vector<int> senders;
+		boost::unordered_map<int, std::vector<uint64_t> > incoming_sizes;
+
+		// post all receives
+		for (boost::unordered_map<int, std::vector<uint64_t> >::iterator
+			sender = this->cells_to_receive.begin();
+			sender != this->cells_to_receive.end();
+			sender++
+		) {
+			if (sender->first == this->comm.rank()
+			|| sender->second.size() == 0) {
+				continue;
+			}
+
+			std::sort(sender->second.begin(), sender->second.end());
+
+			std::vector<uint64_t>& sizes = incoming_sizes[sender->first];
+			sizes.resize(sender->second.size());
+
+			senders.push_back(sender->first);
+			requests.push_back(MPI_Request());
+
+			MPI_Irecv(
+				&(sizes[0]),
+				sizes.size(),
+				MPI_UINT64_T,
+				sender->first,
+				this->get_process_pair_tag(sender->first, this->comm.rank()),
+				this->comm,
+				&(requests.back())
+			);
+		}
+
+		// send sizes that changed
+		for (boost::unordered_map<int, std::vector<uint64_t> >::iterator
+			receiver = this->cells_to_send.begin();
+			receiver != this->cells_to_send.end();
+			receiver++
+		) {
+			if (receiver->first == this->comm.rank()
+			|| receiver->second.size() == 0) {
+				continue;
+			}
+
+			std::sort(receiver->second.begin(), receiver->second.end());
+
+			std::vector<uint64_t> sizes(receiver->second.size(), 0);
+			for (uint64_t i = 0; i < receiver->second.size(); i++) {
+				sizes[i] = this->cells.at(receiver->second[i]).size();
+			}
+
+			std::vector<uint64_t>& sent_sizes = this->sent_data_sizes[receiver->first];
+			const bool changed = (sizes != sent_sizes);
+			if (changed) {
+				sent_sizes.swap(sizes);
+			}
+
+			requests.push_back(MPI_Request());
+
+			MPI_Isend(
+				&(sent_sizes[0]),
+				changed ? sent_sizes.size() : 0,
+				MPI_UINT64_T,
+				receiver->first,
+				this->get_process_pair_tag(this->comm.rank(), receiver->first),
+				this->comm,
+				&(requests.back())
+			);
+		}
+
+		if (requests.size() == 0) {
+			return;
+		}
+
+		std::vector<MPI_Status> statuses(requests.size());
+		{
+			Phase_Timer timer(this->get_active_statistics(), "user_data_wait");
+			MPI_Waitall(requests.size(), &(requests[0]), &(statuses[0]));
+		}
+
+		for (uint64_t i = 0; i < senders.size(); i++) {
+			const int sender = senders[i];
+			const std::vector<uint64_t>& receive_cells = this->cells_to_receive.at(sender);
+
+			int received_items = 0;
+			MPI_Get_count(&(statuses[i]), MPI_UINT64_T, &received_items);
+
+			std::vector<uint64_t>& received_sizes = this->received_data_sizes[sender];
+			if (received_items > 0) {
+				received_sizes.swap(incoming_sizes.at(sender));
+			}
+
+			#ifdef DEBUG
+			if (received_sizes.size() != receive_cells.size()) {
+				std::cerr << __FILE__ << ":" << __LINE__
+					<< " Process " << this->comm.rank()
+					<< " has sizes of " << received_sizes.size()
+					<< " cells from process " << sender
+					<< " instead of " << receive_cells.size()
+					<< std::endl;
+				abort();
+			}
+			#endif
+
+			for (uint64_t j = 0; j < receive_cells.size(); j++) {
+				destination[receive_cells[j]].resize(received_sizes[j]);
+			}
+		}
+	}
+	#endif
+
+
+	#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+	/*!
+	Starts user data transfers using one MPI datatype per process.
+	*/
+	void start_datatype_transfers(boost::unordered_map<uint64_t, UserData>& destination)
+	{
+		// receive one MPI datatype per process
+		for (boost::unordered_map<int, std::vector<uint64_t> >::iterator
+			sender = this->cells_to_receive.begin();
+			sender != this->cells_to_receive.end();
+			sender++
+		) {
+			if (sender->second.size() == 0) {
+				continue;
+			}
+
+			std::sort(sender->second.begin(), sender->second.end());
+
+			// reserve space for incoming user data at our end
+			for (uint64_t i = 0; i < sender->second.size(); i++) {
+				destination[sender->second[i]];
+			}
+
+			MPI_Datatype receive_datatype = this->get_datatype(destination, sender->second);
+
+			const int receive_tag = this->get_process_pair_tag(sender->first, this->comm.rank());
+
+			this->receive_requests[sender->first].push_back(MPI_Request());
+
+			MPI_Irecv(
+				MPI_BOTTOM,
+				1,
+				receive_datatype,
+				sender->first,
+				receive_tag,
+				this->comm,
+				&(this->receive_requests[sender->first].back())
+			);
+
+			MPI_Type_free(&receive_datatype);
+		}
+
+		// send one MPI datatype per process
+		for (boost::unordered_map<int, std::vector<uint64_t> >::iterator
+			receiver = this->cells_to_send.begin();
+			receiver != this->cells_to_send.end();
+			receiver++
+		) {
+			if (receiver->second.size() == 0) {
+				continue;
+			}
+
+			std::sort(receiver->second.begin(), receiver->second.end());
+
+			MPI_Datatype send_datatype = this->get_datatype(this->cells, receiver->second);
+
+			const int send_tag = this->get_process_pair_tag(this->comm.rank(), receiver->first);
+
+			this->send_requests[receiver->first].push_back(MPI_Request());
+
+			MPI_Isend(
+				MPI_BOTTOM,
+				1,
+				send_datatype,
+				receiver->first,
+				send_tag,
+				this->comm,
+				&(this->send_requests[receiver->first].back())
+			);
+
+			MPI_Type_free(&send_datatype);
+		}
+	}
+
+
+	/*!
+	Returns a committed MPI datatype describing the data of given cells in given storage.
+
+	Displacements are absolute addresses so the datatype is used with MPI_BOTTOM.
+	*/
+	MPI_Datatype get_datatype(
+		boost::unordered_map<uint64_t, UserData>& storage,
+		const std::vector<uint64_t>& given_cells
+	) const {
+		std::vector<MPI_Aint> displacements(given_cells.size(), 0);
+		for (uint64_t i = 0; i < given_cells.size(); i++) {
+			MPI_Get_address(storage.at(given_cells[i]).at(), &(displacements[i]));
+		}
+
+		MPI_Datatype datatype;
+
+		#ifdef DCCRG_USER_MPI_DATA_TYPE
+		std::vector<int> block_lengths(displacements.size(), 1);
+		std::vector<MPI_Datatype> datatypes(displacements.size());
+		for (uint64_t i = 0; i < given_cells.size(); i++) {
+			datatypes[i] = storage.at(given_cells[i]).mpi_datatype();
+		}
+
+		MPI_Type_create_struct(
+			displacements.size(),
+			&block_lengths[0],
+			&displacements[0],
+			&datatypes[0],
+			&datatype
+		);
+		#else
+		std::vector<int> block_lengths(displacements.size());
+		for (uint64_t i = 0; i < given_cells.size(); i++) {
+			block_lengths[i] = storage.at(given_cells[i]).size();
+		}
+
+		MPI_Type_create_hindexed(
+			displacements.size(),
+			&block_lengths[0],
+			&displacements[0],
+			MPI_BYTE,
+			&datatype
+		);
+		#endif
+
+		MPI_Type_commit(&datatype);
+
+		return datatype;
+	}
+
+
+	#ifndef DCCRG_USER_MPI_DATA_TYPE
+	/*!
+	Starts user data transfers using one contiguous buffer per process.
+
+	Outgoing user data is copied into the buffers before sending, incoming
+	data is copied into given destination by incorporate_received_data().
+	*/
+	void start_packed_transfers(boost::unordered_map<uint64_t, UserData>& destination)
+	{
+		std::vector<uint64_t> offsets;
+
+		// post all receives
+		for (int sender = 0; sender < this->comm.size(); sender++) {
+
+			if (sender == this->comm.rank()
+			|| this->transfers_through_shared_memory(sender)) {
+				continue;
+			}
+
+			if (this->cells_to_receive.count(sender) == 0
+			|| this->cells_to_receive.at(sender).size() == 0) {
+				// no data to send / receive
+				continue;
+			}
+
+			std::sort(this->cells_to_receive.at(sender).begin(), this->cells_to_receive.at(sender).end());
+
+			// reserve space for incoming user data at our end
+			BOOST_FOREACH(const uint64_t& cell, this->cells_to_receive.at(sender)) {
+				destination[cell];
+			}
+
+			std::vector<uint8_t>& buffer = this->incoming_buffers[sender];
+			buffer.resize(this->get_data_offsets(destination, this->cells_to_receive.at(sender), offsets));
+
+			const int receive_tag = this->get_process_pair_tag(sender, this->comm.rank());
+
+			this->receive_requests[sender].push_back(MPI_Request());
+
+			MPI_Irecv(
+				&(buffer[0]),
+				buffer.size(),
+				MPI_BYTE,
+				sender,
+				receive_tag,
+				this->comm,
+				&(this->receive_requests[sender].back())
+			);
+		}
+
+		// pack and send all data
+		for (int receiver = 0; receiver < this->comm.size(); receiver++) {
+
+			if (receiver == this->comm.rank()
+			|| this->transfers_through_shared_memory(receiver)) {
+				continue;
+			}
+
+			if (this->cells_to_send.count(receiver) == 0
+			|| this->cells_to_send.at(receiver).size() == 0) {
+				// no data to send / receive
+				continue;
+			}
+
+			std::vector<uint64_t>& send_cells = this->cells_to_send.at(receiver);
+			std::sort(send_cells.begin(), send_cells.end());
+
+			std::vector<uint8_t>& buffer = this->outgoing_buffers[receiver];
+			buffer.resize(this->get_data_offsets(this->cells, send_cells, offsets));
+
+			const int number_of_cells = int(send_cells.size());
+			#ifdef _OPENMP
+			#pragma omp parallel for
+			#endif
+			for (int i = 0; i < number_of_cells; i++) {
+				std::memcpy(
+					&(buffer[offsets[i]]),
+					this->cells.at(send_cells[i]).at(),
+					offsets[i + 1] - offsets[i]
+				);
+			}
+
+			const int send_tag = this->get_process_pair_tag(this->comm.rank(), receiver);
+
+			this->send_requests[receiver].push_back(MPI_Request());
+
+			MPI_Isend(
+				&(buffer[0]),
+				buffer.size(),
+				MPI_BYTE,
+				receiver,
+				send_tag,
+				this->comm,
+				&(this->send_requests[receiver].back())
+			);
+		}
+	}
+
+
+	/*!
+	Sets given offsets to the starting positions of the data of given cells in a packed buffer.
+
+	Offsets have one item more than given cells, the last one being the total size of data
+	in bytes which is also returned.
+	*/
+	uint64_t get_data_offsets(
+		const boost::unordered_map<uint64_t, UserData>& storage,
+		const std::vector<uint64_t>& given_cells,
+		std::vector<uint64_t>& offsets
+	) const {
+		offsets.resize(given_cells.size() + 1);
+		offsets[0] = 0;
+		for (uint64_t i = 0; i < given_cells.size(); i++) {
+			offsets[i + 1] = offsets[i] + storage.at(given_cells[i]).size();
+		}
+
+		return offsets.back();
+	}
+	#endif	// ifndef DCCRG_USER_MPI_DATA_TYPE
+
+
+	#if MPI_VERSION >= 3
+	/*!
+	Starts user data transfers with all processes using one nonblocking neighborhood collective.
+
+	The only request is stored in receive_requests under this process.
+	*/
+	void start_neighborhood_transfers(boost::unordered_map<uint64_t, UserData>& destination)
+	{
+		this->update_neighborhood_comm();
+
+		// arguments must stay valid until the collective completes, see wait_user_data_transfer_sends()
+		this->neighborhood_receive_datatypes.clear();
+		this->neighborhood_send_datatypes.clear();
+
+		BOOST_FOREACH(const int& sender, this->neighborhood_sources) {
+			std::vector<uint64_t>& receive_cells = this->cells_to_receive.at(sender);
+			std::sort(receive_cells.begin(), receive_cells.end());
+
+			// reserve space for incoming user data at our end
+			BOOST_FOREACH(const uint64_t& cell, receive_cells) {
+				destination[cell];
+			}
+
+			this->neighborhood_receive_datatypes.push_back(this->get_datatype(destination, receive_cells));
+		}
+
+		BOOST_FOREACH(const int& receiver, this->neighborhood_destinations) {
+			std::vector<uint64_t>& send_cells = this->cells_to_send.at(receiver);
+			std::sort(send_cells.begin(), send_cells.end());
+
+			this->neighborhood_send_datatypes.push_back(this->get_datatype(this->cells, send_cells));
+		}
+
+		// every datatype describes all data to / from a process, last ones are
+		// placeholders for processes without neighbors
+		this->neighborhood_receive_counts.assign(this->neighborhood_receive_datatypes.size() + 1, 1);
+		this->neighborhood_send_counts.assign(this->neighborhood_send_datatypes.size() + 1, 1);
+		this->neighborhood_receive_displacements.assign(this->neighborhood_receive_datatypes.size() + 1, 0);
+		this->neighborhood_send_displacements.assign(this->neighborhood_send_datatypes.size() + 1, 0);
+		this->neighborhood_receive_datatypes.push_back(MPI_DATATYPE_NULL);
+		this->neighborhood_send_datatypes.push_back(MPI_DATATYPE_NULL);
+
+		this->receive_requests[this->comm.rank()].push_back(MPI_Request());
+
+		MPI_Ineighbor_alltoallw(
+			MPI_BOTTOM,
+			&(this->neighborhood_send_counts[0]),
+			&(this->neighborhood_send_displacements[0]),
+			&(this->neighborhood_send_datatypes[0]),
+			MPI_BOTTOM,
+			&(this->neighborhood_receive_counts[0]),
+			&(this->neighborhood_receive_displacements[0]),
+			&(this->neighborhood_receive_datatypes[0]),
+			this->neighborhood_comm,
+			&(this->receive_requests[this->comm.rank()].back())
+		);
+	}
+
+
+	/*!
+	Frees the datatypes of a completed neighborhood collective.
+	*/
+	void free_neighborhood_datatypes(void)
+	{
+		this->neighborhood_receive_datatypes.pop_back();
+		this->neighborhood_send_datatypes.pop_back();
+		BOOST_FOREACH(MPI_Datatype& datatype, this->neighborhood_receive_datatypes) {
+			MPI_Type_free(&datatype);
+		}
+		BOOST_FOREACH(MPI_Datatype& datatype, this->neighborhood_send_datatypes) {
+			MPI_Type_free(&datatype);
+		}
+		this->neighborhood_receive_datatypes.clear();
+		this->neighborhood_send_datatypes.clear();
+	}
+
+
+	/*!
+	Creates the graph communicator of processes exchanging neighbor data if cells have changed since it was created.
+
+	Must be called simultaneously on all processes.
+	*/
+	void update_neighborhood_comm(void)
+	{
+		if (this->neighborhood_comm != MPI_COMM_NULL
+		&& this->neighborhood_comm_version == this->cell_lists_version) {
+			return;
+		}
+
+		if (this->neighborhood_comm != MPI_COMM_NULL) {
+			MPI_Comm_free(&(this->neighborhood_comm));
+		}
+
+		this->neighborhood_sources.clear();
+		for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			sender = this->cells_to_receive.begin();
+			sender != this->cells_to_receive.end();
+			sender++
+		) {
+			if (sender->second.size() > 0) {
+				this->neighborhood_sources.push_back(sender->first);
+			}
+		}
+		std::sort(this->neighborhood_sources.begin(), this->neighborhood_sources.end());
+
+		this->neighborhood_destinations.clear();
+		for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			receiver = this->cells_to_send.begin();
+			receiver != this->cells_to_send.end();
+			receiver++
+		) {
+			if (receiver->second.size() > 0) {
+				this->neighborhood_destinations.push_back(receiver->first);
+			}
+		}
+		std::sort(this->neighborhood_destinations.begin(), this->neighborhood_destinations.end());
+
+		// placeholders keep the pointers valid for processes without neighbors
+		this->neighborhood_sources.push_back(MPI_PROC_NULL);
+		this->neighborhood_destinations.push_back(MPI_PROC_NULL);
+
+		MPI_Dist_graph_create_adjacent(
+			this->comm,
+			this->neighborhood_sources.size() - 1,
+			&(this->neighborhood_sources[0]),
+			MPI_UNWEIGHTED,
+			this->neighborhood_destinations.size() - 1,
+			&(this->neighborhood_destinations[0]),
+			MPI_UNWEIGHTED,
+			MPI_INFO_NULL,
+			0,
+			&(this->neighborhood_comm)
+		);
+
+		this->neighborhood_sources.pop_back();
+		this->neighborhood_destinations.pop_back();
+
+		this->neighborhood_comm_version = this->cell_lists_version;
+	}
+	#endif	// if MPI_VERSION >= 3
+
+
+	#ifdef DCCRG_SHARED_MEMORY_TRANSFER_AVAILABLE
+	/*!
+	Starts user data transfers with processes of other nodes using PACKED_TRANSFER and
+	copies user data from processes of this node directly from their shared memory.
+
+	Every process copies the data of its cells sent to this node once into its half of
+	shared_window given by the number of previous transfers. Using halves alternately needs only
+	one barrier per transfer as no process can start writing into a half before everyone has read
+	the previous data from it.
+	Must be called simultaneously on all processes.
+	*/
+	void start_shared_memory_transfers(boost::unordered_map<uint64_t, UserData>& destination)
+	{
+		this->update_shared_window();
+
+		this->start_packed_transfers(destination);
+
+		const size_t cell_size = UserData::size();
+		const uint64_t half = this->shared_transfers % 2;
+		this->shared_transfers++;
+
+		const int node_rank = this->node_ranks[this->comm.rank()];
+		uint8_t* const own_data = this->shared_bases[node_rank] + half * this->shared_half_sizes[node_rank];
+
+		const int number_of_shared_cells = int(this->shared_cells.size());
+		#ifdef _OPENMP
+		#pragma omp parallel for
+		#endif
+		for (int i = 0; i < number_of_shared_cells; i++) {
+			std::memcpy(own_data + i * cell_size, this->cells.at(this->shared_cells[i]).at(), cell_size);
+		}
+
+		MPI_Win_sync(this->shared_window);
+		MPI_Barrier(this->node_comm);
+		MPI_Win_sync(this->shared_window);
+
+		for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			sender = this->shared_receive_indices.begin();
+			sender != this->shared_receive_indices.end();
+			sender++
+		) {
+			const std::vector<uint64_t>& receive_cells = this->cells_to_receive.at(sender->first);
+
+			// reserve space for incoming user data at our end
+			BOOST_FOREACH(const uint64_t& cell, receive_cells) {
+				destination[cell];
+			}
+
+			const int sender_node_rank = this->node_ranks[sender->first];
+			const uint8_t* const sender_data
+				= this->shared_bases[sender_node_rank]
+				+ half * this->shared_half_sizes[sender_node_rank];
+
+			const int number_of_cells = int(receive_cells.size());
+			#ifdef _OPENMP
+			#pragma omp parallel for
+			#endif
+			for (int i = 0; i < number_of_cells; i++) {
+				std::memcpy(
+					destination.at(receive_cells[i]).at(),
+					sender_data + sender->second[i] * cell_size,
+					cell_size
+				);
+			}
+		}
+	}
+
+
+	/*!
+	Creates shared_window if cells have changed since it was created.
+
+	Must be called simultaneously on all processes.
+	*/
+	void update_shared_window(void)
+	{
+		if (this->node_comm == MPI_COMM_NULL) {
+			MPI_Comm_split_type(this->comm, MPI_COMM_TYPE_SHARED, this->comm.rank(), MPI_INFO_NULL, &(this->node_comm));
+
+			std::vector<int> ranks(this->comm.size());
+			for (int process = 0; process < this->comm.size(); process++) {
+				ranks[process] = process;
+			}
+
+			MPI_Group group, node_group;
+			MPI_Comm_group(this->comm, &group);
+			MPI_Comm_group(this->node_comm, &node_group);
+
+			this->node_ranks.resize(this->comm.size());
+			MPI_Group_translate_ranks(group, this->comm.size(), &(ranks[0]), node_group, &(this->node_ranks[0]));
+
+			BOOST_FOREACH(int& node_rank, this->node_ranks) {
+				if (node_rank == MPI_UNDEFINED) {
+					node_rank = -1;
+				}
+			}
+
+			MPI_Group_free(&group);
+			MPI_Group_free(&node_group);
+		}
+
+		if (this->shared_window != MPI_WIN_NULL
+		&& this->shared_window_version == this->cell_lists_version) {
+			return;
+		}
+
+		this->free_shared_window();
+
+		// every cell sent to this node is stored once
+		this->shared_cells.clear();
+		for (boost::unordered_map<int, std::vector<uint64_t> >::iterator
+			receiver = this->cells_to_send.begin();
+			receiver != this->cells_to_send.end();
+			receiver++
+		) {
+			if (!this->transfers_through_shared_memory(receiver->first)) {
+				continue;
+			}
+
+			std::sort(receiver->second.begin(), receiver->second.end());
+			this->shared_cells.insert(this->shared_cells.end(), receiver->second.begin(), receiver->second.end());
+		}
+		std::sort(this->shared_cells.begin(), this->shared_cells.end());
+		this->shared_cells.erase(
+			std::unique(this->shared_cells.begin(), this->shared_cells.end()),
+			this->shared_cells.end()
+		);
+
+		uint8_t* own_base = NULL;
+		MPI_Win_allocate_shared(
+			2 * this->shared_cells.size() * UserData::size(),
+			1,
+			MPI_INFO_NULL,
+			this->node_comm,
+			&own_base,
+			&(this->shared_window)
+		);
+		MPI_Win_lock_all(MPI_MODE_NOCHECK, this->shared_window);
+
+		int node_size = 0;
+		MPI_Comm_size(this->node_comm, &node_size);
+		this->shared_bases.resize(node_size);
+		this->shared_half_sizes.resize(node_size);
+		for (int node_rank = 0; node_rank < node_size; node_rank++) {
+			MPI_Aint size = 0;
+			int displacement_unit = 0;
+			MPI_Win_shared_query(
+				this->shared_window,
+				node_rank,
+				&size,
+				&displacement_unit,
+				&(this->shared_bases[node_rank])
+			);
+			this->shared_half_sizes[node_rank] = size / 2;
+		}
+
+		// tell processes of this node where their cells are in shared_window
+		std::vector<MPI_Request> requests;
+		boost::unordered_map<int, std::vector<uint64_t> > send_indices;
+
+		this->shared_receive_indices.clear();
+		for (boost::unordered_map<int, std::vector<uint64_t> >::iterator
+			sender = this->cells_to_receive.begin();
+			sender != this->cells_to_receive.end();
+			sender++
+		) {
+			if (!this->transfers_through_shared_memory(sender->first)
+			|| sender->second.size() == 0) {
+				continue;
+			}
+
+			std::sort(sender->second.begin(), sender->second.end());
+
+			std::vector<uint64_t>& indices = this->shared_receive_indices[sender->first];
+			indices.resize(sender->second.size());
+
+			requests.push_back(MPI_Request());
+			MPI_Irecv(
+				&(indices[0]),
+				indices.size(),
+				MPI_UINT64_T,
+				sender->first,
+				this->get_process_pair_tag(sender->first, this->comm.rank()),
+				this->comm,
+				&(requests.back())
+			);
+		}
+
+		for (boost::unordered_map<int, std::vector<uint64_t> >::const_iterator
+			receiver = this->cells_to_send.begin();
+			receiver != this->cells_to_send.end();
+			receiver++
+		) {
+			if (!this->transfers_through_shared_memory(receiver->first)
+			|| receiver->second.size() == 0) {
+				continue;
+			}
+
+			std::vector<uint64_t>& indices = send_indices[receiver->first];
+			indices.reserve(receiver->second.size());
+			BOOST_FOREACH(const uint64_t& cell, receiver->second) {
+				indices.push_back(
+					std::lower_bound(this->shared_cells.begin(), this->shared_cells.end(), cell)
+					- this->shared_cells.begin()
+				);
+			}
+
+			requests.push_back(MPI_Request());
+			MPI_Isend(
+				&(indices[0]),
+				indices.size(),
+				MPI_UINT64_T,
+				receiver->first,
+				this->get_process_pair_tag(this->comm.rank(), receiver->first),
+				this->comm,
+				&(requests.back())
+			);
+		}
+
+		if (requests.size() > 0) {
+			MPI_Waitall(requests.size(), &(requests[0]), MPI_STATUSES_IGNORE);
+		}
+
+		this->shared_window_version = this->cell_lists_version;
+	}
+
+
+	/*!
+	Frees shared_window if it exists.
+
+	Must be called simultaneously on all processes of node_comm.
+	*/
+	void free_shared_window(void)
+	{
+		if (this->shared_window == MPI_WIN_NULL) {
+			return;
+		}
+
+		MPI_Win_unlock_all(this->shared_window);
+		MPI_Win_free(&(this->shared_window));
+		this->shared_bases.clear();
+		this->shared_half_sizes.clear();
+	}
+	#endif	// ifdef DCCRG_SHARED_MEMORY_TRANSFER_AVAILABLE
+
+
+	/*!
+	Copies user data received from given process by PACKED_TRANSFER from its buffer into given destination.
+
+	Does nothing for data that was received directly into its final location.
+	*/
+	#ifdef DCCRG_USER_MPI_DATA_TYPE
+	void incorporate_received_data(
+		const int /*sender*/,
+		boost::unordered_map<uint64_t, UserData>& /*destination*/
+	) {}
+	#else
+	void incorporate_received_data(
+		const int sender,
+		boost::unordered_map<uint64_t, UserData>& destination
+	) {
+		if (this->active_transfer_policy != PACKED_TRANSFER
+		|| this->incoming_buffers.count(sender) == 0
+		|| this->cells_to_receive.count(sender) == 0) {
+			return;
+		}
+
+		const std::vector<uint8_t>& buffer = this->incoming_buffers.at(sender);
+		const std::vector<uint64_t>& received_cells = this->cells_to_receive.at(sender);
+
+		std::vector<uint64_t> offsets;
+		const uint64_t total_size = this->get_data_offsets(destination, received_cells, offsets);
+
+		#ifdef DEBUG
+		if (buffer.size() != total_size) {
+			std::cerr << __FILE__ << ":" << __LINE__
+				<< " Process " << this->comm.rank()
+				<< " has " << buffer.size()
+				<< " bytes of data from process " << sender
+				<< " instead of " << total_size
+				<< std::endl;
+			abort();
+		}
+		#else
+		(void) total_size;
+		#endif
+
+		const int number_of_cells = int(received_cells.size());
+		#ifdef _OPENMP
+		#pragma omp parallel for
+		#endif
+		for (int i = 0; i < number_of_cells; i++) {
+			std::memcpy(
+				destination.at(received_cells[i]).at(),
+				&(buffer[offsets[i]]),
+				offsets[i + 1] - offsets[i]
+			);
 		}
+	}
+	#endif
 
-		// all user data is sent using one MPI message / process
-		#else	// ifdef DCCRG_SEND_SINGLE_CELLS
+	#else	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
 
-		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
-		// receive one MPI datatype per process
-		for (boost::unordered_map<int, std::vector<uint64_t> >::iterator
-			sender = this->cells_to_receive.begin();
-			sender != this->cells_to_receive.end();
-			sender++
-		) {
-			std::sort(sender->second.begin(), sender->second.end());
 
-			// reserve space for incoming user data at our end
-			for (uint64_t i = 0; i < sender->second.size(); i++) {
-				destination[sender->second[i]];
-			}
+	/*!
+	Starts user data transfers of types for which boost::mpi has an MPI datatype.
 
-			// get displacements in bytes for incoming user data
-			std::vector<MPI_Aint> displacements(sender->second.size(), 0);
-			for (uint64_t i = 0; i < sender->second.size(); i++) {
-				displacements[i] = (uint8_t*) destination.at(sender->second[i]).at() - (uint8_t*) destination.at(sender->second[0]).at();
-			}
+	User data is sent from and received into its final location using one MPI datatype of absolute addresses per process.
+	*/
+	void start_serialized_transfers(
+		boost::unordered_map<uint64_t, UserData>& destination,
+		boost::mpl::true_
+	) {
+		// post all receives
+		for (int sender = 0; sender < this->comm.size(); sender++) {
 
-			MPI_Datatype receive_datatype;
+			if (sender == this->comm.rank()) {
+				continue;
+			}
 
-			#ifdef DCCRG_USER_MPI_DATA_TYPE
-			std::vector<int> block_lengths(displacements.size(), 1);
-			std::vector<MPI_Datatype> datatypes(displacements.size());
-			for (uint64_t i = 0; i < sender->second.size(); i++) {
-				datatypes[i] = destination.at(sender->second[i]).mpi_datatype();
+			if (this->cells_to_receive.count(sender) == 0
+			|| this->cells_to_receive.at(sender).size() == 0) {
+				// no data to send / receive
+				continue;
 			}
-			#else
-			std::vector<int> block_lengths(displacements.size(), UserData::size());
-			#endif
 
-			#ifdef DCCRG_USER_MPI_DATA_TYPE
-			MPI_Type_create_struct(
-				displacements.size(),
-				&block_lengths[0],
-				&displacements[0],
-				&datatypes[0],
-				&receive_datatype
-			);
-			#else
-			MPI_Type_create_hindexed(
-				displacements.size(),
-				&block_lengths[0],
-				&displacements[0],
-				MPI_BYTE,
-				&receive_datatype
-			);
-			#endif
+			std::sort(this->cells_to_receive.at(sender).begin(), this->cells_to_receive.at(sender).end());
 
-			MPI_Type_commit(&receive_datatype);
+			// reserve space for incoming user data at our end
+			BOOST_FOREACH(const uint64_t& cell, this->cells_to_receive.at(sender)) {
+				destination[cell];
+			}
 
-			int receive_tag = sender->first * this->comm.size() + this->comm.rank();
+			const int receive_tag = this->get_process_pair_tag(sender, this->comm.rank());
 
-			this->receive_requests[sender->first].push_back(MPI_Request());
+			const boost::mpi::content incoming = this->get_content(destination, this->cells_to_receive.at(sender));
 
-			MPI_Irecv(
-				destination.at(sender->second[0]).at(),
-				1,
-				receive_datatype,
-				sender->first,
-				receive_tag,
-				this->comm,
-				&(this->receive_requests[sender->first].back())
+			this->receive_requests[sender].push_back(
+				this->comm.irecv(
+					sender,
+					receive_tag,
+					incoming
+				)
 			);
-
-			MPI_Type_free(&receive_datatype);
 		}
 
-		// send one MPI datatype per process
-		for (boost::unordered_map<int, std::vector<uint64_t> >::iterator
-			receiver = this->cells_to_send.begin();
-			receiver != this->cells_to_send.end();
-			receiver++
-		) {
-			std::sort(receiver->second.begin(), receiver->second.end());
+		// post all sends
+		for (int receiver = 0; receiver < this->comm.size(); receiver++) {
 
-			// get displacements in bytes for outgoing user data
-			std::vector<MPI_Aint> displacements(receiver->second.size(), 0);
-			for (uint64_t i = 0; i < receiver->second.size(); i++) {
-				displacements[i] = (uint8_t*) this->cells.at(receiver->second[i]).at() - (uint8_t*) this->cells.at(receiver->second[0]).at();
+			if (receiver == this->comm.rank()) {
+				continue;
 			}
 
-			MPI_Datatype send_datatype;
-
-			#ifdef DCCRG_USER_MPI_DATA_TYPE
-			std::vector<int> block_lengths(displacements.size(), 1);
-			std::vector<MPI_Datatype> datatypes(displacements.size());
-			for (uint64_t i = 0; i < receiver->second.size(); i++) {
-				datatypes[i] = this->cells.at(receiver->second[i]).mpi_datatype();
+			if (this->cells_to_send.count(receiver) == 0
+			|| this->cells_to_send.at(receiver).size() == 0) {
+				// no data to send / receive
+				continue;
 			}
-			#else
-			std::vector<int> block_lengths(displacements.size(), UserData::size());
-			#endif
-
-			#ifdef DCCRG_USER_MPI_DATA_TYPE
-			MPI_Type_create_struct(
-				displacements.size(),
-				&block_lengths[0],
-				&displacements[0],
-				&datatypes[0],
-				&send_datatype
-			);
-			#else
-			MPI_Type_create_hindexed(
-				displacements.size(),
-				&block_lengths[0],
-				&displacements[0],
-				MPI_BYTE,
-				&send_datatype
-			);
-			#endif
 
-			MPI_Type_commit(&send_datatype);
+			std::sort(this->cells_to_send.at(receiver).begin(), this->cells_to_send.at(receiver).end());
 
-			int send_tag = this->comm.rank() * this->comm.size() + receiver->first;
+			const int send_tag = this->get_process_pair_tag(this->comm.rank(), receiver);
 
-			this->send_requests[receiver->first].push_back(MPI_Request());
+			const boost::mpi::content outgoing = this->get_content(this->cells, this->cells_to_send.at(receiver));
 
-			MPI_Isend(
-				this->cells.at(receiver->second[0]).at(),
-				1,
-				send_datatype,
-				receiver->first,
-				send_tag,
-				this->comm,
-				&(this->send_requests[receiver->first].back())
+			this->send_requests[receiver].push_back(
+				this->comm.isend(
+					receiver,
+					send_tag,
+					outgoing
+				)
 			);
+		}
+	}
 
-			MPI_Type_free(&send_datatype);
+
+	/*!
+	Returns the content, in the boost::mpi sense, of given cells' data in given storage.
+	*/
+	boost::mpi::content get_content(
+		const boost::unordered_map<uint64_t, UserData>& storage,
+		const std::vector<uint64_t>& given_cells
+	) const {
+		std::vector<MPI_Aint> displacements(given_cells.size(), 0);
+		for (uint64_t i = 0; i < given_cells.size(); i++) {
+			MPI_Get_address((void*) &(storage.at(given_cells[i])), &(displacements[i]));
 		}
 
-		#else	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+		std::vector<int> block_lengths(displacements.size(), 1);
+
+		MPI_Datatype datatype;
+		MPI_Type_create_hindexed(
+			displacements.size(),
+			&block_lengths[0],
+			&displacements[0],
+			boost::mpi::get_mpi_datatype<UserData>(storage.at(given_cells[0])),
+			&datatype
+		);
+		MPI_Type_commit(&datatype);
+
+		// freed by content
+		return boost::mpi::content(datatype, true);
+	}
+
+
+	/*!
+	Starts user data transfers of types that must be serialized.
 
+	Outgoing user data is serialized directly from local cells into one buffer per receiving process.
+	*/
+	void start_serialized_transfers(
+		boost::unordered_map<uint64_t, UserData>& /*destination*/,
+		boost::mpl::false_
+	) {
 		// post all receives
 		for (int sender = 0; sender < this->comm.size(); sender++) {
 
@@ -4829,18 +8156,18 @@ private:
 				continue;
 			}
 
-			int receive_tag = sender * this->comm.size() + this->comm.rank();
+			const int receive_tag = this->get_process_pair_tag(sender, this->comm.rank());
 
 			this->receive_requests[sender].push_back(
 				this->comm.irecv(
 					sender,
 					receive_tag,
-					this->incoming_data[sender]
+					this->incoming_buffers[sender]
 				)
 			);
 		}
 
-		// gather all data to send
+		// serialize and send all data
 		for (int receiver = 0; receiver < this->comm.size(); receiver++) {
 
 			if (receiver == this->comm.rank()) {
@@ -4854,53 +8181,85 @@ private:
 			}
 
 			std::sort(this->cells_to_send.at(receiver).begin(), this->cells_to_send.at(receiver).end());
-			// construct the outgoing data vector
-			BOOST_FOREACH(const uint64_t& cell, this->cells_to_send.at(receiver)) {
-				UserData* user_data = (*this)[cell];
-				assert(user_data != NULL);
-				this->outgoing_data[receiver].push_back(*user_data);
-			}
-		}
-
-		// post all sends
-		for (int receiver = 0; receiver < this->comm.size(); receiver++) {
 
-			if (receiver == this->comm.rank()) {
-				continue;
-			}
-
-			if (this->cells_to_send.count(receiver) == 0) {
-				// no data to send / receive
-				continue;
+			boost::mpi::packed_oarchive outgoing(this->comm, this->outgoing_buffers[receiver]);
+			BOOST_FOREACH(const uint64_t& cell, this->cells_to_send.at(receiver)) {
+				outgoing << this->cells.at(cell);
 			}
 
-			int send_tag = this->comm.rank() * this->comm.size() + receiver;
+			const int send_tag = this->get_process_pair_tag(this->comm.rank(), receiver);
 
 			this->send_requests[receiver].push_back(
 				this->comm.isend(
 					receiver,
 					send_tag,
-					this->outgoing_data[receiver]
+					this->outgoing_buffers[receiver]
 				)
 			);
 		}
-		#endif	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
-		#endif	// ifdef DCCRG_SEND_SINGLE_CELLS
 	}
 
 
+	/*!
+	Deserializes user data received from given process directly into given destination.
+
+	Does nothing for data that was received without serializing.
+	*/
+	void incorporate_received_data(
+		const int sender,
+		boost::unordered_map<uint64_t, UserData>& destination
+	) {
+		if (this->incoming_chunks.count(sender) > 0) {
+			const std::vector<uint64_t>& received_cells = this->cells_to_receive.at(sender);
+
+			uint64_t i = 0;
+			BOOST_FOREACH(const std::vector<UserData>& chunk, this->incoming_chunks.at(sender)) {
+				BOOST_FOREACH(const UserData& data, chunk) {
+					destination.at(received_cells[i]) = data;
+					i++;
+				}
+			}
+
+			#ifdef DEBUG
+			if (i != received_cells.size()) {
+				std::cerr << __FILE__ << ":" << __LINE__
+					<< " Process " << this->comm.rank()
+					<< " received data of " << i
+					<< " cells from process " << sender
+					<< " instead of " << received_cells.size()
+					<< std::endl;
+				abort();
+			}
+			#endif
+		}
+
+		if (this->incoming_buffers.count(sender) == 0) {
+			return;
+		}
+
+		std::sort(this->cells_to_receive.at(sender).begin(), this->cells_to_receive.at(sender).end());
+
+		boost::mpi::packed_iarchive incoming(this->comm, this->incoming_buffers.at(sender));
+		BOOST_FOREACH(const uint64_t& cell, this->cells_to_receive.at(sender)) {
+			incoming >> destination[cell];
+		}
+	}
+	#endif	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+
 	/*!
 	Waits for the receives of user data transfers between processes to complete.
 
 	User data arriving to this process is saved in given destination.
 	*/
-	void wait_user_data_transfer_receives(
-	#ifndef DCCRG_SEND_SINGLE_CELLS
-	#ifndef DCCRG_CELL_DATA_SIZE_FROM_USER
-	boost::unordered_map<uint64_t, UserData>& destination
-	#endif
-	#endif
-	) {
+	void wait_user_data_transfer_receives(boost::unordered_map<uint64_t, UserData>& destination)
+	{
+		const double start_time = (this->trace_file != NULL) ? MPI_Wtime() : 0;
+
+		// recorded as one call regardless of the number of senders
+		double wait_time = 0;
+		const bool waited = this->receive_requests.size() > 0;
+
 		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
 
 		for (boost::unordered_map<int, std::vector<MPI_Request> >::iterator
@@ -4911,7 +8270,11 @@ private:
 			std::vector<MPI_Status> statuses;
 			statuses.resize(process->second.size());
 
-			if (MPI_Waitall(process->second.size(), &(process->second[0]), &(statuses[0])) != MPI_SUCCESS) {
+			const double wait_start_time = MPI_Wtime();
+			const int result = MPI_Waitall(process->second.size(), &(process->second[0]), &(statuses[0]));
+			wait_time += MPI_Wtime() - wait_start_time;
+
+			if (result != MPI_SUCCESS) {
 				BOOST_FOREACH(const MPI_Status& status, statuses) {
 					if (status.MPI_ERROR != MPI_SUCCESS) {
 						std::cerr << "MPI receive failed from process " << status.MPI_SOURCE
@@ -4920,6 +8283,8 @@ private:
 					}
 				}
 			}
+
+			this->incorporate_received_data(process->first, destination);
 		}
 
 		#else	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
@@ -4929,32 +8294,28 @@ private:
 			process != this->receive_requests.end();
 			process++
 		) {
+			const double wait_start_time = MPI_Wtime();
 			boost::mpi::wait_all(process->second.begin(), process->second.end());
+			wait_time += MPI_Wtime() - wait_start_time;
+			this->incorporate_received_data(process->first, destination);
 		}
 
-		#ifndef DCCRG_SEND_SINGLE_CELLS
-
-		// incorporate received data
-		for (typename boost::unordered_map<int, std::vector<UserData> >::const_iterator
-			sender = this->incoming_data.begin();
-			sender != this->incoming_data.end();
-			sender++
-		) {
-			std::sort(this->cells_to_receive.at(sender->first).begin(), this->cells_to_receive.at(sender->first).end());
-
-			int i = 0;
-			BOOST_FOREACH(const uint64_t& cell, this->cells_to_receive.at(sender->first)) {
-				// TODO move data instead of copying
-				destination[cell] = this->incoming_data.at(sender->first)[i];
-				i++;
-			}
-		}
-		this->incoming_data.clear();
+		this->incoming_buffers.clear();
+		this->incoming_chunks.clear();
 
-		#endif	// ifndef DCCRG_SEND_SINGLE_CELLS
 		#endif	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
 
 		this->receive_requests.clear();
+
+		if (waited && this->get_active_statistics() != NULL) {
+			this->get_active_statistics()->add_phase_call("user_data_wait", wait_time);
+		}
+
+		if (this->trace_file != NULL) {
+			const double end_time = MPI_Wtime();
+			this->trace_record.receive_wait = end_time - start_time;
+			this->trace_record.receives_end_time = end_time - this->trace_start_time;
+		}
 	}
 
 
@@ -4963,8 +8324,25 @@ private:
 	*/
 	void wait_user_data_transfer_sends(void)
 	{
+		const double start_time = (this->trace_file != NULL) ? MPI_Wtime() : 0;
+
 		#ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
 
+		#if MPI_VERSION >= 3
+		// a neighborhood collective also sends until its only request completes
+		if (this->active_transfer_policy == NEIGHBORHOOD_TRANSFER) {
+			if (this->receive_requests.count(this->comm.rank()) > 0) {
+				std::vector<MPI_Request>& requests = this->receive_requests.at(this->comm.rank());
+				Phase_Timer timer(this->get_active_statistics(), "user_data_wait");
+				MPI_Waitall(requests.size(), &(requests[0]), MPI_STATUSES_IGNORE);
+			}
+
+			if (this->neighborhood_receive_datatypes.size() > 0) {
+				this->free_neighborhood_datatypes();
+			}
+		}
+		#endif
+
 		for (boost::unordered_map<int, std::vector<MPI_Request> >::iterator
 			process = this->send_requests.begin();
 			process != this->send_requests.end();
@@ -4973,7 +8351,9 @@ private:
 			std::vector<MPI_Status> statuses;
 			statuses.resize(process->second.size());
 
-			if (MPI_Waitall(process->second.size(), &(process->second[0]), &(statuses[0])) != MPI_SUCCESS) {
+			const int result = MPI_Waitall(process->second.size(), &(process->second[0]), &(statuses[0]));
+
+			if (result != MPI_SUCCESS) {
 				BOOST_FOREACH(const MPI_Status& status, statuses) {
 					if (status.MPI_ERROR != MPI_SUCCESS) {
 						std::cerr << "MPI receive failed from process " << status.MPI_SOURCE
@@ -4994,14 +8374,22 @@ private:
 			boost::mpi::wait_all(process->second.begin(), process->second.end());
 		}
 
-		#ifndef DCCRG_SEND_SINGLE_CELLS
-
-		this->outgoing_data.clear();
+		this->outgoing_buffers.clear();
+		this->outgoing_chunks.clear();
 
-		#endif	// ifndef DCCRG_SEND_SINGLE_CELLS
 		#endif	// ifdef DCCRG_CELL_DATA_SIZE_FROM_USER
 
 		this->send_requests.clear();
+
+		if (this->trace_file != NULL) {
+			const double end_time = MPI_Wtime();
+			this->trace_record.send_wait = end_time - start_time;
+			this->trace_record.sends_end_time = end_time - this->trace_start_time;
+			if (!this->trace_record.write(*(this->trace_file))) {
+				std::cerr << "Couldn't write trace record" << std::endl;
+				this->stop_tracing();
+			}
+		}
 	}
 
 
@@ -5240,17 +8628,38 @@ private:
 
 	// TODO: Zoltan assumes global ids are integers, which works as long as there are less than 2^32 cells in the grid
 
+	/*!
+	Returns true if given local id of given cell is a valid index into zoltan_cells.
+	*/
+	bool is_zoltan_local_id(const ZOLTAN_ID_TYPE local_id, const uint64_t cell) const
+	{
+		if (local_id >= this->zoltan_cells.size()) {
+			return false;
+		}
+
+		#ifdef DEBUG
+		if (this->zoltan_cells[local_id] != cell) {
+			return false;
+		}
+		#else
+		(void) cell;
+		#endif
+
+		return true;
+	}
+
+
 	/*!
 	Fills geom_vec with the coordinates of cells given in global_id
 	*/
-	static void fill_with_cell_coordinates(void *data, int /*global_id_size*/, int /*local_id_size*/, int number_of_cells, ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR /*local_ids*/, int /*number_of_dimensions*/, double *geom_vec, int *error)
+	static void fill_with_cell_coordinates(void *data, int /*global_id_size*/, int /*local_id_size*/, int number_of_cells, ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR local_ids, int /*number_of_dimensions*/, double *geom_vec, int *error)
 	{
 		Dccrg<UserData, UserGeometry>* dccrg_instance = reinterpret_cast<Dccrg<UserData, UserGeometry> *>(data);
 		*error = ZOLTAN_OK;
 
 		for (int i = 0; i < number_of_cells; i++) {
 			uint64_t cell = uint64_t(global_ids[i]);
-			if (dccrg_instance->cells.count(cell) == 0) {
+			if (!dccrg_instance->is_zoltan_local_id(local_ids[i], cell)) {
 				*error = ZOLTAN_FATAL;
 				std::cerr << "Process " << dccrg_instance->comm.rank() << ": Zoltan wanted the coordinates of a non-existing cell " << cell << std::endl;
 				return;
@@ -5270,39 +8679,29 @@ private:
 	{
 		Dccrg<UserData, UserGeometry>* dccrg_instance = reinterpret_cast<Dccrg<UserData, UserGeometry> *>(data);
 		*error = ZOLTAN_OK;
-		return dccrg_instance->cells.size();
+		return dccrg_instance->zoltan_cells.size();
 	}
 
 
 	/*!
 	Writes all cell ids on this process to the global_ids array
 	*/
-	static void fill_cell_list(void* data, int /*global_id_size*/, int /*local_id_size*/, ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR /*local_ids*/, int number_of_weights_per_object, float* object_weights, int* error)
+	static void fill_cell_list(void* data, int /*global_id_size*/, int /*local_id_size*/, ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR local_ids, int number_of_weights_per_object, float* object_weights, int* error)
 	{
 		Dccrg<UserData, UserGeometry>* dccrg_instance = reinterpret_cast<Dccrg<UserData, UserGeometry> *>(data);
 		*error = ZOLTAN_OK;
 
-		int i = 0;
-		BOOST_FOREACH(const cell_and_data_pair_t& item, dccrg_instance->cells) {
-
-			#ifdef DEBUG
-			if (item.first == 0) {
-				std::cerr << "User data exist for an illegal cell" << std::endl;
-				abort();
-			}
-			#endif
-
-			global_ids[i] = item.first;
-
-			if (number_of_weights_per_object > 0) {
-				if (dccrg_instance->cell_weights.count(item.first) > 0) {
-					object_weights[i] = dccrg_instance->cell_weights.at(item.first);
-				} else {
-					object_weights[i] = 1;
-				}
-			}
+		for (size_t i = 0; i < dccrg_instance->zoltan_cells.size(); i++) {
+			global_ids[i] = dccrg_instance->zoltan_cells[i];
+			local_ids[i] = i;
+		}
 
-			i++;
+		if (number_of_weights_per_object > 0) {
+			std::copy(
+				dccrg_instance->zoltan_cell_weights.begin(),
+				dccrg_instance->zoltan_cell_weights.end(),
+				object_weights
+			);
 		}
 	}
 
@@ -5310,14 +8709,14 @@ private:
 	/*!
 	Writes the number of neighbors into number_of_neighbors for all cells given in global_ids with length number_of_cells
 	*/
-	static void fill_number_of_neighbors_for_cells(void* data, int /*global_id_size*/, int /*local_id_size*/, int number_of_cells, ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR /*local_ids*/, int* number_of_neighbors, int* error)
+	static void fill_number_of_neighbors_for_cells(void* data, int /*global_id_size*/, int /*local_id_size*/, int number_of_cells, ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR local_ids, int* number_of_neighbors, int* error)
 	{
 		Dccrg<UserData, UserGeometry>* dccrg_instance = reinterpret_cast<Dccrg<UserData, UserGeometry> *>(data);
 		*error = ZOLTAN_OK;
 
 		for (int i = 0; i < number_of_cells; i++) {
 			uint64_t cell = uint64_t(global_ids[i]);
-			if (dccrg_instance->cells.count(cell) == 0) {
+			if (!dccrg_instance->is_zoltan_local_id(local_ids[i], cell)) {
 				*error = ZOLTAN_FATAL;
 				std::cerr << "Process " << dccrg_instance->comm.rank()
 					<< ": Zoltan wanted the number of neighbors of a non-existing cell " << cell
@@ -5325,15 +8724,9 @@ private:
 				return;
 			}
 
-			number_of_neighbors[i] = 0;
-			BOOST_FOREACH(const uint64_t& neighbor, dccrg_instance->neighbors.at(cell)) {
-				if (neighbor != 0
-				/* Zoltan 3.501 crashes in hierarchial
-				if a cell is a neighbor to itself */
-				&& neighbor != cell) {
-					number_of_neighbors[i]++;
-				}
-			}
+			number_of_neighbors[i]
+				= dccrg_instance->zoltan_neighbor_offsets[local_ids[i] + 1]
+				- dccrg_instance->zoltan_neighbor_offsets[local_ids[i]];
 		}
 	}
 
@@ -5341,7 +8734,7 @@ private:
 	/*!
 	Writes neighbor lists of given cells into neighbors, etc.
 	*/
-	static void fill_neighbor_lists(void* data, int /*global_id_size*/, int /*local_id_size*/, int number_of_cells, ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR /*local_ids*/, int* number_of_neighbors, ZOLTAN_ID_PTR neighbors, int* processes_of_neighbors, int number_of_weights_per_edge, float* edge_weights, int* error)
+	static void fill_neighbor_lists(void* data, int /*global_id_size*/, int /*local_id_size*/, int number_of_cells, ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR local_ids, int* number_of_neighbors, ZOLTAN_ID_PTR neighbors, int* processes_of_neighbors, int number_of_weights_per_edge, float* edge_weights, int* error)
 	{
 		Dccrg<UserData, UserGeometry>* dccrg_instance = reinterpret_cast<Dccrg<UserData, UserGeometry> *>(data);
 		*error = ZOLTAN_OK;
@@ -5349,29 +8742,23 @@ private:
 		int current_neighbor_number = 0;
 		for (int i = 0; i < number_of_cells; i++) {
 			uint64_t cell = uint64_t(global_ids[i]);
-			if (dccrg_instance->cells.count(cell) == 0) {
+			if (!dccrg_instance->is_zoltan_local_id(local_ids[i], cell)) {
 				*error = ZOLTAN_FATAL;
 				std::cerr << "Process " << dccrg_instance->comm.rank() << ": Zoltan wanted neighbor list of a non-existing cell " << cell << std::endl;
 				return;
 			}
 
-			number_of_neighbors[i] = 0;
-
-			BOOST_FOREACH(const uint64_t& neighbor, dccrg_instance->neighbors.at(cell)) {
-
-				if (neighbor == 0
-				/* Zoltan 3.501 crashes in hierarchial
-				if a cell is a neighbor to itself */
-				|| neighbor == cell) {
-					continue;
-				}
+			const int
+				first = dccrg_instance->zoltan_neighbor_offsets[local_ids[i]],
+				last = dccrg_instance->zoltan_neighbor_offsets[local_ids[i] + 1];
 
-				number_of_neighbors[i]++;
+			number_of_neighbors[i] = last - first;
 
-				neighbors[current_neighbor_number] = neighbor;
-				processes_of_neighbors[current_neighbor_number] = dccrg_instance->cell_process.at(neighbor);
+			for (int j = first; j < last; j++) {
+				neighbors[current_neighbor_number] = dccrg_instance->zoltan_neighbors[j];
+				processes_of_neighbors[current_neighbor_number] = dccrg_instance->zoltan_neighbor_processes[j];
 
-				// weight of edge from cell to *neighbor
+				// weight of edge from cell to neighbor
 				if (number_of_weights_per_edge > 0) {
 					edge_weights[current_neighbor_number] = 1.0;
 				}
@@ -5390,23 +8777,9 @@ private:
 		Dccrg<UserData, UserGeometry>* dccrg_instance = reinterpret_cast<Dccrg<UserData, UserGeometry> *>(data);
 		*error = ZOLTAN_OK;
 
-		*number_of_hyperedges = dccrg_instance->cells.size();
+		*number_of_hyperedges = dccrg_instance->zoltan_cells.size();
 		*format = ZOLTAN_COMPRESSED_EDGE;
-
-		*number_of_connections = 0;
-		BOOST_FOREACH(const cell_and_data_pair_t& item, dccrg_instance->cells) {
-
-			(*number_of_connections)++;
-
-			BOOST_FOREACH(const uint64_t& neighbor, dccrg_instance->neighbors.at(item.first)) {
-				if (neighbor != 0
-				/* Zoltan 3.501 crashes in hierarchial
-				if a cell is a neighbor to itself */
-				&& neighbor != item.first) {
-					(*number_of_connections)++;
-				}
-			}
-		}
+		*number_of_connections = dccrg_instance->zoltan_cells.size() + dccrg_instance->zoltan_neighbors.size();
 	}
 
 
@@ -5424,34 +8797,24 @@ private:
 			return;
 		}
 
-		if ((unsigned int) number_of_hyperedges != dccrg_instance->cells.size()) {
-			std::cerr << "Zoltan is expecting wrong number of hyperedges: " << number_of_hyperedges << " instead of " << dccrg_instance->cells.size() << std::endl;
+		if ((unsigned int) number_of_hyperedges != dccrg_instance->zoltan_cells.size()) {
+			std::cerr << "Zoltan is expecting wrong number of hyperedges: " << number_of_hyperedges << " instead of " << dccrg_instance->zoltan_cells.size() << std::endl;
 			*error = ZOLTAN_FATAL;
 			return;
 		}
 
-		int i = 0;
 		int connection_number = 0;
-		BOOST_FOREACH(const cell_and_data_pair_t& item, dccrg_instance->cells) {
+		for (size_t i = 0; i < dccrg_instance->zoltan_cells.size(); i++) {
 
-			hyperedges[i] = item.first;
+			hyperedges[i] = dccrg_instance->zoltan_cells[i];
 			hyperedge_connection_offsets[i] = connection_number;
 
 			// add a connection to the cell itself from its hyperedge
-			connections[connection_number++] = item.first;
-
-			BOOST_FOREACH(const uint64_t& neighbor, dccrg_instance->neighbors.at(item.first)) {
-				if (neighbor == 0
-				/* Zoltan 3.501 crashes in hierarchial
-				if a cell is a neighbor to itself */
-				|| neighbor == item.first) {
-					continue;
-				}
+			connections[connection_number++] = dccrg_instance->zoltan_cells[i];
 
-				connections[connection_number++] = neighbor;
+			for (int j = dccrg_instance->zoltan_neighbor_offsets[i]; j < dccrg_instance->zoltan_neighbor_offsets[i + 1]; j++) {
+				connections[connection_number++] = dccrg_instance->zoltan_neighbors[j];
 			}
-
-			i++;
 		}
 
 		if (connection_number != number_of_connections) {
@@ -5472,7 +8835,7 @@ private:
 		Dccrg<UserData, UserGeometry>* dccrg_instance = reinterpret_cast<Dccrg<UserData, UserGeometry> *>(data);
 		*error = ZOLTAN_OK;
 
-		*number_of_edge_weights = dccrg_instance->cells.size();
+		*number_of_edge_weights = dccrg_instance->zoltan_cells.size();
 		return;
 	}
 
@@ -5485,33 +8848,21 @@ private:
 		Dccrg<UserData, UserGeometry>* dccrg_instance = reinterpret_cast<Dccrg<UserData, UserGeometry> *>(data);
 		*error = ZOLTAN_OK;
 
-		if ((unsigned int) number_of_hyperedges != dccrg_instance->cells.size()) {
-			std::cerr << "Zoltan is expecting wrong number of hyperedges: " << number_of_hyperedges << " instead of " << dccrg_instance->cells.size() << std::endl;
+		if ((unsigned int) number_of_hyperedges != dccrg_instance->zoltan_cells.size()) {
+			std::cerr << "Zoltan is expecting wrong number of hyperedges: " << number_of_hyperedges << " instead of " << dccrg_instance->zoltan_cells.size() << std::endl;
 			*error = ZOLTAN_FATAL;
 			return;
 		}
 
-		int i = 0;
-		BOOST_FOREACH(const cell_and_data_pair_t& item, dccrg_instance->cells) {
+		for (size_t i = 0; i < dccrg_instance->zoltan_cells.size(); i++) {
 
-			hyperedges[i] = item.first;
+			hyperedges[i] = dccrg_instance->zoltan_cells[i];
 
 			if (number_of_weights_per_hyperedge > 0) {
-				int number_of_hyperedges = 0;
-
-				BOOST_FOREACH(const uint64_t& neighbor, dccrg_instance->neighbors.at(item.first)) {
-					if (neighbor != 0
-					/* Zoltan 3.501 crashes in hierarchial
-					if a cell is a neighbor to itself */
-					&& neighbor != item.first) {
-						number_of_hyperedges++;
-					}
-				}
-
-				hyperedge_weights[i] = 1.0 * number_of_hyperedges;
+				hyperedge_weights[i]
+					= dccrg_instance->zoltan_neighbor_offsets[i + 1]
+					- dccrg_instance->zoltan_neighbor_offsets[i];
 			}
-
-			i++;
 		}
 	}
 
@@ -5542,6 +8893,10 @@ private:
 			*error = ZOLTAN_OK;
 		}
 
+		if (dccrg_instance->level_parts[level] >= 0) {
+			return dccrg_instance->level_parts[level];
+		}
+
 		int process = dccrg_instance->comm.rank();
 		int part;
 
@@ -339,6 +339,91 @@ public:
 	}
 
 
+	/*!
+	Writes the centers of given cells into given arrays.
+
+	Equivalent to calling get_cell_x(), get_cell_y() and get_cell_z() for every
+	cell but the refinement level and indices of each cell are calculated once
+	using the first cell of each refinement level stored by Index.
+	All arrays must have room for number_of_cells values.
+	Centers of invalid cells are NaN.
+	*/
+	void get_cell_centers(
+		const uint64_t* cells,
+		const size_t number_of_cells,
+		double* x,
+		double* y,
+		double* z
+	) const {
+		const uint64_t* const first_cells = &(this->level_first_cell[0]);
+
+		for (size_t i = 0; i < number_of_cells; i++) {
+			if (cells[i] == error_cell || cells[i] > this->last_cell) {
+				x[i] = y[i] = z[i] = std::numeric_limits<double>::quiet_NaN();
+				continue;
+			}
+
+			int refinement_level = 0;
+			while (refinement_level < this->max_refinement_level
+			&& cells[i] >= first_cells[refinement_level + 1]) {
+				refinement_level++;
+			}
+
+			// multiplying by the inverse of a power of 2 is exact
+			const double
+				scale = 1.0 / double(uint64_t(1) << refinement_level),
+				x_size = this->cell_x_size * scale,
+				y_size = this->cell_y_size * scale,
+				z_size = this->cell_z_size * scale;
+
+			const Types<3>::indices_t indices = this->get_level_indices(
+				cells[i] - first_cells[refinement_level],
+				refinement_level
+			);
+
+			x[i] = this->x_start + double(indices[0]) * x_size + x_size / 2;
+			y[i] = this->y_start + double(indices[1]) * y_size + y_size / 2;
+			z[i] = this->z_start + double(indices[2]) * z_size + z_size / 2;
+		}
+	}
+
+	/*!
+	Writes the lengths of given cells into given arrays.
+
+	Equivalent to calling get_cell_x_size(), get_cell_y_size() and get_cell_z_size() for every cell.
+	All arrays must have room for number_of_cells values.
+	Lengths of invalid cells are NaN.
+	*/
+	void get_cell_sizes(
+		const uint64_t* cells,
+		const size_t number_of_cells,
+		double* x_sizes,
+		double* y_sizes,
+		double* z_sizes
+	) const {
+		const uint64_t* const first_cells = &(this->level_first_cell[0]);
+
+		for (size_t i = 0; i < number_of_cells; i++) {
+			if (cells[i] == error_cell || cells[i] > this->last_cell) {
+				x_sizes[i] = y_sizes[i] = z_sizes[i] = std::numeric_limits<double>::quiet_NaN();
+				continue;
+			}
+
+			int refinement_level = 0;
+			while (refinement_level < this->max_refinement_level
+			&& cells[i] >= first_cells[refinement_level + 1]) {
+				refinement_level++;
+			}
+
+			// multiplying by the inverse of a power of 2 is exact
+			const double scale = 1.0 / double(uint64_t(1) << refinement_level);
+			x_sizes[i] = this->cell_x_size * scale;
+			y_sizes[i] = this->cell_y_size * scale;
+			z_sizes[i] = this->cell_z_size * scale;
+		}
+	}
+
+
 	/*!
 	Returns the center of a cell in x direction of given refinement level at given index.
 	*/
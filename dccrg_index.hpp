@@ -19,9 +19,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef DCCRG_INDEX_HPP
 #define DCCRG_INDEX_HPP
 
+#include "boost/array.hpp"
 #include "cmath"
 #include "iostream"
 #include "stdint.h"
+#include "vector"
 
 #include "dccrg_types.hpp"
 
@@ -34,6 +36,18 @@ static const uint64_t error_cell = 0;
 static const uint64_t error_index = std::numeric_limits<uint64_t>::max();
 
 
+/*!
+\brief Maps cells to their refinement level and indices and back.
+
+Cells are numbered starting from 1, first all cells of refinement level 0,
+then all cells of refinement level 1, etc.
+Within a refinement level cells are numbered in x-fastest row-major order
+by default. If DCCRG_MORTON_ORDER is defined cells of refinement level > 0
+are numbered by the unrefined cell they are in and within that by Morton
+(z-order) curve, so that sorting cells by id also sorts them spatially
+and all children of a cell have consecutive ids.
+Unrefined cells are numbered the same way in both cases.
+*/
 class Index
 {
 
@@ -46,7 +60,7 @@ public:
 	{
 		this->max_refinement_level = 0;
 		this->x_length = this->y_length = this->z_length = this->grid_length = 1;
-		this->last_cell = 1;
+		this->update_last_cell();
 	}
 
 	/*!
@@ -194,28 +208,15 @@ public:
 			return error_cell;
 		}
 
-		// cell numbering starts at 1
-		uint64_t cell = 1;
-
-		// add ids of larger cells
-		for (int i = 0; i < refinement_level; i++) {
-			cell += this->x_length * this->y_length * this->z_length * (uint64_t(1) << (i * 3));
-		}
-
 		// convert to indices of this cell's refinement level
 		const Types<3>::indices_t this_level_indices = {{
-			indices[0] / (uint64_t(1) << (this->max_refinement_level - refinement_level)),
-			indices[1] / (uint64_t(1) << (this->max_refinement_level - refinement_level)),
-			indices[2] / (uint64_t(1) << (this->max_refinement_level - refinement_level))
+			indices[0] >> (this->max_refinement_level - refinement_level),
+			indices[1] >> (this->max_refinement_level - refinement_level),
+			indices[2] >> (this->max_refinement_level - refinement_level)
 		}};
 
-		// get the size of the grid in terms of cells of this refinement level
-		const uint64_t this_level_x_length = this->x_length * (uint64_t(1) << refinement_level);
-		const uint64_t this_level_y_length = this->y_length * (uint64_t(1) << refinement_level);
-
-		cell += this_level_indices[0] + this_level_indices[1] * this_level_x_length + this_level_indices[2] * this_level_x_length * this_level_y_length;
-
-		return cell;
+		return this->level_first_cell[refinement_level]
+			+ this->get_level_offset(this_level_indices, refinement_level);
 	}
 
 	/*!
@@ -246,18 +247,16 @@ public:
 			return error_indices;
 		}
 
-		// substract ids of larger cells
 		const int refinement_level = this->get_refinement_level(cell);
-		for (int i = 0; i < refinement_level; i++) {
-			cell -= this->x_length * this->y_length * this->z_length * (uint64_t(1) << (i * 3));
-		}
+		Types<3>::indices_t indices = this->get_level_indices(
+			cell - this->level_first_cell[refinement_level],
+			refinement_level
+		);
 
-		cell -= 1;	// cell numbering starts from 1
-		const Types<3>::indices_t indices = {{
-			(cell % (this->x_length * (uint64_t(1) << refinement_level))) * (uint64_t(1) << (max_refinement_level - refinement_level)),
-			((cell / (this->x_length * (uint64_t(1) << refinement_level))) % (this->y_length * (uint64_t(1) << refinement_level))) * (uint64_t(1) << (max_refinement_level - refinement_level)),
-			(cell / (this->x_length * this->y_length * (uint64_t(1) << (2 * refinement_level)))) * (uint64_t(1) << (max_refinement_level - refinement_level))
-		}};
+		// convert to indices of the maximum refinement level
+		indices[0] <<= this->max_refinement_level - refinement_level;
+		indices[1] <<= this->max_refinement_level - refinement_level;
+		indices[2] <<= this->max_refinement_level - refinement_level;
 
 		return indices;
 	}
@@ -275,22 +274,11 @@ public:
 		}
 
 		int refinement_level = 0;
-		uint64_t current_last = 0;
-
-		while (refinement_level <= this->max_refinement_level) {
-			current_last += this->x_length * this->y_length * this->z_length * (uint64_t(1) << 3 * refinement_level);
-
-			if (cell <= current_last) {
-				break;
-			}
-
+		while (refinement_level < this->max_refinement_level
+		&& cell >= this->level_first_cell[refinement_level + 1]) {
 			refinement_level++;
 		}
 
-		if (refinement_level > this->max_refinement_level) {
-			return -1;
-		}
-
 		return refinement_level;
 	}
 
@@ -342,11 +330,32 @@ public:
 	Returns error_cell if given cell's refinement level > maximum refinement level or < 0.
 	*/
 	uint64_t get_parent_for_removed(const uint64_t cell) const
+	{
+		return this->get_octree_parent(cell);
+	}
+
+
+	/*
+	Octree topology of cells regardless of whether they exist in a grid.
+
+	Cells are related through their level offsets so these don't
+	search through refinement levels more than once, don't convert
+	to and from indices of the maximum refinement level and don't
+	allocate memory. Children and siblings are given in the same
+	order as by Dccrg::get_all_children(): x index changes fastest
+	and z index slowest.
+	*/
+
+	/*!
+	Returns the parent of given cell.
+
+	Returns the given cell if its refinement level == 0 and error_cell if given cell is invalid.
+	*/
+	uint64_t get_octree_parent(const uint64_t cell) const
 	{
 		const int refinement_level = this->get_refinement_level(cell);
 
-		if (refinement_level < 0
-		|| refinement_level > this->max_refinement_level) {
+		if (refinement_level < 0) {
 			return error_cell;
 		}
 
@@ -354,7 +363,100 @@ public:
 			return cell;
 		}
 
-		return this->get_cell_from_indices(this->get_indices(cell), refinement_level - 1);
+		const uint64_t offset = cell - this->level_first_cell[refinement_level];
+
+		#ifdef DCCRG_MORTON_ORDER
+
+		return this->level_first_cell[refinement_level - 1] + (offset >> 3);
+
+		#else
+
+		Types<3>::indices_t indices = this->get_level_indices(offset, refinement_level);
+		indices[0] >>= 1;
+		indices[1] >>= 1;
+		indices[2] >>= 1;
+
+		return this->level_first_cell[refinement_level - 1]
+			+ this->get_level_offset(indices, refinement_level - 1);
+
+		#endif
+	}
+
+	/*!
+	Returns the child of given cell with the smallest indices.
+
+	Returns error_cell if given cell is invalid or its refinement level is the maximum.
+	*/
+	uint64_t get_octree_first_child(const uint64_t cell) const
+	{
+		const int refinement_level = this->get_refinement_level(cell);
+
+		if (refinement_level < 0
+		|| refinement_level >= this->max_refinement_level) {
+			return error_cell;
+		}
+
+		return this->get_first_child(cell, refinement_level);
+	}
+
+	/*!
+	Writes the children of given cell into given array.
+
+	Returns false without modifying children if given cell is invalid
+	or its refinement level is the maximum, true otherwise.
+	*/
+	bool get_octree_children(const uint64_t cell, boost::array<uint64_t, 8>& children) const
+	{
+		const int refinement_level = this->get_refinement_level(cell);
+
+		if (refinement_level < 0
+		|| refinement_level >= this->max_refinement_level) {
+			return false;
+		}
+
+		const uint64_t first_child = this->get_first_child(cell, refinement_level);
+
+		#ifdef DCCRG_MORTON_ORDER
+
+		for (uint64_t i = 0; i < 8; i++) {
+			children[i] = first_child + i;
+		}
+
+		#else
+
+		// distances between children in the numbering of their refinement level
+		const uint64_t
+			y_step = this->x_length << (refinement_level + 1),
+			z_step = y_step * (this->y_length << (refinement_level + 1));
+
+		children[0] = first_child;
+		children[1] = first_child + 1;
+		children[2] = first_child + y_step;
+		children[3] = first_child + y_step + 1;
+		children[4] = first_child + z_step;
+		children[5] = first_child + z_step + 1;
+		children[6] = first_child + z_step + y_step;
+		children[7] = first_child + z_step + y_step + 1;
+
+		#endif
+
+		return true;
+	}
+
+	/*!
+	Writes the siblings of given cell, including the cell itself, into given array.
+
+	Returns false without modifying siblings if given cell is invalid
+	or its refinement level is 0, true otherwise.
+	*/
+	bool get_octree_siblings(const uint64_t cell, boost::array<uint64_t, 8>& siblings) const
+	{
+		const uint64_t parent = this->get_octree_parent(cell);
+		if (parent == error_cell || parent == cell) {
+			return false;
+		}
+
+		return this->get_octree_children(parent, siblings);
 	}
 
 
@@ -374,18 +476,158 @@ protected:
 	// last valid cell with these lengths and maximum_refinement_level
 	uint64_t last_cell;
 
+	// first cell of each refinement level from 0 to max_refinement_level
+	std::vector<uint64_t> level_first_cell;
+
+
+	/*!
+	Returns the position of the cell at given indices among cells of given refinement level.
+
+	Indices are in units of given refinement level's cells and must be valid.
+	*/
+	uint64_t get_level_offset(const Types<3>::indices_t& level_indices, const int refinement_level) const
+	{
+		#ifndef DCCRG_MORTON_ORDER
+
+		// get the size of the grid in terms of cells of this refinement level
+		const uint64_t this_level_x_length = this->x_length << refinement_level;
+		const uint64_t this_level_y_length = this->y_length << refinement_level;
+
+		return level_indices[0]
+			+ level_indices[1] * this_level_x_length
+			+ level_indices[2] * this_level_x_length * this_level_y_length;
+
+		#else
+
+		const uint64_t
+			root = (level_indices[0] >> refinement_level)
+				+ (level_indices[1] >> refinement_level) * this->x_length
+				+ (level_indices[2] >> refinement_level) * this->x_length * this->y_length,
+			local_mask = (uint64_t(1) << refinement_level) - 1;
+
+		return (root << (3 * refinement_level))
+			| interleave_bits(level_indices[0] & local_mask)
+			| (interleave_bits(level_indices[1] & local_mask) << 1)
+			| (interleave_bits(level_indices[2] & local_mask) << 2);
+
+		#endif
+	}
+
+	/*!
+	Returns the indices of the cell at given position among cells of given refinement level.
+
+	Inverse of get_level_offset(), offset must be valid.
+	*/
+	Types<3>::indices_t get_level_indices(const uint64_t offset, const int refinement_level) const
+	{
+		#ifndef DCCRG_MORTON_ORDER
+
+		const uint64_t this_level_x_length = this->x_length << refinement_level;
+		const uint64_t this_level_y_length = this->y_length << refinement_level;
+		const uint64_t xy = offset / this_level_x_length;
+
+		const Types<3>::indices_t level_indices = {{
+			offset - xy * this_level_x_length,
+			xy % this_level_y_length,
+			xy / this_level_y_length
+		}};
+
+		#else
+
+		const uint64_t
+			root = offset >> (3 * refinement_level),
+			local = offset & ((uint64_t(1) << (3 * refinement_level)) - 1),
+			root_xy = root / this->x_length;
+
+		const Types<3>::indices_t level_indices = {{
+			((root - root_xy * this->x_length) << refinement_level) | compact_bits(local),
+			((root_xy % this->y_length) << refinement_level) | compact_bits(local >> 1),
+			((root_xy / this->y_length) << refinement_level) | compact_bits(local >> 2)
+		}};
+
+		#endif
+
+		return level_indices;
+	}
+
+	/*!
+	Returns the child with the smallest indices of given cell of given refinement level.
+
+	Given refinement level must be the cell's and less than the maximum refinement level.
+	*/
+	uint64_t get_first_child(const uint64_t cell, const int refinement_level) const
+	{
+		const uint64_t offset = cell - this->level_first_cell[refinement_level];
+
+		#ifdef DCCRG_MORTON_ORDER
+
+		return this->level_first_cell[refinement_level + 1] + (offset << 3);
+
+		#else
+
+		Types<3>::indices_t indices = this->get_level_indices(offset, refinement_level);
+		indices[0] <<= 1;
+		indices[1] <<= 1;
+		indices[2] <<= 1;
+
+		return this->level_first_cell[refinement_level + 1]
+			+ this->get_level_offset(indices, refinement_level + 1);
+
+		#endif
+	}
+
 
 private:
 
+	#ifdef DCCRG_MORTON_ORDER
+
 	/*!
-	Set the value of last_cell based on current grid lengths and max_refinement_level.
+	Returns given bits spread out so that two zero bits follow each of them.
+
+	Only the 21 lowest bits of given value are used.
+	*/
+	static uint64_t interleave_bits(uint64_t value)
+	{
+		value &= 0x1fffff;
+		value = (value | (value << 32)) & 0x1f00000000ffff;
+		value = (value | (value << 16)) & 0x1f0000ff0000ff;
+		value = (value | (value << 8)) & 0x100f00f00f00f00f;
+		value = (value | (value << 4)) & 0x10c30c30c30c30c3;
+		value = (value | (value << 2)) & 0x1249249249249249;
+		return value;
+	}
+
+	/*!
+	Returns every third bit of given value starting from the lowest one packed together.
+
+	Inverse of interleave_bits().
+	*/
+	static uint64_t compact_bits(uint64_t value)
+	{
+		value &= 0x1249249249249249;
+		value = (value | (value >> 2)) & 0x10c30c30c30c30c3;
+		value = (value | (value >> 4)) & 0x100f00f00f00f00f;
+		value = (value | (value >> 8)) & 0x1f0000ff0000ff;
+		value = (value | (value >> 16)) & 0x1f00000000ffff;
+		value = (value | (value >> 32)) & 0x1fffff;
+		return value;
+	}
+
+	#endif
+
+	/*!
+	Set the value of last_cell and level_first_cell based on current grid lengths and max_refinement_level.
 
 	Assumes up to date grid_length.
 	*/
 	void update_last_cell(void)
 	{
+		this->level_first_cell.resize(this->max_refinement_level + 1);
+
+		// cell numbering starts at 1
 		this->last_cell = 0;
 		for (int i = 0; i <= this->max_refinement_level; i++) {
+			this->level_first_cell[i] = this->last_cell + 1;
 			this->last_cell += this->grid_length * (uint64_t(1) << (i * 3));
 		}
 	}
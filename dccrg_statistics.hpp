@@ -0,0 +1,301 @@
+/*
+Performance statistics collected by dccrg
+
+Copyright 2009, 2010, 2011, 2012 Finnish Meteorological Institute
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License version 3
+as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DCCRG_STATISTICS_HPP
+#define DCCRG_STATISTICS_HPP
+
+#include "map"
+#include "mpi.h"
+#include "ostream"
+#include "stdint.h"
+#include "string"
+
+namespace dccrg {
+
+/*!
+\brief Number of calls to and time spent in one phase of dccrg on one process.
+*/
+class Phase_Statistics
+{
+public:
+	uint64_t calls;
+	// in seconds as given by MPI_Wtime()
+	double time;
+
+	Phase_Statistics() : calls(0), time(0) {}
+};
+
+
+/*!
+\brief Amount of user data transferred between one process and another.
+
+Cells that are transferred through shared memory add bytes but no messages.
+*/
+class Peer_Statistics
+{
+public:
+	uint64_t sent_messages, sent_bytes, received_messages, received_bytes;
+
+	Peer_Statistics() :
+		sent_messages(0),
+		sent_bytes(0),
+		received_messages(0),
+		received_bytes(0)
+	{}
+};
+
+
+/*!
+\brief Phase timers and communication counters of one process.
+
+Phases are identified by their name, see Dccrg::set_statistics_collection()
+for the phases collected by dccrg. Peers are identified by their rank.
+*/
+class Statistics
+{
+public:
+	std::map<std::string, Phase_Statistics> phases;
+	std::map<int, Peer_Statistics> peers;
+
+	/*!
+	Adds one call taking given number of seconds to given phase.
+	*/
+	void add_phase_call(const std::string& phase, const double time)
+	{
+		Phase_Statistics& statistics = this->phases[phase];
+		statistics.calls++;
+		statistics.time += time;
+	}
+
+	/*!
+	Removes all collected statistics.
+	*/
+	void clear(void)
+	{
+		this->phases.clear();
+		this->peers.clear();
+	}
+
+	/*!
+	Writes collected statistics of process with given rank in CSV format into given stream.
+
+	Every phase and peer is written on its own line after a header line,
+	columns that don't apply to the line are left empty.
+	*/
+	void write_csv(std::ostream& out, const int rank) const
+	{
+		out << "rank,record,name,calls,time,sent_messages,sent_bytes,received_messages,received_bytes\n";
+
+		for (std::map<std::string, Phase_Statistics>::const_iterator
+			phase = this->phases.begin();
+			phase != this->phases.end();
+			phase++
+		) {
+			out << rank << ",phase," << phase->first << ","
+				<< phase->second.calls << ","
+				<< phase->second.time << ",,,,\n";
+		}
+
+		for (std::map<int, Peer_Statistics>::const_iterator
+			peer = this->peers.begin();
+			peer != this->peers.end();
+			peer++
+		) {
+			out << rank << ",peer," << peer->first << ",,,"
+				<< peer->second.sent_messages << ","
+				<< peer->second.sent_bytes << ","
+				<< peer->second.received_messages << ","
+				<< peer->second.received_bytes << "\n";
+		}
+	}
+
+	/*!
+	Writes collected statistics of process with given rank as one JSON object into given stream.
+	*/
+	void write_json(std::ostream& out, const int rank) const
+	{
+		out << "{\n\t\"rank\": " << rank << ",\n\t\"phases\": {";
+
+		for (std::map<std::string, Phase_Statistics>::const_iterator
+			phase = this->phases.begin();
+			phase != this->phases.end();
+			phase++
+		) {
+			out << (phase == this->phases.begin() ? "\n" : ",\n")
+				<< "\t\t\"" << phase->first << "\": {\"calls\": " << phase->second.calls
+				<< ", \"time\": " << phase->second.time << "}";
+		}
+
+		out << "\n\t},\n\t\"peers\": {";
+
+		for (std::map<int, Peer_Statistics>::const_iterator
+			peer = this->peers.begin();
+			peer != this->peers.end();
+			peer++
+		) {
+			out << (peer == this->peers.begin() ? "\n" : ",\n")
+				<< "\t\t\"" << peer->first << "\": {"
+				<< "\"sent_messages\": " << peer->second.sent_messages
+				<< ", \"sent_bytes\": " << peer->second.sent_bytes
+				<< ", \"received_messages\": " << peer->second.received_messages
+				<< ", \"received_bytes\": " << peer->second.received_bytes
+				<< "}";
+		}
+
+		out << "\n\t}\n}\n";
+	}
+};
+
+
+/*!
+\brief Quality of the partitioning of a grid between processes, see Dccrg::get_partition_quality().
+
+Values are global, maximums and minimums are over processes.
+*/
+class Partition_Quality
+{
+public:
+	// largest total weight of a process' cells divided by the average total weight
+	double imbalance;
+	double total_weight, max_weight;
+	uint64_t total_cells, max_cells;
+	// number of processes with which a process exchanges neighbor data
+	int min_peers, max_peers;
+	double average_peers;
+	// number of remote cells whose data a process receives in a neighbor data update
+	uint64_t total_ghost_cells, max_ghost_cells;
+	// number of bytes of user data a process sends in a neighbor data update
+	uint64_t total_update_bytes, max_update_bytes;
+	// number of cells' neighbors that are on another process than the cell
+	uint64_t edge_cut;
+	// cells with neighbors on other processes divided by all cells
+	double boundary_fraction;
+	// cells and bytes of user data moved between processes the last time cells were moved
+	uint64_t migrated_cells, migrated_bytes;
+
+	Partition_Quality() :
+		imbalance(0),
+		total_weight(0),
+		max_weight(0),
+		total_cells(0),
+		max_cells(0),
+		min_peers(0),
+		max_peers(0),
+		average_peers(0),
+		total_ghost_cells(0),
+		max_ghost_cells(0),
+		total_update_bytes(0),
+		max_update_bytes(0),
+		edge_cut(0),
+		boundary_fraction(0),
+		migrated_cells(0),
+		migrated_bytes(0)
+	{}
+};
+
+
+/*!
+\brief Decision of whether to load balance a grid, see Dccrg::balance_load_if_worthwhile().
+
+Times are in seconds and the same on all processes.
+*/
+class Rebalancing_Decision
+{
+public:
+	// number of steps given to the controller when deciding
+	uint64_t step;
+	// average step time since the previous load balancing of the slowest process and of all processes
+	double max_step_time, average_step_time;
+	// time that perfect balance would save over the horizon and estimated time of load balancing
+	double projected_savings, estimated_cost;
+	bool rebalanced;
+	// measured time of load balancing, 0 if load wasn't balanced
+	double cost;
+
+	Rebalancing_Decision() :
+		step(0),
+		max_step_time(0),
+		average_step_time(0),
+		projected_savings(0),
+		estimated_cost(0),
+		rebalanced(false),
+		cost(0)
+	{}
+
+	/*!
+	Writes the names of CSV columns written by write_csv() into given stream.
+	*/
+	static void write_csv_header(std::ostream& out)
+	{
+		out << "step,max_step_time,average_step_time,projected_savings,estimated_cost,rebalanced,cost\n";
+	}
+
+	/*!
+	Writes this decision as one line in CSV format into given stream.
+	*/
+	void write_csv(std::ostream& out) const
+	{
+		out << this->step << ","
+			<< this->max_step_time << ","
+			<< this->average_step_time << ","
+			<< this->projected_savings << ","
+			<< this->estimated_cost << ","
+			<< (this->rebalanced ? 1 : 0) << ","
+			<< this->cost << "\n";
+	}
+};
+
+
+/*!
+\brief Adds the time between its construction and destruction as one call to a phase.
+
+Does nothing if given statistics is NULL so phases cost one branch when statistics aren't collected.
+*/
+class Phase_Timer
+{
+public:
+	Phase_Timer(Statistics* given_statistics, const char* given_phase) :
+		statistics(given_statistics),
+		phase(given_phase),
+		start_time(0)
+	{
+		if (this->statistics != NULL) {
+			this->start_time = MPI_Wtime();
+		}
+	}
+
+	~Phase_Timer()
+	{
+		if (this->statistics != NULL) {
+			this->statistics->add_phase_call(this->phase, MPI_Wtime() - this->start_time);
+		}
+	}
+
+private:
+	Statistics* statistics;
+	const char* phase;
+	double start_time;
+
+	// not copyable
+	Phase_Timer(const Phase_Timer&);
+	Phase_Timer& operator=(const Phase_Timer&);
+};
+
+}	// namespace
+
+#endif
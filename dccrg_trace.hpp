@@ -0,0 +1,187 @@
+/*
+Binary traces of the communication done by dccrg
+
+Copyright 2009, 2010, 2011, 2012 Finnish Meteorological Institute
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License version 3
+as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DCCRG_TRACE_HPP
+#define DCCRG_TRACE_HPP
+
+#include "cstring"
+#include "istream"
+#include "map"
+#include "ostream"
+#include "stdint.h"
+
+#include "dccrg_statistics.hpp"
+
+namespace dccrg {
+
+/*!
+\brief Identifies trace files, the last character is the version of the format.
+*/
+static const char trace_magic[8] = {'D', 'C', 'C', 'R', 'G', 'T', 'R', '1'};
+
+
+/*!
+\brief Writes the header of a trace file of process with given rank out of given number of processes.
+*/
+inline bool write_trace_header(std::ostream& out, const int rank, const int processes)
+{
+	const int32_t header[2] = {rank, processes};
+	out.write(trace_magic, sizeof(trace_magic));
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+	return out.good();
+}
+
+/*!
+\brief Reads the header of a trace file into given rank and number of processes.
+
+Returns false if the stream doesn't start with a trace header.
+*/
+inline bool read_trace_header(std::istream& in, int& rank, int& processes)
+{
+	char magic[sizeof(trace_magic)];
+	int32_t header[2];
+	in.read(magic, sizeof(magic));
+	in.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (!in.good() || std::memcmp(magic, trace_magic, sizeof(magic)) != 0) {
+		return false;
+	}
+
+	rank = header[0];
+	processes = header[1];
+	return true;
+}
+
+
+/*!
+\brief One user data transfer between processes recorded by Dccrg, see Dccrg::start_tracing().
+
+Times are in seconds from the start of tracing as given by MPI_Wtime().
+The trace stores records in binary in the native byte order of the process.
+*/
+class Trace_Record
+{
+public:
+	// what the transfer was for
+	enum kind_t {
+		NEIGHBOR_UPDATE,
+		MIGRATION,
+		REFINEMENT
+	};
+
+	uint32_t kind;
+	// Dccrg::transfer_policy_t used for the transfer
+	uint32_t policy;
+	// when the transfer started and when its receives and sends completed
+	double start_time, receives_end_time, sends_end_time;
+	// time spent waiting for receives and sends to complete
+	double receive_wait, send_wait;
+	// messages and bytes exchanged with every other process
+	std::map<int, Peer_Statistics> peers;
+
+	Trace_Record() :
+		kind(NEIGHBOR_UPDATE),
+		policy(0),
+		start_time(0),
+		receives_end_time(0),
+		sends_end_time(0),
+		receive_wait(0),
+		send_wait(0)
+	{}
+
+	/*!
+	Appends this record to given stream.
+	*/
+	bool write(std::ostream& out) const
+	{
+		const uint32_t header[3] = {this->kind, this->policy, uint32_t(this->peers.size())};
+		const double times[5] = {
+			this->start_time,
+			this->receives_end_time,
+			this->sends_end_time,
+			this->receive_wait,
+			this->send_wait
+		};
+		out.write(reinterpret_cast<const char*>(header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(times), sizeof(times));
+
+		for (std::map<int, Peer_Statistics>::const_iterator
+			peer = this->peers.begin();
+			peer != this->peers.end();
+			peer++
+		) {
+			const int32_t rank = peer->first;
+			const uint64_t counts[4] = {
+				peer->second.sent_messages,
+				peer->second.sent_bytes,
+				peer->second.received_messages,
+				peer->second.received_bytes
+			};
+			out.write(reinterpret_cast<const char*>(&rank), sizeof(rank));
+			out.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+		}
+
+		return out.good();
+	}
+
+	/*!
+	Reads the next record from given stream into this one.
+
+	Returns false at the end of the stream or if the record is incomplete.
+	*/
+	bool read(std::istream& in)
+	{
+		uint32_t header[3];
+		double times[5];
+		in.read(reinterpret_cast<char*>(header), sizeof(header));
+		in.read(reinterpret_cast<char*>(times), sizeof(times));
+		if (!in.good()) {
+			return false;
+		}
+
+		this->kind = header[0];
+		this->policy = header[1];
+		this->start_time = times[0];
+		this->receives_end_time = times[1];
+		this->sends_end_time = times[2];
+		this->receive_wait = times[3];
+		this->send_wait = times[4];
+
+		this->peers.clear();
+		for (uint32_t i = 0; i < header[2]; i++) {
+			int32_t rank;
+			uint64_t counts[4];
+			in.read(reinterpret_cast<char*>(&rank), sizeof(rank));
+			in.read(reinterpret_cast<char*>(counts), sizeof(counts));
+			if (!in.good()) {
+				return false;
+			}
+
+			Peer_Statistics& peer = this->peers[rank];
+			peer.sent_messages = counts[0];
+			peer.sent_bytes = counts[1];
+			peer.received_messages = counts[2];
+			peer.received_bytes = counts[3];
+		}
+
+		return true;
+	}
+};
+
+}	// namespace
+
+#endif
@@ -897,7 +897,7 @@ int main(int argc, char* argv[])
 	Options
 	*/
 	//char direction;
-	bool verbose = false;
+	bool verbose = false, auto_balance = false;
 	char direction = 'z';
 	unsigned int cells;
 	int max_ref_lvl, save_n, balance_n, adapt_n;
@@ -934,6 +934,7 @@ int main(int argc, char* argv[])
 		("balance-n",
 			boost::program_options::value<int>(&balance_n)->default_value(25),
 			"Balance computational load every argth time step (-1 == never balance load)")
+		("auto-balance", "Balance load when estimated to pay off instead of every balance-n'th time step")
 		("adapt-n",
 			boost::program_options::value<int>(&adapt_n)->default_value(1),
 			"Check for grid adaptation every argth timestep")
@@ -963,6 +964,10 @@ int main(int argc, char* argv[])
 		verbose = true;
 	}
 
+	if (option_variables.count("auto-balance") > 0) {
+		auto_balance = true;
+	}
+
 	// check simulation parameters
 	if (save_n < -1) {
 		cerr << "save_n must be >= -1" << endl;
@@ -1065,6 +1070,11 @@ int main(int argc, char* argv[])
 		grid.balance_load();
 	}
 
+	// decisions are the same on all processes
+	if (auto_balance && verbose && comm.rank() == 0) {
+		grid.set_rebalancing_log(&cout);
+	}
+
 	// apply initial condition 1st time for prerefining the grid
 	initial_condition<Cell>(grid);
 
@@ -1138,7 +1148,8 @@ int main(int argc, char* argv[])
 		// solve inner cells
 		const double inner_solve_start = MPI_Wtime();
 		solve<Cell>(cfl * dt, inner_cells, grid);
-		inner_solve_time += MPI_Wtime() - inner_solve_start;
+		const double step_inner_solve_time = MPI_Wtime() - inner_solve_start;
+		inner_solve_time += step_inner_solve_time;
 
 		// wait for remote neighbor data
 		grid.wait_neighbor_data_update_receives();
@@ -1146,7 +1157,8 @@ int main(int argc, char* argv[])
 		// solve outer cells
 		const double outer_solve_start = MPI_Wtime();
 		solve<Cell>(cfl * dt, outer_cells, grid);
-		outer_solve_time += MPI_Wtime() - outer_solve_start;
+		const double step_outer_solve_time = MPI_Wtime() - outer_solve_start;
+		outer_solve_time += step_outer_solve_time;
 
 		// wait until local data has been sent
 		grid.wait_neighbor_data_update_sends();
@@ -1217,7 +1229,18 @@ int main(int argc, char* argv[])
 		}
 
 		// balance load
-		if (balance_n > 0 && step % balance_n == 0) {
+		if (auto_balance) {
+
+			if (grid.balance_load_if_worthwhile(step_inner_solve_time + step_outer_solve_time)) {
+				if (verbose && comm.rank() == 0) {
+					cout << "Balanced load" << endl;
+				}
+
+				inner_cells = grid.get_cells_with_local_neighbors();
+				outer_cells = grid.get_cells_with_remote_neighbor();
+			}
+
+		} else if (balance_n > 0 && step % balance_n == 0) {
 
 			if (verbose && comm.rank() == 0) {
 				cout << "Balancing load" << endl;
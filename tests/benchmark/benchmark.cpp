@@ -0,0 +1,589 @@
+/*
+Benchmarks the hot paths of dccrg and optionally compares the results to a baseline.
+
+Results are written in CSV format with one line per benchmark, grid size and
+neighborhood size. The time of a benchmark is the slowest process' time
+of the fastest repetition. Returns EXIT_FAILURE if any benchmark is slower
+than in the baseline by more than the given tolerance.
+
+Copyright 2012 Finnish Meteorological Institute
+
+Dccrg is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License version 3
+as published by the Free Software Foundation.
+
+Dccrg is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with dccrg.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "boost/foreach.hpp"
+#include "boost/mpi.hpp"
+#include "boost/program_options.hpp"
+#include "cstdlib"
+#include "fstream"
+#include "functional"
+#include "iostream"
+#include "map"
+#include "sstream"
+#include "string"
+#include "vector"
+#include "zoltan.h"
+
+#include "../../dccrg.hpp"
+
+
+using namespace std;
+using namespace boost::mpi;
+using namespace dccrg;
+
+
+class Cell
+{
+public:
+
+	vector<uint8_t> data;
+
+	static size_t data_size;
+
+	Cell()
+	{
+		this->data.resize(Cell::data_size);
+	}
+
+	// use boost::mpi for data transfers over MPI
+	#ifndef DCCRG_CELL_DATA_SIZE_FROM_USER
+
+	template<typename Archiver> void serialize(
+		Archiver& ar,
+		const unsigned int /*version*/
+	) {
+		ar & data;
+	}
+
+	// use MPI directly for data transfers
+	#else
+
+	void* at(void)
+	{
+		return &(this->data[0]);
+	}
+
+	#ifdef DCCRG_USER_MPI_DATA_TYPE
+	MPI_Datatype mpi_datatype(void) const
+	{
+		MPI_Datatype type;
+		MPI_Type_contiguous(sizeof(uint8_t) * Cell::data_size, MPI_BYTE, &type);
+		return type;
+	}
+	#else
+	static size_t size(void)
+	{
+		return sizeof(uint8_t) * Cell::data_size;
+	}
+	#endif
+
+	#endif	// ifndef DCCRG_CELL_DATA_SIZE_FROM_USER
+};
+
+size_t Cell::data_size = 1;
+
+
+/*!
+Result of one benchmark with one grid size and neighborhood size.
+*/
+class Result
+{
+public:
+	string name;
+	uint64_t grid_size;
+	int neighborhood_size, processes;
+	// number of operations timed per repetition on the slowest process
+	uint64_t operations;
+	double time;
+
+	// identifies the result in a baseline
+	string get_key(void) const
+	{
+		ostringstream key;
+		key << this->name << ","
+			<< this->grid_size << ","
+			<< this->neighborhood_size << ","
+			<< this->processes;
+		return key.str();
+	}
+};
+
+
+string get_policy_name(const Dccrg<Cell>::transfer_policy_t policy)
+{
+	switch (policy) {
+	case Dccrg<Cell>::SINGLE_CELL_TRANSFER:
+		return "single_cell";
+	case Dccrg<Cell>::DATATYPE_TRANSFER:
+		return "datatype";
+	case Dccrg<Cell>::PACKED_TRANSFER:
+		return "packed";
+	case Dccrg<Cell>::SERIALIZED_TRANSFER:
+		return "serialized";
+	case Dccrg<Cell>::NEIGHBORHOOD_TRANSFER:
+		return "neighborhood";
+	case Dccrg<Cell>::SHARED_MEMORY_TRANSFER:
+		return "shared_memory";
+	default:
+		return "automatic";
+	}
+}
+
+
+/*!
+Runs given benchmark given number of times and returns its result.
+
+The benchmark is called with the index of the repetition, returns
+the number of operations it did and stores a value derived from its
+results into checksum so that the work isn't optimized away.
+*/
+template<class Benchmark> Result run(
+	communicator& comm,
+	const string& name,
+	const uint64_t grid_size,
+	const int neighborhood_size,
+	const int repetitions,
+	Benchmark benchmark,
+	double& checksum
+) {
+	Result result;
+	result.name = name;
+	result.grid_size = grid_size;
+	result.neighborhood_size = neighborhood_size;
+	result.processes = comm.size();
+	result.operations = 0;
+	result.time = 0;
+
+	for (int repetition = 0; repetition < repetitions; repetition++) {
+		comm.barrier();
+		const double start_time = MPI_Wtime();
+		const uint64_t operations = benchmark(repetition, checksum);
+		const double time = all_reduce(comm, MPI_Wtime() - start_time, boost::mpi::maximum<double>());
+
+		if (repetition == 0 || time < result.time) {
+			result.time = time;
+			result.operations = all_reduce(comm, operations, boost::mpi::maximum<uint64_t>());
+		}
+	}
+
+	return result;
+}
+
+
+// index math of all local cells
+class Index_Benchmark
+{
+public:
+	Dccrg<Cell>* grid;
+
+	uint64_t operator()(const int, double& checksum) const
+	{
+		const vector<uint64_t> cells = this->grid->get_cells();
+		BOOST_FOREACH(const uint64_t& cell, cells) {
+			const Types<3>::indices_t indices = this->grid->get_indices(cell);
+			const int refinement_level = this->grid->get_refinement_level(cell);
+			checksum += this->grid->get_cell_from_indices(indices, refinement_level)
+				+ this->grid->get_cell_size_in_indices(cell)
+				+ this->grid->get_parent(cell);
+		}
+		return cells.size();
+	}
+};
+
+// parents, children and siblings of all local cells
+class Octree_Benchmark
+{
+public:
+	Dccrg<Cell>* grid;
+
+	uint64_t operator()(const int, double& checksum) const
+	{
+		const vector<uint64_t> cells = this->grid->get_cells();
+		boost::array<uint64_t, 8> children, siblings;
+		BOOST_FOREACH(const uint64_t& cell, cells) {
+			checksum += this->grid->get_octree_parent(cell)
+				+ this->grid->get_octree_first_child(cell);
+			if (this->grid->get_octree_children(cell, children)) {
+				checksum += children[7];
+			}
+			if (this->grid->get_octree_siblings(cell, siblings)) {
+				checksum += siblings[7];
+			}
+		}
+		return cells.size();
+	}
+};
+
+// geometry queries of all local cells
+class Geometry_Benchmark
+{
+public:
+	Dccrg<Cell>* grid;
+
+	uint64_t operator()(const int, double& checksum) const
+	{
+		const vector<uint64_t> cells = this->grid->get_cells();
+		BOOST_FOREACH(const uint64_t& cell, cells) {
+			checksum += this->grid->get_cell_x(cell)
+				+ this->grid->get_cell_y(cell)
+				+ this->grid->get_cell_z(cell)
+				+ this->grid->get_cell_x_size(cell)
+				+ this->grid->get_cell_y_size(cell)
+				+ this->grid->get_cell_z_size(cell);
+		}
+		return cells.size();
+	}
+};
+
+// neighbor search of all local cells without existing neighbor lists
+class Find_Neighbors_Benchmark
+{
+public:
+	Dccrg<Cell>* grid;
+
+	uint64_t operator()(const int, double& checksum) const
+	{
+		const vector<uint64_t> cells = this->grid->get_cells();
+		vector<uint64_t> neighbors;
+		BOOST_FOREACH(const uint64_t& cell, cells) {
+			this->grid->find_neighbors_of(cell, neighbors);
+			checksum += neighbors.size();
+		}
+		return cells.size();
+	}
+};
+
+// finding the cell at the center of every local cell
+class Existing_Cell_Benchmark
+{
+public:
+	Dccrg<Cell>* grid;
+
+	uint64_t operator()(const int, double& checksum) const
+	{
+		const vector<uint64_t> cells = this->grid->get_cells();
+		BOOST_FOREACH(const uint64_t& cell, cells) {
+			checksum += this->grid->get_existing_cell(
+				this->grid->get_cell_x(cell),
+				this->grid->get_cell_y(cell),
+				this->grid->get_cell_z(cell)
+			);
+		}
+		return cells.size();
+	}
+};
+
+// neighbor data updates with one transfer policy
+class Neighbor_Update_Benchmark
+{
+public:
+	Dccrg<Cell>* grid;
+	Dccrg<Cell>::transfer_policy_t policy;
+	int updates;
+
+	uint64_t operator()(const int, double& checksum) const
+	{
+		for (int i = 0; i < this->updates; i++) {
+			this->grid->update_remote_neighbor_data(this->policy);
+		}
+		checksum += this->grid->get_remote_cells_with_local_neighbors()->size();
+		return this->updates;
+	}
+};
+
+// moving all cells to random processes
+class Balance_Load_Benchmark
+{
+public:
+	Dccrg<Cell>* grid;
+
+	uint64_t operator()(const int, double& checksum) const
+	{
+		this->grid->balance_load();
+		checksum += this->grid->get_cells().size();
+		return 1;
+	}
+};
+
+// refining every fourth local cell and unrefining them again
+class Refine_Benchmark
+{
+public:
+	Dccrg<Cell>* grid;
+
+	uint64_t operator()(const int, double& checksum) const
+	{
+		const vector<uint64_t> cells = this->grid->get_cells();
+		for (size_t i = 0; i < cells.size(); i += 4) {
+			this->grid->refine_completely(cells[i]);
+		}
+		const vector<uint64_t> new_cells = this->grid->stop_refining();
+		checksum += new_cells.size();
+
+		BOOST_FOREACH(const uint64_t& cell, new_cells) {
+			this->grid->unrefine_completely(cell);
+		}
+		checksum += this->grid->stop_refining().size();
+
+		return 1;
+	}
+};
+
+
+/*!
+Reads results from given CSV file into given map with Result::get_key() as the key.
+
+Returns false if the file couldn't be read.
+*/
+bool read_baseline(const string& file_name, map<string, Result>& baseline)
+{
+	ifstream infile(file_name.c_str());
+	if (!infile.is_open()) {
+		return false;
+	}
+
+	string line;
+	// header
+	getline(infile, line);
+	while (getline(infile, line)) {
+		for (size_t i = 0; i < line.size(); i++) {
+			if (line[i] == ',') {
+				line[i] = ' ';
+			}
+		}
+
+		Result result;
+		double time_per_operation;
+		istringstream fields(line);
+		fields >> result.name
+			>> result.grid_size
+			>> result.neighborhood_size
+			>> result.processes
+			>> result.operations
+			>> result.time
+			>> time_per_operation;
+		if (fields.fail()) {
+			return false;
+		}
+
+		baseline[result.get_key()] = result;
+	}
+
+	return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+	environment env(argc, argv);
+	communicator comm;
+
+	float zoltan_version;
+	if (Zoltan_Initialize(argc, argv, &zoltan_version) != ZOLTAN_OK) {
+	    cout << "Zoltan_Initialize failed" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	vector<uint64_t> grid_sizes;
+	vector<int> neighborhood_sizes;
+	int repetitions, updates;
+	double tolerance;
+	string output_name, baseline_name;
+
+	boost::program_options::options_description options("Usage: program_name [options], where options are:");
+	options.add_options()
+		("help", "print this help message")
+		("grid-size",
+			boost::program_options::value<vector<uint64_t> >(&grid_sizes)->multitoken(),
+			"Benchmark grids of arg^3 unrefined cells, can be given several times (default 10 20)")
+		("neighborhood-size",
+			boost::program_options::value<vector<int> >(&neighborhood_sizes)->multitoken(),
+			"Benchmark neighborhoods of arg cells, can be given several times (default 1 2)")
+		("data-size",
+			boost::program_options::value<size_t>(&Cell::data_size)->default_value(8),
+			"Number of bytes of user data in every cell")
+		("repetitions",
+			boost::program_options::value<int>(&repetitions)->default_value(3),
+			"Run every benchmark arg times and use the fastest repetition")
+		("updates",
+			boost::program_options::value<int>(&updates)->default_value(10),
+			"Number of neighbor data updates per repetition")
+		("output",
+			boost::program_options::value<string>(&output_name)->default_value("benchmark.csv"),
+			"Write results into file arg")
+		("baseline",
+			boost::program_options::value<string>(&baseline_name)->default_value(""),
+			"Compare results to those in file arg written by an earlier run")
+		("tolerance",
+			boost::program_options::value<double>(&tolerance)->default_value(0.2),
+			"Report a regression if a benchmark is slower than its baseline by more than this fraction");
+
+	boost::program_options::variables_map option_variables;
+	boost::program_options::store(boost::program_options::parse_command_line(argc, argv, options), option_variables);
+	boost::program_options::notify(option_variables);
+
+	if (option_variables.count("help") > 0) {
+		if (comm.rank() == 0) {
+			cout << options << endl;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	if (grid_sizes.size() == 0) {
+		grid_sizes.push_back(10);
+		grid_sizes.push_back(20);
+	}
+	if (neighborhood_sizes.size() == 0) {
+		neighborhood_sizes.push_back(1);
+		neighborhood_sizes.push_back(2);
+	}
+	if (repetitions < 1 || updates < 1 || Cell::data_size == 0) {
+		if (comm.rank() == 0) {
+			cerr << "Repetitions, updates and data size must be > 0" << endl;
+		}
+		return EXIT_FAILURE;
+	}
+
+	vector<Result> results;
+	double checksum = 0;
+
+	BOOST_FOREACH(const uint64_t& grid_size, grid_sizes) {
+	BOOST_FOREACH(const int& neighborhood_size, neighborhood_sizes) {
+
+		Dccrg<Cell> grid;
+		grid.set_geometry(grid_size, grid_size, grid_size, 0, 0, 0, 1, 1, 1);
+		grid.initialize(comm, "RCB", neighborhood_size, 1);
+
+		// refine a corner so that searches cross refinement levels
+		const vector<uint64_t> cells = grid.get_cells();
+		BOOST_FOREACH(const uint64_t& cell, cells) {
+			if (grid.get_cell_x(cell) < grid_size / 4.0
+			&& grid.get_cell_y(cell) < grid_size / 4.0
+			&& grid.get_cell_z(cell) < grid_size / 4.0) {
+				grid.refine_completely(cell);
+			}
+		}
+		grid.stop_refining();
+		grid.balance_load();
+
+		Index_Benchmark index;
+		index.grid = &grid;
+		results.push_back(run(comm, "index", grid_size, neighborhood_size, repetitions, index, checksum));
+
+		Octree_Benchmark octree;
+		octree.grid = &grid;
+		results.push_back(run(comm, "octree", grid_size, neighborhood_size, repetitions, octree, checksum));
+
+		Geometry_Benchmark geometry;
+		geometry.grid = &grid;
+		results.push_back(run(comm, "geometry", grid_size, neighborhood_size, repetitions, geometry, checksum));
+
+		Find_Neighbors_Benchmark find_neighbors;
+		find_neighbors.grid = &grid;
+		results.push_back(run(comm, "find_neighbors_of", grid_size, neighborhood_size, repetitions, find_neighbors, checksum));
+
+		Existing_Cell_Benchmark existing_cell;
+		existing_cell.grid = &grid;
+		results.push_back(run(comm, "get_existing_cell", grid_size, neighborhood_size, repetitions, existing_cell, checksum));
+
+		const vector<Dccrg<Cell>::transfer_policy_t> policies = grid.get_transfer_policies();
+		BOOST_FOREACH(const Dccrg<Cell>::transfer_policy_t& policy, policies) {
+			Neighbor_Update_Benchmark neighbor_update;
+			neighbor_update.grid = &grid;
+			neighbor_update.policy = policy;
+			neighbor_update.updates = updates;
+			results.push_back(run(
+				comm,
+				"neighbor_update_" + get_policy_name(policy),
+				grid_size,
+				neighborhood_size,
+				repetitions,
+				neighbor_update,
+				checksum
+			));
+		}
+
+		Refine_Benchmark refine;
+		refine.grid = &grid;
+		results.push_back(run(comm, "refine_unrefine", grid_size, neighborhood_size, repetitions, refine, checksum));
+
+		Dccrg<Cell> random_grid;
+		random_grid.set_geometry(grid_size, grid_size, grid_size, 0, 0, 0, 1, 1, 1);
+		random_grid.initialize(comm, "RANDOM", neighborhood_size, 0);
+
+		Balance_Load_Benchmark balance_load;
+		balance_load.grid = &random_grid;
+		results.push_back(run(comm, "balance_load", grid_size, neighborhood_size, repetitions, balance_load, checksum));
+	}}
+
+	int regressions = 0;
+	if (comm.rank() == 0) {
+		ofstream outfile(output_name.c_str());
+		if (!outfile.is_open()) {
+			cerr << "Couldn't open file " << output_name << endl;
+			abort();
+		}
+
+		const string header("name,grid_size,neighborhood_size,processes,operations,time,time_per_operation");
+		outfile << header << "\n";
+		cout << header << endl;
+
+		BOOST_FOREACH(const Result& result, results) {
+			ostringstream line;
+			line << result.get_key() << ","
+				<< result.operations << ","
+				<< result.time << ","
+				<< result.time / result.operations;
+			outfile << line.str() << "\n";
+			cout << line.str() << endl;
+		}
+
+		if (baseline_name != "") {
+			map<string, Result> baseline;
+			if (!read_baseline(baseline_name, baseline)) {
+				cerr << "Couldn't read baseline from " << baseline_name << endl;
+				abort();
+			}
+
+			BOOST_FOREACH(const Result& result, results) {
+				if (baseline.count(result.get_key()) == 0) {
+					cout << "No baseline for " << result.get_key() << endl;
+					continue;
+				}
+
+				const Result& old = baseline.at(result.get_key());
+				const double
+					old_time = old.time / old.operations,
+					new_time = result.time / result.operations;
+
+				if (new_time > old_time * (1 + tolerance)) {
+					cout << "Regression in " << result.get_key()
+						<< ": " << new_time << " s per operation instead of " << old_time
+						<< endl;
+					regressions++;
+				}
+			}
+			cout << regressions << " regressions" << endl;
+		}
+
+		// prevents optimizing away the benchmarked work
+		cerr << "Checksum " << checksum << endl;
+	}
+
+	broadcast(comm, regressions, 0);
+	if (regressions > 0) {
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
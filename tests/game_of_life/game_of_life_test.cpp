@@ -40,6 +40,71 @@ using namespace boost::mpi;
 using namespace dccrg;
 
 
+/*!
+Checks that for_each_cell gives the same cells, data and neighbors as the rest of the grid's interface.
+
+Also checks that the data of every neighbor has arrived by requiring that
+the neighbor's data[12] is the given marker set on every cell before the
+neighbor data update.
+*/
+class Check_Iteration_Data
+{
+public:
+	const Dccrg<Cell, ArbitraryGeometry>& grid;
+	const uint64_t marker;
+	uint64_t checked_cells;
+
+	Check_Iteration_Data(const Dccrg<Cell, ArbitraryGeometry>& given_grid, const uint64_t given_marker) :
+		grid(given_grid),
+		marker(given_marker),
+		checked_cells(0)
+	{}
+
+	void operator()(
+		const uint64_t cell,
+		Cell& data,
+		const Dccrg<Cell, ArbitraryGeometry>::neighbor_and_data_t* neighbors_begin,
+		const Dccrg<Cell, ArbitraryGeometry>::neighbor_and_data_t* neighbors_end
+	) {
+		if (&data != this->grid[cell]) {
+			cerr << "Wrong data for cell " << cell << endl;
+			abort();
+		}
+
+		const vector<uint64_t>* neighbors = this->grid.get_neighbors(cell);
+		if (neighbors->size() != size_t(neighbors_end - neighbors_begin)) {
+			cerr << "Wrong number of neighbors for cell " << cell << endl;
+			abort();
+		}
+
+		for (size_t i = 0; i < neighbors->size(); i++) {
+			const uint64_t neighbor = (*neighbors)[i];
+
+			if (neighbors_begin[i].first != neighbor) {
+				cerr << "Wrong neighbor for cell " << cell << ": " << neighbors_begin[i].first << endl;
+				abort();
+			}
+
+			if ((neighbor == 0 && neighbors_begin[i].second != NULL)
+			|| (neighbor != 0 && neighbors_begin[i].second != this->grid[neighbor])) {
+				cerr << "Wrong data for neighbor " << neighbor << " of cell " << cell << endl;
+				abort();
+			}
+
+			if (neighbor != 0 && neighbors_begin[i].second->data[12] != this->marker) {
+				cerr << "Data of neighbor " << neighbor << " of cell " << cell
+					<< " hasn't arrived: " << neighbors_begin[i].second->data[12]
+					<< ", should be " << this->marker
+					<< endl;
+				abort();
+			}
+		}
+
+		this->checked_cells++;
+	}
+};
+
+
 /*!
 Returns EXIT_SUCCESS if the state of the given game at given timestep is correct on this process, returns EXIT_FAILURE otherwise.
 timestep == 0 means before any turns have been taken.
@@ -355,6 +420,12 @@ int main(int argc, char* argv[])
 		visit_file << "!NBLOCKS " << comm.size() << endl;
 	}
 
+	// try every transfer policy in turn and let the grid choose between them otherwise
+	const vector<Dccrg<Cell, ArbitraryGeometry>::transfer_policy_t> policies = game_grid.get_transfer_policies();
+	game_grid.set_transfer_policy(game_grid.AUTOMATIC_TRANSFER);
+	// also coalesce single cell messages
+	game_grid.set_single_cell_transfer_limits(4, 3);
+
 	const int time_steps = 25;
 	if (verbose && comm.rank() == 0) {
 		cout << "step: ";
@@ -362,10 +433,56 @@ int main(int argc, char* argv[])
 	for (int step = 0; step < time_steps; step++) {
 
 		game_grid.balance_load();
-		game_grid.start_remote_neighbor_data_update();
-		game_grid.wait_neighbor_data_update();
 		vector<uint64_t> cells = game_grid.get_cells();
 
+		// unused by solve in an unrefined grid until it clears the data after the update
+		const uint64_t marker = step + 1;
+		for (vector<uint64_t>::const_iterator
+			cell = cells.begin();
+			cell != cells.end();
+			cell++
+		) {
+			game_grid[*cell]->data[12] = marker;
+		}
+
+		// alternate between updating remote neighbor data with and without processing cells
+		if (step % 2 == 0) {
+			game_grid.start_remote_neighbor_data_update(policies[(step / 2) % policies.size()]);
+			game_grid.wait_neighbor_data_update();
+		} else if (game_grid.update_remote_neighbor_data(Check_Iteration_Data(game_grid, marker)).checked_cells != cells.size()) {
+			cout << "Process " << comm.rank() << ": Wrong number of cells processed during update on timestep: " << step << endl;
+			abort();
+		}
+
+		if (game_grid.for_each_cell(game_grid.INNER_CELLS, Check_Iteration_Data(game_grid, marker)).checked_cells != game_grid.get_cells_with_local_neighbors().size()
+		|| game_grid.for_each_cell(game_grid.OUTER_CELLS, Check_Iteration_Data(game_grid, marker)).checked_cells != game_grid.get_cells_with_remote_neighbor().size()
+		|| game_grid.for_each_cell(game_grid.ALL_CELLS, Check_Iteration_Data(game_grid, marker)).checked_cells != cells.size()) {
+			cout << "Process " << comm.rank() << ": Wrong number of cells iterated on timestep: " << step << endl;
+			abort();
+		}
+
+		// tags of coalesced single cell messages must be consecutive
+		const boost::unordered_map<int, vector<pair<uint64_t, int> > > tagged_lists = game_grid.get_tagged_send_lists();
+		for (boost::unordered_map<int, vector<pair<uint64_t, int> > >::const_iterator
+			receiver = tagged_lists.begin();
+			receiver != tagged_lists.end();
+			receiver++
+		) {
+			int previous_tag = 0;
+			for (vector<pair<uint64_t, int> >::const_iterator
+				item = receiver->second.begin();
+				item != receiver->second.end();
+				item++
+			) {
+				if (item->second != previous_tag && item->second != previous_tag + 1) {
+					cout << "Process " << comm.rank() << ": Wrong message tag " << item->second
+						<< " for cell " << item->first << " on timestep: " << step << endl;
+					abort();
+				}
+				previous_tag = item->second;
+			}
+		}
+
 		int result = check_game_of_life_state(step, game_grid);
 		if (grid_size != 15 || result != EXIT_SUCCESS) {
 			cout << "Process " << comm.rank() << ": Game of Life test failed on timestep: " << step << endl;
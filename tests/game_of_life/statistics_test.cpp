@@ -0,0 +1,165 @@
+/*
+Tests the phase timers and communication counters of dccrg.
+Returns EXIT_SUCCESS if everything went ok.
+*/
+
+#include "boost/mpi.hpp"
+#include "cstdio"
+#include "cstdlib"
+#include "fstream"
+#include "iostream"
+#include "map"
+#include "sstream"
+#include "string"
+#include "zoltan.h"
+
+#include "../../dccrg.hpp"
+
+
+using namespace std;
+using namespace boost::mpi;
+using namespace dccrg;
+
+
+static void check_phase(const Statistics& statistics, const string& phase, const int rank)
+{
+	if (statistics.phases.count(phase) == 0
+	|| statistics.phases.at(phase).calls == 0
+	|| statistics.phases.at(phase).time < 0) {
+		cerr << "Process " << rank << ": Phase " << phase << " wasn't timed" << endl;
+		abort();
+	}
+}
+
+// does nothing to cells given by dccrg
+class Skip_Cells
+{
+public:
+	void operator()(
+		const uint64_t,
+		int&,
+		const Dccrg<int>::neighbor_and_data_t*,
+		const Dccrg<int>::neighbor_and_data_t*
+	) {}
+};
+
+int main(int argc, char* argv[])
+{
+	environment env(argc, argv);
+	communicator comm;
+
+	float zoltan_version;
+	if (Zoltan_Initialize(argc, argv, &zoltan_version) != ZOLTAN_OK) {
+	    cout << "Zoltan_Initialize failed" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	Dccrg<int> grid;
+	grid.set_geometry(10, 10, 1, 0, 0, 0, 1, 1, 1);
+	grid.set_statistics_collection(true);
+	grid.initialize(comm, "RCB", 1, 1);
+
+	grid.refine_completely(grid.get_cells()[0]);
+	grid.stop_refining();
+	grid.balance_load();
+	grid.update_remote_neighbor_data();
+
+	const Statistics& statistics = grid.get_statistics();
+	check_phase(statistics, "neighbor_lists", comm.rank());
+	check_phase(statistics, "remote_neighbor_info", comm.rank());
+	check_phase(statistics, "send_receive_lists", comm.rank());
+	check_phase(statistics, "partition", comm.rank());
+	check_phase(statistics, "migration", comm.rank());
+	check_phase(statistics, "induce_refines", comm.rank());
+	check_phase(statistics, "override_unrefines", comm.rank());
+	check_phase(statistics, "execute_refines", comm.rank());
+	check_phase(statistics, "neighbor_update_start", comm.rank());
+	check_phase(statistics, "neighbor_update_wait_receives", comm.rank());
+	check_phase(statistics, "neighbor_update_wait_sends", comm.rank());
+
+	// every byte and message sent must be received by someone
+	uint64_t sent_bytes = 0, received_bytes = 0, sent_messages = 0, received_messages = 0;
+	for (map<int, Peer_Statistics>::const_iterator
+		peer = statistics.peers.begin();
+		peer != statistics.peers.end();
+		peer++
+	) {
+		if (peer->first == comm.rank()) {
+			cerr << "Process " << comm.rank() << ": Transfers to self were counted" << endl;
+			abort();
+		}
+
+		sent_bytes += peer->second.sent_bytes;
+		received_bytes += peer->second.received_bytes;
+		sent_messages += peer->second.sent_messages;
+		received_messages += peer->second.received_messages;
+	}
+
+	if (all_reduce(comm, sent_bytes, plus<uint64_t>()) != all_reduce(comm, received_bytes, plus<uint64_t>())
+	|| all_reduce(comm, sent_messages, plus<uint64_t>()) != all_reduce(comm, received_messages, plus<uint64_t>())) {
+		cerr << "Process " << comm.rank() << ": Sent and received data don't match" << endl;
+		abort();
+	}
+
+	if (comm.size() > 1 && all_reduce(comm, sent_bytes, plus<uint64_t>()) == 0) {
+		cerr << "Process " << comm.rank() << ": No transfers were counted" << endl;
+		abort();
+	}
+
+	// dumps
+	const string prefix("statistics_test");
+	if (!grid.write_statistics(prefix) || !grid.write_statistics(prefix, true)) {
+		cerr << "Process " << comm.rank() << ": Couldn't write statistics" << endl;
+		abort();
+	}
+
+	ostringstream csv_name, json_name;
+	csv_name << prefix << "_" << comm.rank() << ".csv";
+	json_name << prefix << "_" << comm.rank() << ".json";
+
+	ifstream csv(csv_name.str().c_str());
+	string line;
+	int lines = 0;
+	while (getline(csv, line)) {
+		lines++;
+	}
+	csv.close();
+	if (lines != int(1 + statistics.phases.size() + statistics.peers.size())) {
+		cerr << "Process " << comm.rank() << ": Wrong number of lines in " << csv_name.str() << ": " << lines << endl;
+		abort();
+	}
+
+	remove(csv_name.str().c_str());
+	remove(json_name.str().c_str());
+
+	// waiting is timed also when cells are processed during the update
+	grid.clear_statistics();
+	grid.update_remote_neighbor_data(Skip_Cells());
+	if (comm.size() > 1) {
+		check_phase(statistics, "user_data_wait", comm.rank());
+		check_phase(statistics, "neighbor_update_wait_receives", comm.rank());
+
+		// one update is one call regardless of how many times arrived data was checked
+		if (statistics.phases.at("user_data_wait").calls != 1
+		|| statistics.phases.at("neighbor_update_wait_receives").calls != 1) {
+			cerr << "Process " << comm.rank() << ": Waiting was recorded more than once per update" << endl;
+			abort();
+		}
+	}
+
+	// nothing is collected when disabled
+	grid.clear_statistics();
+	grid.set_statistics_collection(false);
+	grid.update_remote_neighbor_data();
+	grid.balance_load();
+	if (statistics.phases.size() > 0 || statistics.peers.size() > 0) {
+		cerr << "Process " << comm.rank() << ": Statistics were collected while disabled" << endl;
+		abort();
+	}
+
+	if (comm.rank() == 0) {
+		cout << "Passed" << endl;
+	}
+
+	return EXIT_SUCCESS;
+}
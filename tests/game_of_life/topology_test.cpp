@@ -0,0 +1,76 @@
+/*
+Tests hierarchical load balancing with levels derived from the hardware topology.
+Returns EXIT_SUCCESS if everything went ok.
+*/
+
+#include "boost/mpi.hpp"
+#include "cstdlib"
+#include "iostream"
+#include "zoltan.h"
+
+#include "../../dccrg.hpp"
+
+
+using namespace std;
+using namespace boost::mpi;
+using namespace dccrg;
+
+
+int main(int argc, char* argv[])
+{
+	environment env(argc, argv);
+	communicator comm;
+
+	float zoltan_version;
+	if (Zoltan_Initialize(argc, argv, &zoltan_version) != ZOLTAN_OK) {
+	    cout << "Zoltan_Initialize failed" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	Dccrg<int> grid;
+	grid.set_geometry(20, 20, 1, 0, 0, 0, 1, 1, 1);
+	grid.initialize(comm, "HIER", 1);
+
+	// user given levels are replaced
+	grid.add_partitioning_level(12);
+	grid.add_topology_partitioning_levels();
+
+	const int levels = grid.get_number_of_partitioning_levels();
+	if (levels < 1 || levels > 3) {
+		cerr << "Process " << comm.rank() << ": Wrong number of partitioning levels: " << levels << endl;
+		abort();
+	}
+
+	if (all_reduce(comm, levels, boost::mpi::maximum<int>()) != levels) {
+		cerr << "Process " << comm.rank() << ": Processes have different numbers of partitioning levels" << endl;
+		abort();
+	}
+
+	for (int level = 0; level < levels; level++) {
+		if (grid.get_partitioning_option_value(level, "LB_METHOD") == "") {
+			cerr << "Process " << comm.rank() << ": No LB_METHOD for partitioning level " << level << endl;
+			abort();
+		}
+	}
+
+	grid.add_partitioning_option(levels - 1, "LB_METHOD", "RIB");
+	if (grid.get_partitioning_option_value(levels - 1, "LB_METHOD") != "RIB") {
+		cerr << "Process " << comm.rank() << ": Partitioning option wasn't changed" << endl;
+		abort();
+	}
+
+	grid.balance_load();
+
+	const uint64_t total_cells = all_reduce(comm, uint64_t(grid.get_cells().size()), plus<uint64_t>());
+	if (total_cells != 20 * 20) {
+		cerr << "Process " << comm.rank() << ": Grid has " << total_cells << " cells after load balancing" << endl;
+		abort();
+	}
+
+	if (comm.rank() == 0) {
+		cout << levels << " partitioning levels" << endl;
+		cout << "Passed" << endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -2,9 +2,11 @@
 Tests the speed of geometry operations with a constant cell size grid
 */
 
+#include "cstdlib"
 #include "ctime"
 #include "iostream"
 #include "stdint.h"
+#include "vector"
 
 #include "../../dccrg_constant_geometry.hpp"
 
@@ -85,5 +87,84 @@ int main(void)
 	cout << "\tAverage cell z position: " << avg_pos;
 	cout << ", time for " << double(CELLS) << " cells: " << double(after - before) / CLOCKS_PER_SEC << " s" << endl;
 
+	// batch versions process cells in chunks that fit into cache
+	#define CHUNK 4096
+	vector<uint64_t> cells(CHUNK);
+	vector<double> x(CHUNK), y(CHUNK), z(CHUNK);
+
+	double avg_sizes[3] = {0, 0, 0};
+	before = clock();
+	for (uint64_t first = 1; first <= CELLS; first += CHUNK) {
+		for (uint64_t i = 0; i < CHUNK; i++) {
+			cells[i] = first + i;
+		}
+		geometry.get_cell_sizes(&cells[0], CHUNK, &x[0], &y[0], &z[0]);
+		for (uint64_t i = 0; i < CHUNK && first + i <= CELLS; i++) {
+			avg_sizes[0] += x[i];
+			avg_sizes[1] += y[i];
+			avg_sizes[2] += z[i];
+		}
+	}
+	after = clock();
+	cout << "\tAverage cell x, y, z size: "
+		<< avg_sizes[0] / CELLS << ", "
+		<< avg_sizes[1] / CELLS << ", "
+		<< avg_sizes[2] / CELLS;
+	cout << ", time for " << double(CELLS) << " cells in batches: " << double(after - before) / CLOCKS_PER_SEC << " s" << endl;
+
+	double avg_positions[3] = {0, 0, 0};
+	before = clock();
+	for (uint64_t first = 1; first <= CELLS; first += CHUNK) {
+		for (uint64_t i = 0; i < CHUNK; i++) {
+			cells[i] = first + i;
+		}
+		geometry.get_cell_centers(&cells[0], CHUNK, &x[0], &y[0], &z[0]);
+		for (uint64_t i = 0; i < CHUNK && first + i <= CELLS; i++) {
+			avg_positions[0] += x[i];
+			avg_positions[1] += y[i];
+			avg_positions[2] += z[i];
+		}
+	}
+	after = clock();
+	cout << "\tAverage cell x, y, z position: "
+		<< avg_positions[0] / CELLS << ", "
+		<< avg_positions[1] / CELLS << ", "
+		<< avg_positions[2] / CELLS;
+	cout << ", time for " << double(CELLS) << " cells in batches: " << double(after - before) / CLOCKS_PER_SEC << " s" << endl;
+
+	// batch versions must give identical results, also for cells of every refinement level
+	cells.clear();
+	for (int refinement_level = 0; refinement_level <= geometry.get_maximum_refinement_level(); refinement_level++) {
+		const uint64_t first = geometry.get_cell_from_indices(0, 0, 0, refinement_level);
+		cells.push_back(first);
+		cells.push_back(first + 12345);
+		cells.push_back(geometry.get_cell(refinement_level, 99.9, 219.9, 359.9));
+	}
+	cells.push_back(0);
+
+	vector<double> x_sizes(cells.size()), y_sizes(cells.size()), z_sizes(cells.size());
+	x.resize(cells.size());
+	y.resize(cells.size());
+	z.resize(cells.size());
+	geometry.get_cell_centers(&cells[0], cells.size(), &x[0], &y[0], &z[0]);
+	geometry.get_cell_sizes(&cells[0], cells.size(), &x_sizes[0], &y_sizes[0], &z_sizes[0]);
+
+	for (size_t i = 0; i < cells.size() - 1; i++) {
+		if (x[i] != geometry.get_cell_x(cells[i])
+		|| y[i] != geometry.get_cell_y(cells[i])
+		|| z[i] != geometry.get_cell_z(cells[i])
+		|| x_sizes[i] != geometry.get_cell_x_size(cells[i])
+		|| y_sizes[i] != geometry.get_cell_y_size(cells[i])
+		|| z_sizes[i] != geometry.get_cell_z_size(cells[i])) {
+			cerr << "Batch geometry of cell " << cells[i] << " differs from the geometry of one cell" << endl;
+			abort();
+		}
+	}
+
+	if (x.back() == x.back() || x_sizes.back() == x_sizes.back()) {
+		cerr << "Batch geometry of an invalid cell isn't NaN" << endl;
+		abort();
+	}
+
 	return 0;
 }
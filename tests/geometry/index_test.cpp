@@ -0,0 +1,167 @@
+/*
+Tests the mapping between cells and their indices and the octree topology of cells.
+Define DCCRG_MORTON_ORDER to test the Morton ordered numbering.
+Returns EXIT_SUCCESS if everything went ok.
+*/
+
+#include "algorithm"
+#include "cstdlib"
+#include "iostream"
+#include "stdint.h"
+#include "vector"
+
+#include "../../dccrg_index.hpp"
+
+using namespace std;
+using namespace dccrg;
+
+int main(void)
+{
+	Index index;
+	if (!index.set_length(3, 5, 2) || !index.set_maximum_refinement_level(3)) {
+		cerr << "Couldn't set grid size" << endl;
+		abort();
+	}
+
+	// every cell maps to unique indices and back
+	uint64_t cells = 0;
+	for (int refinement_level = 0; refinement_level <= index.get_maximum_refinement_level(); refinement_level++) {
+		const uint64_t size_in_indices = uint64_t(1) << (index.get_maximum_refinement_level() - refinement_level);
+
+		for (uint64_t z = 0; z < index.get_z_length() << index.get_maximum_refinement_level(); z += size_in_indices)
+		for (uint64_t y = 0; y < index.get_y_length() << index.get_maximum_refinement_level(); y += size_in_indices)
+		for (uint64_t x = 0; x < index.get_x_length() << index.get_maximum_refinement_level(); x += size_in_indices) {
+			const uint64_t cell = index.get_cell_from_indices(x, y, z, refinement_level);
+			const Types<3>::indices_t indices = index.get_indices(cell);
+
+			if (cell == error_cell
+			|| index.get_refinement_level(cell) != refinement_level
+			|| indices[0] != x
+			|| indices[1] != y
+			|| indices[2] != z) {
+				cerr << "Cell " << cell
+					<< " of refinement level " << refinement_level
+					<< " at indices " << x << " " << y << " " << z
+					<< " maps to refinement level " << index.get_refinement_level(cell)
+					<< " and indices " << indices[0] << " " << indices[1] << " " << indices[2]
+					<< endl;
+				abort();
+			}
+
+			cells++;
+		}
+	}
+
+	// cells are numbered consecutively
+	if (index.get_cell_from_indices(0, 0, 0, 0) != 1
+	|| index.get_refinement_level(cells) != index.get_maximum_refinement_level()
+	|| index.get_refinement_level(cells + 1) != -1) {
+		cerr << "Cells aren't numbered from 1 to " << cells << endl;
+		abort();
+	}
+
+	// unrefined cells are always in row-major order
+	if (index.get_cell_from_indices(8, 0, 0, 0) != 2
+	|| index.get_cell_from_indices(0, 8, 0, 0) != 4
+	|| index.get_cell_from_indices(0, 0, 8, 0) != 16) {
+		cerr << "Unrefined cells aren't in row-major order" << endl;
+		abort();
+	}
+
+	// octree topology agrees with indices
+	for (uint64_t cell = 1; cell <= cells; cell++) {
+		const Types<3>::indices_t indices = index.get_indices(cell);
+		const int refinement_level = index.get_refinement_level(cell);
+
+		const uint64_t parent = (refinement_level == 0)
+			? cell
+			: index.get_cell_from_indices(indices, refinement_level - 1);
+		if (index.get_octree_parent(cell) != parent) {
+			cerr << "Wrong parent for cell " << cell << endl;
+			abort();
+		}
+
+		boost::array<uint64_t, 8> children, siblings;
+		if (refinement_level == index.get_maximum_refinement_level()) {
+			if (index.get_octree_children(cell, children)
+			|| index.get_octree_first_child(cell) != error_cell) {
+				cerr << "Cell " << cell << " of maximum refinement level has children" << endl;
+				abort();
+			}
+		} else {
+			if (!index.get_octree_children(cell, children)) {
+				cerr << "No children for cell " << cell << endl;
+				abort();
+			}
+
+			const uint64_t child_size = uint64_t(1) << (index.get_maximum_refinement_level() - refinement_level - 1);
+			int child = 0;
+			for (uint64_t z = 0; z < 2; z++)
+			for (uint64_t y = 0; y < 2; y++)
+			for (uint64_t x = 0; x < 2; x++) {
+				if (children[child] != index.get_cell_from_indices(
+					indices[0] + x * child_size,
+					indices[1] + y * child_size,
+					indices[2] + z * child_size,
+					refinement_level + 1
+				)) {
+					cerr << "Wrong child " << child << " for cell " << cell << endl;
+					abort();
+				}
+				child++;
+			}
+
+			if (index.get_octree_first_child(cell) != children[0]
+			|| !index.get_octree_siblings(children[5], siblings)
+			|| siblings != children) {
+				cerr << "Wrong first child or siblings for children of cell " << cell << endl;
+				abort();
+			}
+		}
+
+		if (refinement_level == 0 && index.get_octree_siblings(cell, siblings)) {
+			cerr << "Unrefined cell " << cell << " has siblings" << endl;
+			abort();
+		}
+	}
+
+	if (index.get_octree_parent(error_cell) != error_cell
+	|| index.get_octree_parent(cells + 1) != error_cell) {
+		cerr << "Invalid cells have a parent" << endl;
+		abort();
+	}
+
+	#ifdef DCCRG_MORTON_ORDER
+	// children of a cell have consecutive ids starting from the child at the smallest indices
+	for (uint64_t cell = 1; index.get_refinement_level(cell) < index.get_maximum_refinement_level(); cell++) {
+		const Types<3>::indices_t indices = index.get_indices(cell);
+		const int child_level = index.get_refinement_level(cell) + 1;
+		const uint64_t child_size = uint64_t(1) << (index.get_maximum_refinement_level() - child_level);
+
+		vector<uint64_t> children;
+		for (uint64_t z = 0; z < 2; z++)
+		for (uint64_t y = 0; y < 2; y++)
+		for (uint64_t x = 0; x < 2; x++) {
+			children.push_back(
+				index.get_cell_from_indices(
+					indices[0] + x * child_size,
+					indices[1] + y * child_size,
+					indices[2] + z * child_size,
+					child_level
+				)
+			);
+		}
+
+		for (size_t i = 1; i < children.size(); i++) {
+			if (children[i] != children[0] + i) {
+				cerr << "Children of cell " << cell << " don't have consecutive ids" << endl;
+				abort();
+			}
+		}
+	}
+	#endif
+
+	cout << "Passed" << endl;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,166 @@
+/*
+Tests neighbor lists of periodic and non-periodic grids whose neighborhood wraps around the grid several times.
+Returns EXIT_SUCCESS if everything went ok.
+*/
+
+#include "algorithm"
+#include "boost/foreach.hpp"
+#include "boost/mpi.hpp"
+#include "cstdlib"
+#include "iostream"
+#include "vector"
+#include "zoltan.h"
+
+#include "../../dccrg.hpp"
+
+
+using namespace std;
+using namespace boost::mpi;
+using namespace dccrg;
+
+
+/*!
+Returns the smallest cell at given offset in cells of given size from given indices
+or 0 outside of a non-periodic grid.
+
+Assumes cells of size 1 and a maximum refinement level of 1.
+*/
+static uint64_t get_wrapped_cell(
+	const Dccrg<int>& grid,
+	const Types<3>::indices_t& indices,
+	const uint64_t size_in_indices,
+	const int offsets[3],
+	const bool periodic[3]
+) {
+	const uint64_t grid_length[3] = {
+		grid.get_x_length() << grid.get_maximum_refinement_level(),
+		grid.get_y_length() << grid.get_maximum_refinement_level(),
+		grid.get_z_length() << grid.get_maximum_refinement_level()
+	};
+
+	Types<3>::indices_t wrapped = {{0, 0, 0}};
+	for (int dimension = 0; dimension < 3; dimension++) {
+		const int64_t index = int64_t(indices[dimension]) + offsets[dimension] * int64_t(size_in_indices);
+		const int64_t length = int64_t(grid_length[dimension]);
+
+		if (!periodic[dimension] && (index < 0 || index >= length)) {
+			return 0;
+		}
+
+		wrapped[dimension] = uint64_t(((index % length) + length) % length);
+	}
+
+	return grid.get_existing_cell(
+		(wrapped[0] + 0.5) / 2,
+		(wrapped[1] + 0.5) / 2,
+		(wrapped[2] + 0.5) / 2
+	);
+}
+
+
+int main(int argc, char* argv[])
+{
+	environment env(argc, argv);
+	communicator comm;
+
+	float zoltan_version;
+	if (Zoltan_Initialize(argc, argv, &zoltan_version) != ZOLTAN_OK) {
+	    cout << "Zoltan_Initialize failed" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	for (int periodicity = 0; periodicity < 8; periodicity++)
+	for (unsigned int neighborhood_size = 1; neighborhood_size <= 3; neighborhood_size++) {
+
+		const bool periodic[3] = {
+			(periodicity & 1) > 0,
+			(periodicity & 2) > 0,
+			(periodicity & 4) > 0
+		};
+
+		Dccrg<int> grid;
+		grid.set_geometry(3, 2, 1, 0, 0, 0, 1, 1, 1);
+		grid.initialize(comm, "RCB", neighborhood_size, 1, periodic[0], periodic[1], periodic[2]);
+
+		// neighbors of same size cells are at the offsets of the neighborhood
+		const vector<uint64_t> cells = grid.get_cells();
+		BOOST_FOREACH(const uint64_t& cell, cells) {
+			const Types<3>::indices_t indices = grid.get_indices(cell);
+			const uint64_t size_in_indices = grid.get_cell_size_in_indices(cell);
+
+			vector<uint64_t> neighbors;
+			const int size = int(neighborhood_size);
+			for (int z = -size; z <= size; z++)
+			for (int y = -size; y <= size; y++)
+			for (int x = -size; x <= size; x++) {
+				if (x == 0 && y == 0 && z == 0) {
+					continue;
+				}
+
+				const int offsets[3] = {x, y, z};
+				neighbors.push_back(get_wrapped_cell(grid, indices, size_in_indices, offsets, periodic));
+			}
+
+			// verify_neighbors() sorts neighbor lists when DEBUG is defined
+			vector<uint64_t> found_neighbors = *grid.get_neighbors(cell);
+			sort(found_neighbors.begin(), found_neighbors.end());
+			sort(neighbors.begin(), neighbors.end());
+
+			if (found_neighbors != neighbors) {
+				cerr << "Process " << comm.rank()
+					<< ": Wrong neighbors for cell " << cell
+					<< " with neighborhood size " << neighborhood_size
+					<< " and periodicity " << periodic[0] << periodic[1] << periodic[2]
+					<< endl;
+				abort();
+			}
+		}
+
+		// every neighborhood item of a larger cell next to refined cells has all 8 of them once
+		if (grid.is_local(1)) {
+			grid.refine_completely(1);
+		}
+		grid.stop_refining();
+
+		const vector<uint64_t> new_cells = grid.get_cells();
+		BOOST_FOREACH(const uint64_t& cell, new_cells) {
+			if (grid.get_refinement_level(cell) > 0) {
+				continue;
+			}
+
+			const Types<3>::indices_t indices = grid.get_indices(cell);
+			const uint64_t size_in_indices = grid.get_cell_size_in_indices(cell);
+
+			size_t number_of_neighbors = 0;
+			const int size = int(neighborhood_size);
+			for (int z = -size; z <= size; z++)
+			for (int y = -size; y <= size; y++)
+			for (int x = -size; x <= size; x++) {
+				if (x == 0 && y == 0 && z == 0) {
+					continue;
+				}
+
+				const int offsets[3] = {x, y, z};
+				const uint64_t neighbor = get_wrapped_cell(grid, indices, size_in_indices, offsets, periodic);
+				number_of_neighbors += (neighbor != 0 && grid.get_refinement_level(neighbor) > 0) ? 8 : 1;
+			}
+
+			if (grid.get_neighbors(cell)->size() != number_of_neighbors) {
+				cerr << "Process " << comm.rank()
+					<< ": Cell " << cell
+					<< " has " << grid.get_neighbors(cell)->size()
+					<< " neighbors instead of " << number_of_neighbors
+					<< " with neighborhood size " << neighborhood_size
+					<< " and periodicity " << periodic[0] << periodic[1] << periodic[2]
+					<< endl;
+				abort();
+			}
+		}
+	}
+
+	if (comm.rank() == 0) {
+		cout << "Passed" << endl;
+	}
+
+	return EXIT_SUCCESS;
+}
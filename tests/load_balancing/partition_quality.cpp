@@ -0,0 +1,110 @@
+/*
+Tests the partition quality report of dccrg.
+Returns EXIT_SUCCESS if everything went ok.
+*/
+
+#include "boost/foreach.hpp"
+#include "boost/mpi.hpp"
+#include "cmath"
+#include "cstdlib"
+#include "iostream"
+#include "vector"
+#include "zoltan.h"
+
+#include "../../dccrg.hpp"
+
+
+using namespace std;
+using namespace boost::mpi;
+using namespace dccrg;
+
+
+static void check(const bool condition, const char* description, const int rank)
+{
+	if (!condition) {
+		cerr << "Process " << rank << ": " << description << endl;
+		abort();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	environment env(argc, argv);
+	communicator comm;
+
+	float zoltan_version;
+	if (Zoltan_Initialize(argc, argv, &zoltan_version) != ZOLTAN_OK) {
+	    cout << "Zoltan_Initialize failed" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	#define GRID_SIZE 10
+	Dccrg<int> grid;
+	grid.set_geometry(GRID_SIZE, GRID_SIZE, 1, 0, 0, 0, 1, 1, 1);
+	grid.initialize(comm, "RANDOM", 1, 0);
+
+	const Partition_Quality random = grid.get_partition_quality();
+	check(random.total_cells == GRID_SIZE * GRID_SIZE, "Wrong number of cells", comm.rank());
+	check(random.migrated_cells == 0, "Cells were migrated before load balancing", comm.rank());
+	check(fabs(random.total_weight - GRID_SIZE * GRID_SIZE) < 1e-10, "Wrong total weight", comm.rank());
+	check(random.imbalance >= 1 - 1e-10, "Imbalance less than 1", comm.rank());
+	check(random.boundary_fraction >= 0 && random.boundary_fraction <= 1, "Invalid boundary fraction", comm.rank());
+	check(random.total_update_bytes == random.total_ghost_cells * sizeof(int), "Wrong number of update bytes", comm.rank());
+	check(random.min_peers <= random.average_peers && random.average_peers <= random.max_peers, "Invalid peers", comm.rank());
+
+	if (comm.size() == 1) {
+		check(random.edge_cut == 0 && random.max_peers == 0 && random.total_ghost_cells == 0, "Remote neighbors with one process", comm.rank());
+	} else {
+		check(random.edge_cut > 0 && random.max_peers > 0 && random.total_ghost_cells > 0, "No remote neighbors", comm.rank());
+	}
+
+	// weights given before load balancing are reported after it
+	const vector<uint64_t> initial_cells = grid.get_cells();
+	BOOST_FOREACH(const uint64_t& cell, initial_cells) {
+		grid.set_cell_weight(cell, 1 + cell % 3);
+	}
+	const double initial_weight = grid.get_partition_quality().total_weight;
+
+	// all cells move with RANDOM
+	grid.prepare_to_balance_load();
+	const uint64_t moved_cells = all_reduce(comm, uint64_t(grid.get_balance_removed_cells()->size()), plus<uint64_t>());
+	grid.balance_load(true);
+	const Partition_Quality balanced = grid.get_partition_quality();
+	check(balanced.total_cells == GRID_SIZE * GRID_SIZE, "Wrong number of cells after load balancing", comm.rank());
+	check(balanced.migrated_cells == moved_cells, "Wrong number of migrated cells", comm.rank());
+	check(balanced.migrated_bytes == moved_cells * sizeof(int), "Wrong number of migrated bytes", comm.rank());
+
+	const vector<uint64_t> cells = grid.get_cells();
+	double local_weight = 0;
+	BOOST_FOREACH(const uint64_t& cell, cells) {
+		local_weight += 1 + cell % 3;
+	}
+	const double balanced_max_weight = all_reduce(comm, local_weight, boost::mpi::maximum<double>());
+	check(fabs(balanced.total_weight - initial_weight) < 1e-10, "Wrong total weight after load balancing", comm.rank());
+	check(fabs(balanced.imbalance - balanced_max_weight * comm.size() / initial_weight) < 1e-10, "Wrong imbalance after load balancing", comm.rank());
+
+	// weights of the cells of process 0 are doubled, other processes keep their weights from before load balancing
+	if (comm.rank() == 0) {
+		BOOST_FOREACH(const uint64_t& cell, cells) {
+			grid.set_cell_weight(cell, 2);
+		}
+	}
+
+	const Partition_Quality weighted = grid.get_partition_quality();
+	const double
+		new_local_weight = comm.rank() == 0 ? 2 * cells.size() : local_weight,
+		total_weight = all_reduce(comm, new_local_weight, plus<double>()),
+		max_weight = all_reduce(comm, new_local_weight, boost::mpi::maximum<double>());
+	check(fabs(weighted.total_weight - total_weight) < 1e-10, "Wrong total weight with user given weights", comm.rank());
+	check(fabs(weighted.imbalance - max_weight * comm.size() / total_weight) < 1e-10, "Wrong imbalance", comm.rank());
+
+	if (comm.rank() == 0) {
+		cout << "Imbalance " << weighted.imbalance
+			<< ", edge cut " << weighted.edge_cut
+			<< ", boundary fraction " << weighted.boundary_fraction
+			<< endl;
+		cout << "Passed" << endl;
+	}
+
+	return EXIT_SUCCESS;
+}
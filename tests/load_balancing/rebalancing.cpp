@@ -0,0 +1,112 @@
+/*
+Tests load balancing only when it is estimated to pay off.
+Returns EXIT_SUCCESS if everything went ok.
+*/
+
+#include "boost/mpi.hpp"
+#include "cstdlib"
+#include "iostream"
+#include "sstream"
+#include "zoltan.h"
+
+#include "../../dccrg.hpp"
+
+
+using namespace std;
+using namespace boost::mpi;
+using namespace dccrg;
+
+
+int main(int argc, char* argv[])
+{
+	environment env(argc, argv);
+	communicator comm;
+
+	float zoltan_version;
+	if (Zoltan_Initialize(argc, argv, &zoltan_version) != ZOLTAN_OK) {
+	    cout << "Zoltan_Initialize failed" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	Dccrg<int> grid;
+	grid.set_geometry(20, 20, 1, 0, 0, 0, 1, 1, 1);
+	grid.initialize(comm, "RCB", 1, 0);
+	grid.balance_load();
+
+	ostringstream log;
+	grid.set_rebalancing_log(&log);
+
+	// equal step times never pay off
+	for (int step = 0; step < 3; step++) {
+		if (grid.balance_load_if_worthwhile(1)) {
+			cerr << "Process " << comm.rank() << ": Balanced load with equal step times" << endl;
+			abort();
+		}
+	}
+
+	// process 0 is much slower than others but savings don't exceed a huge threshold
+	const double step_time = (comm.rank() == 0) ? 10 : 1;
+	grid.set_rebalancing_threshold(1e100);
+	if (grid.balance_load_if_worthwhile(step_time)) {
+		cerr << "Process " << comm.rank() << ": Balanced load below threshold" << endl;
+		abort();
+	}
+
+	grid.set_rebalancing_threshold(1);
+	const bool balanced = grid.balance_load_if_worthwhile(step_time);
+
+	if (balanced != (comm.size() > 1)) {
+		cerr << "Process " << comm.rank() << ": Wrong decision: " << balanced << endl;
+		abort();
+	}
+
+	const Rebalancing_Decision& decision = grid.get_last_rebalancing_decision();
+	if (decision.step != 5
+	|| decision.rebalanced != balanced
+	|| (balanced && decision.cost <= 0)
+	|| decision.max_step_time < decision.average_step_time) {
+		cerr << "Process " << comm.rank() << ": Wrong decision recorded" << endl;
+		abort();
+	}
+
+	// one or two slow steps after load balancing aren't enough
+	if (grid.get_rebalancing_min_steps() != 3) {
+		cerr << "Process " << comm.rank() << ": Wrong default minimum number of steps" << endl;
+		abort();
+	}
+	for (int step = 0; step < 2; step++) {
+		if (grid.balance_load_if_worthwhile((comm.rank() == 0) ? 1000 : 1)) {
+			cerr << "Process " << comm.rank() << ": Balanced load before minimum number of steps" << endl;
+			abort();
+		}
+	}
+
+	if (grid.balance_load_if_worthwhile((comm.rank() == 0) ? 1000 : 1) != (comm.size() > 1)) {
+		cerr << "Process " << comm.rank() << ": Didn't balance load after minimum number of steps" << endl;
+		abort();
+	}
+
+	const uint64_t total_cells = all_reduce(comm, uint64_t(grid.get_cells().size()), plus<uint64_t>());
+	if (total_cells != 20 * 20) {
+		cerr << "Process " << comm.rank() << ": Grid has " << total_cells << " cells" << endl;
+		abort();
+	}
+
+	// header and one line per decision
+	int lines = 0;
+	for (size_t i = 0; i < log.str().size(); i++) {
+		if (log.str()[i] == '\n') {
+			lines++;
+		}
+	}
+	if (lines != 9) {
+		cerr << "Process " << comm.rank() << ": Log has " << lines << " lines" << endl;
+		abort();
+	}
+
+	if (comm.rank() == 0) {
+		cout << "Passed" << endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+/*
+Tests restoring a refined and load balanced grid with load()
+*/
+
+#include "algorithm"
+#include "boost/foreach.hpp"
+#include "boost/mpi.hpp"
+#include "cmath"
+#include "cstdlib"
+#include "iostream"
+#include "zoltan.h"
+
+#include "../../dccrg.hpp"
+
+
+using namespace std;
+using namespace boost::mpi;
+using namespace dccrg;
+
+int main(int argc, char* argv[])
+{
+	environment env(argc, argv);
+	communicator comm;
+
+	float zoltan_version;
+	if (Zoltan_Initialize(argc, argv, &zoltan_version) != ZOLTAN_OK) {
+	    cout << "Zoltan_Initialize failed" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	#define GRID_SIZE 5
+	#define NEIGHBORHOOD_SIZE 1
+	#define MAX_REFINEMENT_LEVEL 3
+
+	// create a grid refined around one corner
+	Dccrg<int> original;
+	original.set_geometry(GRID_SIZE, GRID_SIZE, GRID_SIZE, 0, 0, 0, 1, 1, 1);
+	original.initialize(comm, "RANDOM", NEIGHBORHOOD_SIZE, MAX_REFINEMENT_LEVEL);
+
+	for (int step = 0; step < MAX_REFINEMENT_LEVEL; step++) {
+		const vector<uint64_t> cells = original.get_cells();
+		BOOST_FOREACH(const uint64_t& cell, cells) {
+			const double
+				x = original.get_cell_x(cell),
+				y = original.get_cell_y(cell),
+				z = original.get_cell_z(cell);
+
+			if (sqrt(x * x + y * y + z * z) < 2.5 / (step + 1)) {
+				original.refine_completely(cell);
+			}
+		}
+		original.stop_refining();
+		original.balance_load();
+	}
+
+	vector<uint64_t> original_cells = original.get_cells();
+	sort(original_cells.begin(), original_cells.end());
+
+	// every process saves its own cells
+	vector<uint64_t> saved_cells;
+	vector<int> saved_processes;
+	BOOST_FOREACH(const uint64_t& cell, original_cells) {
+		saved_cells.push_back(cell);
+		saved_processes.push_back(comm.rank());
+	}
+
+	// restore the grid
+	Dccrg<int> restored;
+	restored.set_geometry(GRID_SIZE, GRID_SIZE, GRID_SIZE, 0, 0, 0, 1, 1, 1);
+	restored.initialize(comm, "RANDOM", NEIGHBORHOOD_SIZE, MAX_REFINEMENT_LEVEL);
+
+	if (!restored.load(saved_cells, saved_processes)) {
+		cerr << "Process " << comm.rank() << ": load failed" << endl;
+		abort();
+	}
+
+	vector<uint64_t> restored_cells = restored.get_cells();
+	sort(restored_cells.begin(), restored_cells.end());
+
+	if (restored_cells != original_cells) {
+		cerr << "Process " << comm.rank()
+			<< ": Restored grid has " << restored_cells.size()
+			<< " local cells instead of " << original_cells.size()
+			<< endl;
+		abort();
+	}
+
+	// invalid cells must fail on all processes
+	vector<uint64_t> invalid_cells;
+	if (comm.rank() == 0) {
+		invalid_cells.push_back(0);
+	}
+	if (restored.load(invalid_cells)) {
+		cerr << "Process " << comm.rank() << ": Loading invalid cell succeeded" << endl;
+		abort();
+	}
+
+	const uint64_t total_cells = all_reduce(comm, uint64_t(restored_cells.size()), plus<uint64_t>());
+	if (comm.rank() == 0) {
+		cout << "Restored " << total_cells << " cells" << endl;
+		cout << "Passed" << endl;
+	}
+
+	return EXIT_SUCCESS;
+}
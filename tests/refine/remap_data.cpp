@@ -0,0 +1,145 @@
+/*
+Tests prolongation and restriction of user data during stop_refining
+*/
+
+#include "algorithm"
+#include "boost/array.hpp"
+#include "boost/foreach.hpp"
+#include "boost/mpi.hpp"
+#include "cmath"
+#include "cstdlib"
+#include "iostream"
+#include "zoltan.h"
+
+#include "../../dccrg.hpp"
+
+
+using namespace std;
+using namespace boost::mpi;
+using namespace dccrg;
+
+// every cell's data should always be the cell itself
+class Prolongation
+{
+public:
+	void operator()(
+		const uint64_t parent,
+		const uint64_t& parent_data,
+		const boost::array<uint64_t, 8>& children,
+		const boost::array<uint64_t*, 8>& children_data
+	) const {
+		if (parent_data != parent) {
+			cerr << "Process " << communicator().rank()
+				<< ": Refined cell " << parent
+				<< " has wrong data: " << parent_data
+				<< endl;
+			abort();
+		}
+
+		for (unsigned int i = 0; i < 8; i++) {
+			*(children_data[i]) = children[i];
+		}
+	}
+};
+
+class Restriction
+{
+public:
+	void operator()(
+		const uint64_t parent,
+		uint64_t& parent_data,
+		const boost::array<uint64_t, 8>& children,
+		const boost::array<const uint64_t*, 8>& children_data
+	) const {
+		for (unsigned int i = 0; i < 8; i++) {
+			if (*(children_data[i]) != children[i]) {
+				cerr << "Process " << communicator().rank()
+					<< ": Unrefined cell " << children[i]
+					<< " has wrong data: " << *(children_data[i])
+					<< endl;
+				abort();
+			}
+		}
+
+		parent_data = parent;
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	environment env(argc, argv);
+	communicator comm;
+
+	float zoltan_version;
+	if (Zoltan_Initialize(argc, argv, &zoltan_version) != ZOLTAN_OK) {
+	    cout << "Zoltan_Initialize failed" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	Dccrg<uint64_t> grid;
+
+	#define GRID_SIZE 4
+	grid.set_geometry(GRID_SIZE, GRID_SIZE, 1, 0, 0, 0, 1, 1, 1);
+
+	#define NEIGHBORHOOD_SIZE 1
+	grid.initialize(comm, "RANDOM", NEIGHBORHOOD_SIZE, 2);
+
+	// move cells between processes a few at a time
+	grid.set_migration_buffer_size(5 * sizeof(uint64_t));
+
+	vector<uint64_t> cells = grid.get_cells();
+	BOOST_FOREACH(const uint64_t& cell, cells) {
+		*(grid[cell]) = cell;
+	}
+
+	#define TIME_STEPS 6
+	for (int step = 0; step < TIME_STEPS; step++) {
+
+		// refine around the grid's center during first half, unrefine during second
+		cells = grid.get_cells();
+		BOOST_FOREACH(const uint64_t& cell, cells) {
+			const double x = grid.get_cell_x(cell) - GRID_SIZE / 2.0, y = grid.get_cell_y(cell) - GRID_SIZE / 2.0;
+			const double distance = sqrt(x * x + y * y);
+
+			if (step < TIME_STEPS / 2) {
+				if (distance < (step + 1) * GRID_SIZE / 6.0) {
+					grid.refine_completely(cell);
+				}
+			} else {
+				grid.unrefine_completely(cell);
+			}
+		}
+
+		grid.stop_refining(Prolongation(), Restriction());
+
+		if (grid.get_removed_cells().size() > 0) {
+			cerr << "Process " << comm.rank() << ": Data of unrefined cells wasn't freed" << endl;
+			abort();
+		}
+
+		grid.balance_load();
+
+		cells = grid.get_cells();
+		BOOST_FOREACH(const uint64_t& cell, cells) {
+			if (*(grid[cell]) != cell) {
+				cerr << "Process " << comm.rank()
+					<< ": Cell " << cell
+					<< " has wrong data: " << *(grid[cell])
+					<< " at end of step " << step
+					<< endl;
+				abort();
+			}
+		}
+
+		const uint64_t total_cells = all_reduce(comm, uint64_t(cells.size()), plus<uint64_t>());
+		if (comm.rank() == 0) {
+			cout << "Step " << step << ": " << total_cells << " cells" << endl;
+		}
+	}
+
+	if (comm.rank() == 0) {
+		cout << "Passed" << endl;
+	}
+
+	return EXIT_SUCCESS;
+}
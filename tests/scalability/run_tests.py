@@ -2,9 +2,17 @@
 # -*- coding: utf-8 -*-
 
 '''
-A program for starting general scalability tests and gathering results.
+A program for running weak and strong scaling tests and analyzing their results.
 
-Copyright 2011 Finnish Meteorological Institute
+Sweeps the number of processes, cells per process (weak scaling) or
+grid size (strong scaling), data size, neighborhood size and transfer
+policy. Every run gets its own directory under the prefix in which
+the scalability program writes its log and per process statistics.
+Afterwards parallel efficiency tables and a breakdown of
+transferred bytes per cell are printed and all results are written
+into results.csv under the prefix.
+
+Copyright 2011, 2012 Finnish Meteorological Institute
 
 This program is free software: you can redistribute it and/or modify
 it under the terms of the GNU Lesser General Public License version 3
@@ -19,26 +27,162 @@ You should have received a copy of the GNU Lesser General Public License
 along with this program. If not, see <http://www.gnu.org/licenses/>.
 '''
 
+from __future__ import print_function
+from glob import glob
 from optparse import OptionParser
-from os import chdir, getcwd
+from os import chdir, getcwd, path
 from subprocess import check_call
 
 
-def test_using_mpirun(processes, data_size, solution_time, test_dir_name, options):
+# parameters of a run in the order they appear in results.csv
+PARAMETERS = ["scaling", "size", "processes", "data_size", "neighborhood_size", "transfer_policy"]
+RESULTS = ["cells", "wall_time", "sent_bytes", "sent_messages", "max_sent_bytes"]
+
+
+def get_list(value, converter):
+	return [converter(item) for item in value.split(",") if item != ""]
+
+
+def get_test_dir_name(run, options):
+	return path.join(
+		options.prefix,
+		run["scaling"] + "_" + str(run["size"])
+		+ "_" + str(run["processes"]) + "p"
+		+ "_" + str(run["data_size"]) + "B"
+		+ "_" + str(run["neighborhood_size"]) + "n"
+		+ "_" + run["transfer_policy"])
+
+
+def test_using_mpirun(run, test_dir_name, options):
 	pwd = getcwd()
 	chdir(test_dir_name)
-	run_command = "mpirun -np " + str(processes)
-	run_command += " scalability --data_size " + str(data_size)
-	run_command += " --solution_time " + str(solution_time)
-	run_command += " --x_length " + str(options.x_length)
-	run_command += " --y_length " + str(options.y_length)
-	run_command += " --z_length " + str(options.z_length)
-	run_command += " --neighborhood_size " + str(options.neighborhood_size)
-	run_command += " > logfile"
+
+	run_command = options.launcher + " " + str(run["processes"])
+	run_command += " ../" + options.program
+	run_command += " --data_size " + str(run["data_size"])
+	run_command += " --solution_time " + str(options.solution_time)
+	run_command += " --timesteps " + str(options.timesteps)
+	run_command += " --load_balancer " + options.load_balancer
+	run_command += " --neighborhood_size " + str(run["neighborhood_size"])
+	run_command += " --transfer_policy " + run["transfer_policy"]
+	run_command += " --maximum_refinement_level 0"
+	run_command += " --statistics statistics"
+	if run["scaling"] == "weak":
+		run_command += " --cells_per_process " + str(run["size"])
+	else:
+		run_command += " --x_length " + str(run["size"])
+		run_command += " --y_length " + str(run["size"])
+		run_command += " --z_length " + str(run["size"])
+	run_command += " > logfile 2>&1"
+
+	with open("config", "w") as config:
+		for parameter in PARAMETERS:
+			config.write(parameter + " " + str(run[parameter]) + "\n")
+
 	check_call(run_command, shell = True)
 	chdir(pwd)
 
 
+def gather_result(test_dir_name, options):
+	'''
+	Returns the parameters and results of the run in given directory or None if it didn't finish.
+	'''
+	result = {}
+	with open(path.join(test_dir_name, "config")) as config:
+		for line in config:
+			name, value = line.split()
+			result[name] = value
+	for name in ["size", "processes", "data_size", "neighborhood_size"]:
+		result[name] = int(result[name])
+
+	if not path.exists(path.join(test_dir_name, "logfile")):
+		return None
+
+	result["wall_time"] = None
+	with open(path.join(test_dir_name, "logfile")) as logfile:
+		for line in logfile:
+			if line.startswith("Wall time per timestep:"):
+				result["wall_time"] = float(line.split(":")[1])
+			elif line.startswith("Cells:"):
+				result["cells"] = int(line.split(":")[1])
+	if result["wall_time"] is None:
+		return None
+
+	# sum user data sent to other processes, see Statistics::write_csv()
+	result["sent_bytes"] = 0
+	result["sent_messages"] = 0
+	result["max_sent_bytes"] = 0
+	for statistics_name in glob(path.join(test_dir_name, "statistics_*.csv")):
+		process_sent_bytes = 0
+		with open(statistics_name) as statistics:
+			for line in statistics:
+				fields = line.strip().split(",")
+				if fields[1] != "peer":
+					continue
+				process_sent_bytes += int(fields[6])
+				result["sent_messages"] += int(fields[5])
+		result["sent_bytes"] += process_sent_bytes
+		result["max_sent_bytes"] = max(result["max_sent_bytes"], process_sent_bytes)
+
+	for name in ["sent_bytes", "sent_messages", "max_sent_bytes"]:
+		result[name] /= float(options.timesteps)
+
+	return result
+
+
+def print_efficiency_tables(results):
+	'''
+	Prints the parallel efficiency of each series of runs relative to its run with the fewest processes.
+
+	Efficiency of strong scaling is T(p0) * p0 / (T(p) * p). The number of cells per process
+	differs between weak scaling runs because the grid is a cube, so efficiency of weak scaling
+	is computed from time per cell per process: (T(p0) * p0 / cells0) / (T(p) * p / cells).
+	'''
+	series = {}
+	for result in results:
+		key = tuple([result[parameter] for parameter in PARAMETERS if parameter != "processes"])
+		series.setdefault(key, []).append(result)
+
+	for key in sorted(series.keys()):
+		runs = sorted(series[key], key = lambda result: result["processes"])
+		first = runs[0]
+
+		print()
+		print(", ".join([parameter + " " + str(value) for parameter, value in zip([p for p in PARAMETERS if p != "processes"], key)]))
+		print("%10s %10s %14s %14s %10s %10s" % ("processes", "cells", "cells / proc", "time / step", "speedup", "efficiency"))
+		for run in runs:
+			speedup = first["wall_time"] / run["wall_time"]
+			efficiency = speedup * first["processes"] / run["processes"]
+			if run["scaling"] == "weak":
+				efficiency *= float(run["cells"]) / first["cells"]
+			print("%10d %10d %14.6g %14.6g %10.3f %10.3f" % (
+				run["processes"], run["cells"], float(run["cells"]) / run["processes"],
+				run["wall_time"], speedup, efficiency))
+
+
+def print_halo_breakdown(results):
+	'''
+	Prints user data sent between processes during one timestep relative to the number of cells.
+
+	Imbalance is the bytes sent by the busiest process relative to the average process.
+	'''
+	print()
+	print("%8s %8s %8s %8s %6s %14s %10s %12s %14s %10s" % (
+		"scaling", "size", "procs", "data", "nhood", "policy",
+		"cells", "bytes/cell", "msgs/process", "imbalance"))
+	for run in sorted(results, key = lambda result: [result[parameter] for parameter in PARAMETERS]):
+		average_sent_bytes = run["sent_bytes"] / run["processes"]
+		imbalance = 0
+		if average_sent_bytes > 0:
+			imbalance = run["max_sent_bytes"] / average_sent_bytes
+		print("%8s %8d %8d %8d %6d %14s %10d %12.4g %14.4g %10.3f" % (
+			run["scaling"], run["size"], run["processes"], run["data_size"],
+			run["neighborhood_size"], run["transfer_policy"], run["cells"],
+			run["sent_bytes"] / run["cells"],
+			run["sent_messages"] / run["processes"],
+			imbalance))
+
+
 parser = OptionParser()
 
 parser.add_option(
@@ -54,103 +198,79 @@ parser.add_option(
 	default = False,
 	action = "store_true",
 	dest = "gather_results",
-	help = "Gather results of finished tests")
+	help = "Only gather and analyze results of finished tests")
 
 parser.add_option(
-	"--process-min",
-	type = "int",
-	default = 1,
-	dest = "process_min",
-	help = "Start launching at MINP processes",
-	metavar = "MINP")
+	"--program",
+	type = "string",
+	default = "scalability_mpi",
+	dest = "program",
+	help = "Test with program PROG built by the Makefile",
+	metavar = "PROG")
 
 parser.add_option(
-	"--process-max",
-	type = "int",
-	default = 6,
-	dest = "process_max",
-	help = "Stop launching at MAXP processes",
-	metavar = "MAXP")
+	"--launcher",
+	type = "string",
+	default = "mpirun --oversubscribe -np",
+	dest = "launcher",
+	help = "Start test programs with LAUNCHER followed by the number of processes",
+	metavar = "LAUNCHER")
 
 parser.add_option(
-	"--process-stride",
-	type = "int",
-	default = 1,
-	dest = "process_stride",
-	help = "Increment number of launched processes by PSTRIDE",
-	metavar = "PSTRIDE")
+	"--processes",
+	type = "string",
+	default = "1,2,4",
+	dest = "processes",
+	help = "Comma separated numbers of processes to test with",
+	metavar = "PROCS")
 
 parser.add_option(
-	"--data-size-min",
-	type = "int",
-	default = 1,
-	dest = "data_size_min",
-	help = "Start testing at DMIN bytes of data per cell",
-	metavar = "DMIN")
+	"--cells-per-process",
+	type = "string",
+	default = "1000",
+	dest = "cells_per_process",
+	help = "Comma separated numbers of cells per process for weak scaling, empty skips weak scaling",
+	metavar = "CELLS")
 
 parser.add_option(
-	"--data-size-max",
-	type = "int",
-	default = 1000000,
-	dest = "data_size_max",
-	help = "Stop testing at DMAX bytes of data per cell",
-	metavar = "DMAX")
+	"--grid-lengths",
+	type = "string",
+	default = "20",
+	dest = "grid_lengths",
+	help = "Comma separated lengths of a cubic grid for strong scaling, empty skips strong scaling",
+	metavar = "LENGTHS")
 
 parser.add_option(
-	"--data-size-factor",
-	type = "float",
-	default = 10.0,
-	dest = "data_size_factor",
-	help = "Multiply data size by DFAC",
-	metavar = "DFAC")
+	"--data-sizes",
+	type = "string",
+	default = "8,1024",
+	dest = "data_sizes",
+	help = "Comma separated bytes of data per cell",
+	metavar = "SIZES")
 
 parser.add_option(
-	"--solution-time-min",
-	type = "float",
-	default = 1e-6,
-	dest = "solution_time_min",
-	help = "Start testing at TMIN second solution time per cell",
-	metavar = "TMIN")
+	"--neighborhood-sizes",
+	type = "string",
+	default = "1",
+	dest = "neighborhood_sizes",
+	help = "Comma separated neighborhood sizes",
+	metavar = "NHOODS")
 
 parser.add_option(
-	"--solution-time-max",
-	type = "float",
-	default = 1.0,
-	dest = "solution_time_max",
-	help = "Stop testing at TMAX second solution time per cell",
-	metavar = "TMAX")
+	"--transfer-policies",
+	type = "string",
+	default = "automatic",
+	dest = "transfer_policies",
+	help = "Comma separated transfer policies (automatic, single_cell, datatype, packed, serialized, neighborhood, shared_memory)",
+	metavar = "POLICIES")
 
 parser.add_option(
-	"--solution-time-factor",
+	"--solution-time",
 	type = "float",
-	default = 10.0,
-	dest = "solution_time_factor",
-	help = "Multiply data solution time by TFAC",
-	metavar = "TFAC")
-
-parser.add_option(
-	"--x-length",
-	type = "int",
-	default = 10,
-	dest = "x_length",
-	help = "Test using a grid with XLEN unrefined cell in x direction",
-	metavar = "XLEN")
-
-parser.add_option(
-	"--y-length",
-	type = "int",
-	default = 10,
-	dest = "y_length",
-	help = "Test using a grid with YLEN unrefined cell in y direction",
-	metavar = "YLEN")
-
-parser.add_option(
-	"--z-length",
-	type = "int",
-	default = 10,
-	dest = "z_length",
-	help = "Test using a grid with ZLEN unrefined cell in z direction",
-	metavar = "ZLEN")
+	default = 1e-6,
+	dest = "solution_time",
+	help = "Test with TIME second solution time per cell",
+	metavar = "TIME")
 
 parser.add_option(
 	"--timesteps",
@@ -161,42 +281,55 @@ parser.add_option(
 	metavar = "STEPS")
 
 parser.add_option(
-	"--neighborhood-size",
-	type = "int",
-	default = 1,
-	dest = "neighborhood_size",
-	help = "Test with NHOOD size neighborhood",
-	metavar = "NHOOD")
-
-parser.add_option(
-	"--launcher-type",
+	"--load-balancer",
 	type = "string",
-	default = "mpirun",
-	dest = "launcher_type",
-	help = "Start test programs with launcher type LTYPE",
-	metavar = "LTYPE")
+	default = "RCB",
+	dest = "load_balancer",
+	help = "Partition the grid with Zoltan method LB",
+	metavar = "LB")
 
 (options, args) = parser.parse_args()
 
-check_call(["mkdir", "-pv", options.prefix])
-check_call(["cp", "-v", "scalability", options.prefix])
-
-# create run directories, job scripts, etc and start
-for processes in range(options.process_min, options.process_max + 1, options.process_stride):
-
-	data_size = options.data_size_min
-	while data_size <= options.data_size_max:
-
-		solution_time = options.solution_time_min
-		while solution_time <= options.solution_time_max:
-
-			test_dir_name = options.prefix + "/" + str(processes) + "p_" + str(data_size) + "B_" + str(solution_time) + "s"
-			check_call(["mkdir", "-pv", test_dir_name])
-			check_call(["ln", "-svf", "../scalability", test_dir_name])
-
-			if options.launcher_type == 'mpirun':
-				test_using_mpirun(processes, data_size, solution_time, test_dir_name, options)
-
-			solution_time *= options.solution_time_factor
-		data_size = int(data_size * options.data_size_factor)
-
+runs = []
+for processes in get_list(options.processes, int):
+	for data_size in get_list(options.data_sizes, int):
+		for neighborhood_size in get_list(options.neighborhood_sizes, int):
+			for transfer_policy in get_list(options.transfer_policies, str):
+				sizes = [("weak", size) for size in get_list(options.cells_per_process, int)]
+				sizes += [("strong", size) for size in get_list(options.grid_lengths, int)]
+				for scaling, size in sizes:
+					runs.append({
+						"scaling": scaling,
+						"size": size,
+						"processes": processes,
+						"data_size": data_size,
+						"neighborhood_size": neighborhood_size,
+						"transfer_policy": transfer_policy})
+
+if not options.gather_results:
+	check_call(["mkdir", "-p", options.prefix])
+	check_call(["cp", options.program, options.prefix])
+
+	for run in runs:
+		test_dir_name = get_test_dir_name(run, options)
+		check_call(["mkdir", "-p", test_dir_name])
+		test_using_mpirun(run, test_dir_name, options)
+
+results = []
+for run in runs:
+	test_dir_name = get_test_dir_name(run, options)
+	if not path.exists(path.join(test_dir_name, "config")):
+		continue
+	result = gather_result(test_dir_name, options)
+	if result is None:
+		print("Run in " + test_dir_name + " didn't finish")
+		continue
+	results.append(result)
+
+with open(path.join(options.prefix, "results.csv"), "w") as outfile:
+	outfile.write(",".join(PARAMETERS + RESULTS) + "\n")
+	for result in results:
+		outfile.write(",".join([str(result[name]) for name in PARAMETERS + RESULTS]) + "\n")
+
+print_efficiency_tables(results)
+print_halo_breakdown(results)
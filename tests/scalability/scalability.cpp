@@ -64,7 +64,7 @@ public:
 
 	void* at(void)
 	{
-		return this;
+		return &(this->data[0]);
 	}
 
 	#ifdef DCCRG_USER_MPI_DATA_TYPE
@@ -105,6 +105,29 @@ size_t get_traffic_size(const boost::unordered_map<int, std::vector<uint64_t> >*
 }
 
 
+/*!
+Returns the transfer policy with given name or AUTOMATIC_TRANSFER if the name is unknown.
+*/
+Dccrg<Cell>::transfer_policy_t get_transfer_policy(const string& name)
+{
+	if (name == "single_cell") {
+		return Dccrg<Cell>::SINGLE_CELL_TRANSFER;
+	} else if (name == "datatype") {
+		return Dccrg<Cell>::DATATYPE_TRANSFER;
+	} else if (name == "packed") {
+		return Dccrg<Cell>::PACKED_TRANSFER;
+	} else if (name == "serialized") {
+		return Dccrg<Cell>::SERIALIZED_TRANSFER;
+	} else if (name == "neighborhood") {
+		return Dccrg<Cell>::NEIGHBORHOOD_TRANSFER;
+	} else if (name == "shared_memory") {
+		return Dccrg<Cell>::SHARED_MEMORY_TRANSFER;
+	} else {
+		return Dccrg<Cell>::AUTOMATIC_TRANSFER;
+	}
+}
+
+
 /*!
 Returns the amount of time in seconds spent "solving" given cells.
 */
@@ -153,9 +176,9 @@ int main(int argc, char* argv[])
 	*/
 	size_t data_size;
 	double solution_time;
-	string load_balancer;
+	string load_balancer, transfer_policy, statistics_prefix;
 	int timesteps, maximum_refinement_level, neighborhood_size;
-	uint64_t x_length, y_length, z_length;
+	uint64_t x_length, y_length, z_length, cells_per_process;
 	boost::program_options::options_description options("Usage: program_name [options], where options are:");
 	options.add_options()
 		("help", "print this help message")
@@ -185,7 +208,16 @@ int main(int argc, char* argv[])
 			"Maximum refinement level of the grid (0 == not refined, -1 == maximum possible for given lengths)")
 		("neighborhood_size",
 			boost::program_options::value<int>(&neighborhood_size)->default_value(1),
-			"Size of a cell's neighborhood in cells of equal size (0 means only cells sharing a face are neighbors)");
+			"Size of a cell's neighborhood in cells of equal size (0 means only cells sharing a face are neighbors)")
+		("cells_per_process",
+			boost::program_options::value<uint64_t>(&cells_per_process)->default_value(0),
+			"If > 0 create a cubic grid with as close to arg unrefined cells per process as possible instead of using x, y and z_length")
+		("transfer_policy",
+			boost::program_options::value<string>(&transfer_policy)->default_value("automatic"),
+			"Transfer neighbor data with policy arg (automatic, single_cell, datatype, packed, serialized, neighborhood or shared_memory)")
+		("statistics",
+			boost::program_options::value<string>(&statistics_prefix)->default_value(""),
+			"Write statistics of neighbor data updates into files arg_<rank>.csv");
 
 	// read options from command line
 	boost::program_options::variables_map option_variables;
@@ -210,6 +242,20 @@ int main(int argc, char* argv[])
 
 	Cell::data_size = data_size;
 
+	// weak scaling
+	if (cells_per_process > 0) {
+		// cube whose number of cells is closest to the requested one
+		const uint64_t target = cells_per_process * comm.size();
+		uint64_t length = 1;
+		while ((length + 1) * (length + 1) * (length + 1) <= target) {
+			length++;
+		}
+		if ((length + 1) * (length + 1) * (length + 1) - target < target - length * length * length) {
+			length++;
+		}
+		x_length = y_length = z_length = length;
+	}
+
 	// initialize
 	Dccrg<Cell> grid;
 
@@ -223,8 +269,15 @@ int main(int argc, char* argv[])
 	}
 
 	grid.initialize(comm, load_balancer.c_str(), neighborhood_size, maximum_refinement_level);
+	grid.set_transfer_policy(get_transfer_policy(transfer_policy));
 	grid.balance_load();
 
+	// only collect statistics of the timesteps
+	grid.set_statistics_collection(statistics_prefix != "");
+	grid.clear_statistics();
+	comm.barrier();
+	const double start_time = MPI_Wtime();
+
 	vector<uint64_t> inner_cells = grid.get_cells_with_local_neighbors();
 	vector<uint64_t> outer_cells = grid.get_cells_with_remote_neighbor();
 
@@ -247,6 +300,12 @@ int main(int argc, char* argv[])
 		grid.wait_neighbor_data_update_sends();
 	}
 
+	const double wall_time = all_reduce(comm, MPI_Wtime() - start_time, boost::mpi::maximum<double>());
+
+	if (statistics_prefix != "" && !grid.write_statistics(statistics_prefix)) {
+		abort();
+	}
+
 	for (int process = 0; process < comm.size(); process++) {
 		comm.barrier();
 		if (comm.rank() == process) {
@@ -262,6 +321,8 @@ int main(int argc, char* argv[])
 	double total_transferred_bytes = all_reduce(comm, sends_size, plus<double>());
 	if (comm.rank() == 0) {
 		cout << "Total transferred bytes per timestep: " << total_transferred_bytes / timesteps << endl;
+		cout << "Cells: " << x_length * y_length * z_length << endl;
+		cout << "Wall time per timestep: " << wall_time / timesteps << endl;
 	}
 
 	return EXIT_SUCCESS;
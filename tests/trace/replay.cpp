@@ -0,0 +1,258 @@
+/*
+Replays the communication pattern of traces recorded with Dccrg::start_tracing() using synthetic data.
+
+Must be run with the same number of processes as the traced program.
+Every process reads its own trace and repeats each transfer in it with
+non-blocking point-to-point messages of the recorded sizes, so that
+MPI settings can be benchmarked without the program that was traced.
+Prints the recorded and replayed times of transfers of each kind and
+optionally writes the times of every transfer in CSV format.
+
+Copyright 2012 Finnish Meteorological Institute
+
+Dccrg is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License version 3
+as published by the Free Software Foundation.
+
+Dccrg is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with dccrg.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "boost/foreach.hpp"
+#include "boost/mpi.hpp"
+#include "boost/program_options.hpp"
+#include "cstdlib"
+#include "fstream"
+#include "iostream"
+#include "map"
+#include "sstream"
+#include "string"
+#include "vector"
+
+#include "../../dccrg_trace.hpp"
+
+
+using namespace std;
+using namespace boost::mpi;
+using namespace dccrg;
+
+
+/*!
+Returns the sizes of messages into which given bytes are split.
+
+Transfers through shared memory were recorded without messages and are replayed with one.
+*/
+vector<int> get_message_sizes(const uint64_t bytes, const uint64_t recorded_messages, const bool single_message)
+{
+	vector<int> sizes;
+	if (bytes == 0) {
+		return sizes;
+	}
+
+	const uint64_t messages = (single_message || recorded_messages == 0) ? 1 : recorded_messages;
+	for (uint64_t i = 0; i < messages; i++) {
+		sizes.push_back(int(bytes * (i + 1) / messages - bytes * i / messages));
+	}
+
+	return sizes;
+}
+
+
+/*!
+Repeats the transfers of given record and returns the time it took on this process.
+*/
+double replay(const Trace_Record& record, const bool single_message, communicator& comm)
+{
+	vector<vector<uint8_t> > buffers;
+	vector<MPI_Request> receive_requests, send_requests;
+
+	// reserve so that buffers aren't moved while messages are in flight
+	size_t messages = 0;
+	for (map<int, Peer_Statistics>::const_iterator
+		peer = record.peers.begin();
+		peer != record.peers.end();
+		peer++
+	) {
+		messages += get_message_sizes(peer->second.received_bytes, peer->second.received_messages, single_message).size();
+		messages += get_message_sizes(peer->second.sent_bytes, peer->second.sent_messages, single_message).size();
+	}
+	buffers.reserve(messages);
+	receive_requests.reserve(messages);
+	send_requests.reserve(messages);
+
+	// MPI's non-overtaking order keeps messages with the same tag matched correctly
+	int max_tag = 32767;
+	int* tag_ub = NULL;
+	int has_tag_ub = 0;
+	MPI_Comm_get_attr(comm, MPI_TAG_UB, &tag_ub, &has_tag_ub);
+	if (has_tag_ub && tag_ub != NULL) {
+		max_tag = *tag_ub;
+	}
+
+	comm.barrier();
+	const double start_time = MPI_Wtime();
+
+	for (map<int, Peer_Statistics>::const_iterator
+		peer = record.peers.begin();
+		peer != record.peers.end();
+		peer++
+	) {
+		const vector<int> sizes = get_message_sizes(peer->second.received_bytes, peer->second.received_messages, single_message);
+		for (size_t i = 0; i < sizes.size(); i++) {
+			buffers.push_back(vector<uint8_t>(sizes[i] + 1));
+			receive_requests.push_back(MPI_Request());
+			MPI_Irecv(&(buffers.back()[0]), sizes[i], MPI_BYTE, peer->first, int(i % (uint64_t(max_tag) + 1)), comm, &(receive_requests.back()));
+		}
+	}
+
+	for (map<int, Peer_Statistics>::const_iterator
+		peer = record.peers.begin();
+		peer != record.peers.end();
+		peer++
+	) {
+		const vector<int> sizes = get_message_sizes(peer->second.sent_bytes, peer->second.sent_messages, single_message);
+		for (size_t i = 0; i < sizes.size(); i++) {
+			buffers.push_back(vector<uint8_t>(sizes[i] + 1));
+			send_requests.push_back(MPI_Request());
+			MPI_Isend(&(buffers.back()[0]), sizes[i], MPI_BYTE, peer->first, int(i % (uint64_t(max_tag) + 1)), comm, &(send_requests.back()));
+		}
+	}
+
+	if (receive_requests.size() > 0) {
+		MPI_Waitall(receive_requests.size(), &(receive_requests[0]), MPI_STATUSES_IGNORE);
+	}
+	if (send_requests.size() > 0) {
+		MPI_Waitall(send_requests.size(), &(send_requests[0]), MPI_STATUSES_IGNORE);
+	}
+
+	return MPI_Wtime() - start_time;
+}
+
+
+int main(int argc, char* argv[])
+{
+	environment env(argc, argv);
+	communicator comm;
+
+	string prefix, output_name;
+	int repetitions;
+	bool single_message;
+
+	boost::program_options::options_description options("Usage: program_name [options], where options are:");
+	options.add_options()
+		("help", "print this help message")
+		("prefix",
+			boost::program_options::value<string>(&prefix)->default_value("trace"),
+			"Replay traces written into files arg_<rank>.trace")
+		("repetitions",
+			boost::program_options::value<int>(&repetitions)->default_value(1),
+			"Replay every transfer arg times and use the fastest repetition")
+		("single-message",
+			boost::program_options::value<bool>(&single_message)->default_value(false),
+			"Send all data between two processes in one message instead of as many as were recorded")
+		("output",
+			boost::program_options::value<string>(&output_name)->default_value(""),
+			"Write the recorded and replayed time of every transfer into file arg");
+
+	boost::program_options::variables_map option_variables;
+	boost::program_options::store(boost::program_options::parse_command_line(argc, argv, options), option_variables);
+	boost::program_options::notify(option_variables);
+
+	if (option_variables.count("help") > 0) {
+		if (comm.rank() == 0) {
+			cout << options << endl;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	ostringstream file_name;
+	file_name << prefix << "_" << comm.rank() << ".trace";
+	ifstream infile(file_name.str().c_str(), ios::binary);
+
+	int rank, processes;
+	if (!read_trace_header(infile, rank, processes)) {
+		cerr << "Process " << comm.rank() << ": Couldn't read trace from " << file_name.str() << endl;
+		abort();
+	}
+	if (rank != comm.rank() || processes != comm.size()) {
+		cerr << "Process " << comm.rank()
+			<< ": Trace " << file_name.str()
+			<< " was recorded by process " << rank
+			<< " out of " << processes
+			<< endl;
+		abort();
+	}
+
+	vector<Trace_Record> records;
+	Trace_Record record;
+	while (record.read(infile)) {
+		records.push_back(record);
+	}
+
+	// every process must have recorded the same collective transfers
+	if (all_reduce(comm, records.size(), boost::mpi::maximum<size_t>()) != records.size()) {
+		cerr << "Process " << comm.rank() << ": Traces have different numbers of transfers" << endl;
+		abort();
+	}
+
+	ofstream outfile;
+	if (comm.rank() == 0 && output_name != "") {
+		outfile.open(output_name.c_str());
+		outfile << "transfer,kind,policy,recorded_time,recorded_wait,replayed_time\n";
+	}
+
+	const char* const kind_names[] = {"neighbor_update", "migration", "refinement"};
+	map<uint32_t, int> transfers;
+	map<uint32_t, double> recorded_times, replayed_times;
+
+	for (size_t i = 0; i < records.size(); i++) {
+		double replayed_time = 0;
+		for (int repetition = 0; repetition < repetitions; repetition++) {
+			const double time = replay(records[i], single_message, comm);
+			if (repetition == 0 || time < replayed_time) {
+				replayed_time = time;
+			}
+		}
+
+		// the slowest process determines how long a transfer takes
+		const double
+			recorded_time = all_reduce(comm, records[i].sends_end_time - records[i].start_time, boost::mpi::maximum<double>()),
+			recorded_wait = all_reduce(comm, records[i].receive_wait + records[i].send_wait, boost::mpi::maximum<double>());
+		replayed_time = all_reduce(comm, replayed_time, boost::mpi::maximum<double>());
+
+		const uint32_t kind = records[i].kind;
+		transfers[kind]++;
+		recorded_times[kind] += recorded_time;
+		replayed_times[kind] += replayed_time;
+
+		if (outfile.is_open()) {
+			outfile << i << ","
+				<< (kind < 3 ? kind_names[kind] : "unknown") << ","
+				<< records[i].policy << ","
+				<< recorded_time << ","
+				<< recorded_wait << ","
+				<< replayed_time << "\n";
+		}
+	}
+
+	if (comm.rank() == 0) {
+		for (map<uint32_t, int>::const_iterator
+			item = transfers.begin();
+			item != transfers.end();
+			item++
+		) {
+			cout << (item->first < 3 ? kind_names[item->first] : "unknown")
+				<< ": " << item->second << " transfers"
+				<< ", recorded " << recorded_times[item->first] << " s"
+				<< ", replayed " << replayed_times[item->first] << " s"
+				<< endl;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+/*
+Tests recording traces of user data transfers.
+Every process checks that the traces of all processes agree on what was transferred.
+Returns EXIT_SUCCESS if everything went ok.
+*/
+
+#include "boost/foreach.hpp"
+#include "boost/mpi.hpp"
+#include "cstdlib"
+#include "fstream"
+#include "iostream"
+#include "map"
+#include "sstream"
+#include "string"
+#include "vector"
+#include "zoltan.h"
+
+#include "../../dccrg.hpp"
+
+
+using namespace std;
+using namespace boost::mpi;
+using namespace dccrg;
+
+
+static vector<Trace_Record> read_trace(const string& prefix, const int process, const int processes)
+{
+	ostringstream file_name;
+	file_name << prefix << "_" << process << ".trace";
+
+	ifstream infile(file_name.str().c_str(), ios::binary);
+	int rank, size;
+	if (!read_trace_header(infile, rank, size) || rank != process || size != processes) {
+		cerr << "Invalid trace header in " << file_name.str() << endl;
+		abort();
+	}
+
+	vector<Trace_Record> records;
+	Trace_Record record;
+	while (record.read(infile)) {
+		records.push_back(record);
+	}
+
+	return records;
+}
+
+// does nothing to cells given by dccrg
+class Skip_Cells
+{
+public:
+	void operator()(
+		const uint64_t,
+		int&,
+		const Dccrg<int>::neighbor_and_data_t*,
+		const Dccrg<int>::neighbor_and_data_t*
+	) {}
+};
+
+int main(int argc, char* argv[])
+{
+	environment env(argc, argv);
+	communicator comm;
+
+	float zoltan_version;
+	if (Zoltan_Initialize(argc, argv, &zoltan_version) != ZOLTAN_OK) {
+	    cout << "Zoltan_Initialize failed" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	Dccrg<int> grid;
+	grid.set_geometry(10, 10, 1, 0, 0, 0, 1, 1, 1);
+	grid.initialize(comm, "RANDOM", 1, 1);
+
+	const string prefix("trace_test");
+	if (!grid.start_tracing(prefix)) {
+		abort();
+	}
+
+	#define UPDATES 3
+	for (int i = 0; i < UPDATES; i++) {
+		grid.update_remote_neighbor_data();
+	}
+
+	// receives of updates that process cells meanwhile are traced separately
+	for (int i = 0; i < UPDATES; i++) {
+		grid.update_remote_neighbor_data(Skip_Cells());
+	}
+
+	grid.balance_load();
+
+	const vector<uint64_t> cells = grid.get_cells();
+	BOOST_FOREACH(const uint64_t& cell, cells) {
+		grid.refine_completely(cell);
+	}
+	grid.stop_refining();
+
+	const vector<uint64_t> refined_cells = grid.get_cells();
+	BOOST_FOREACH(const uint64_t& cell, refined_cells) {
+		grid.unrefine_completely(cell);
+	}
+	grid.stop_refining();
+
+	grid.stop_tracing();
+	comm.barrier();
+
+	vector<vector<Trace_Record> > traces;
+	for (int process = 0; process < comm.size(); process++) {
+		traces.push_back(read_trace(prefix, process, comm.size()));
+	}
+
+	const vector<Trace_Record>& own = traces[comm.rank()];
+
+	map<uint32_t, int> kinds;
+	BOOST_FOREACH(const Trace_Record& record, own) {
+		kinds[record.kind]++;
+
+		if (record.start_time > record.receives_end_time
+		|| record.receives_end_time > record.sends_end_time
+		|| record.receive_wait < 0
+		|| record.send_wait < 0) {
+			cerr << "Process " << comm.rank() << ": Inconsistent times in trace" << endl;
+			abort();
+		}
+	}
+
+	if (kinds[Trace_Record::NEIGHBOR_UPDATE] < 2 * UPDATES
+	|| kinds[Trace_Record::MIGRATION] == 0
+	|| kinds[Trace_Record::REFINEMENT] == 0) {
+		cerr << "Process " << comm.rank() << ": Transfers are missing from trace" << endl;
+		abort();
+	}
+
+	// what this process sent must have been received in the same transfer
+	for (int process = 0; process < comm.size(); process++) {
+		if (traces[process].size() != own.size()) {
+			cerr << "Process " << comm.rank()
+				<< ": Trace of process " << process
+				<< " has " << traces[process].size()
+				<< " records instead of " << own.size()
+				<< endl;
+			abort();
+		}
+	}
+
+	for (size_t i = 0; i < own.size(); i++) {
+		for (map<int, Peer_Statistics>::const_iterator
+			peer = own[i].peers.begin();
+			peer != own[i].peers.end();
+			peer++
+		) {
+			const map<int, Peer_Statistics>& others = traces[peer->first][i].peers;
+			if (own[i].kind != traces[peer->first][i].kind
+			|| others.count(comm.rank()) == 0
+			|| others.at(comm.rank()).received_bytes != peer->second.sent_bytes
+			|| others.at(comm.rank()).received_messages != peer->second.sent_messages) {
+				cerr << "Process " << comm.rank()
+					<< ": Process " << peer->first
+					<< " didn't receive what was sent in transfer " << i
+					<< endl;
+				abort();
+			}
+		}
+	}
+
+	if (comm.rank() == 0) {
+		cout << own.size() << " transfers traced" << endl;
+		cout << "Passed" << endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+/*
+Tests neighbor data updates and load balancing with variable amount of data in cells
+transferred without boost serialization
+*/
+
+#include "boost/foreach.hpp"
+#include "boost/mpi.hpp"
+#include "cstdlib"
+#include "iostream"
+#include "vector"
+#include "zoltan.h"
+
+#define DCCRG_CELL_DATA_SIZE_FROM_USER
+#define DCCRG_VARIABLE_CELL_DATA_SIZE
+#include "../../dccrg.hpp"
+
+using namespace std;
+using namespace boost::mpi;
+using namespace dccrg;
+
+class CellData {
+public:
+	vector<int> variables;
+
+	void* at(void)
+	{
+		return &(this->variables[0]);
+	}
+
+	size_t size(void) const
+	{
+		return this->variables.size() * sizeof(int);
+	}
+
+	void resize(const size_t bytes)
+	{
+		this->variables.resize(bytes / sizeof(int));
+	}
+};
+
+// the number of variables changes every other step so every other update reuses old sizes
+static void set_data(CellData& data, const uint64_t cell, const int step)
+{
+	data.variables.resize(cell % 4 + 1 + step / 2);
+	for (size_t i = 0; i < data.variables.size(); i++) {
+		data.variables[i] = int(cell * 100 + step * 10 + i);
+	}
+}
+
+static bool has_data(const CellData& data, const uint64_t cell, const int step)
+{
+	if (data.variables.size() != cell % 4 + 1 + step / 2) {
+		return false;
+	}
+
+	for (size_t i = 0; i < data.variables.size(); i++) {
+		if (data.variables[i] != int(cell * 100 + step * 10 + i)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	environment env(argc, argv);
+	communicator comm;
+
+	float zoltan_version;
+	if (Zoltan_Initialize(argc, argv, &zoltan_version) != ZOLTAN_OK) {
+	    cout << "Zoltan_Initialize failed" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	Dccrg<CellData> grid;
+
+	#define GRID_SIZE 10
+	grid.set_geometry(GRID_SIZE, GRID_SIZE, 1, 0, 0, 0, 1, 1, 1);
+	grid.initialize(comm, "RANDOM", 1, 0);
+
+	const vector<Dccrg<CellData>::transfer_policy_t> policies = grid.get_transfer_policies();
+
+	#define TIME_STEPS 12
+	for (int step = 0; step < TIME_STEPS; step++) {
+
+		vector<uint64_t> cells = grid.get_cells();
+		BOOST_FOREACH(const uint64_t& cell, cells) {
+			set_data(*(grid[cell]), cell, step);
+		}
+
+		grid.update_remote_neighbor_data(policies[(step / 2) % policies.size()]);
+
+		BOOST_FOREACH(const uint64_t& cell, cells) {
+			const vector<uint64_t>* neighbors = grid.get_neighbors(cell);
+			BOOST_FOREACH(const uint64_t& neighbor, *neighbors) {
+				if (neighbor == 0) {
+					continue;
+				}
+
+				if (!has_data(*(grid[neighbor]), neighbor, step)) {
+					cerr << "Process " << comm.rank()
+						<< ": Neighbor " << neighbor
+						<< " of cell " << cell
+						<< " has wrong data with " << grid[neighbor]->variables.size()
+						<< " variables at step " << step
+						<< endl;
+					abort();
+				}
+			}
+		}
+
+		if (step % 3 == 2) {
+			grid.balance_load();
+
+			cells = grid.get_cells();
+			BOOST_FOREACH(const uint64_t& cell, cells) {
+				if (!has_data(*(grid[cell]), cell, step)) {
+					cerr << "Process " << comm.rank()
+						<< ": Cell " << cell
+						<< " has wrong data after load balancing at step " << step
+						<< endl;
+					abort();
+				}
+			}
+		}
+	}
+
+	if (comm.rank() == 0) {
+		cout << "Passed" << endl;
+	}
+
+	return EXIT_SUCCESS;
+}